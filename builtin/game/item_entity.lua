@@ -15,6 +15,7 @@ end
 -- Setting it to -1 disables the feature
 
 local time_to_live = tonumber(core.settings:get("item_entity_ttl")) or 900
+local step_interval = tonumber(core.settings:get("item_entity_step_interval")) or 0
 local gravity = tonumber(core.settings:get("movement_gravity")) or 9.81
 
 
@@ -30,6 +31,10 @@ core.register_entity(":__builtin:item", {
 		is_visible = false,
 	},
 
+	native_step = {
+		on_step_interval = step_interval,
+	},
+
 	itemstring = "",
 	moving_state = true,
 	physical_state = true,
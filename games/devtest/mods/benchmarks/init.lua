@@ -1,3 +1,6 @@
+aperosengine.register_mapgen_script(aperosengine.get_modpath(aperosengine.get_current_modname()) ..
+	DIR_DELIM .. "mapgen_env.lua")
+
 -- Safeguard against too much optimization. This way the results cannot be optimized
 -- away, but they can be garbage collected (due to __mode = "k").
 _G._bench_content_ids_data = setmetatable({}, {__mode = "k"})
@@ -187,3 +190,32 @@ aperosengine.register_chatcommand("bench_bulk_swap_node", {
 		return true, msg
 	end,
 })
+
+-- Every run needs an area that wasn't generated yet
+local imbalanced_emerge_runs = 0
+
+aperosengine.register_chatcommand("bench_emerge_imbalanced", {
+	params = "",
+	description = "Benchmark: Emerge 4×1×4 mapchunks with slow on_generated callbacks in some of them",
+	func = function(name, param)
+		imbalanced_emerge_runs = imbalanced_emerge_runs + 1
+		local x = 10000 + imbalanced_emerge_runs * 1000
+		local pos1 = vector.new(x, 0, 10000)
+		local pos2 = pos1:offset(319, 79, 319)
+
+		aperosengine.ipc_set("benchmarks:imbalanced_on_generated",
+			{slow_us = 200000, fast_us = 5000})
+		aperosengine.chat_send_player(name, "Benchmarking emerging with imbalanced on_generated callbacks ...")
+
+		local start_time = aperosengine.get_us_time()
+		aperosengine.emerge_area(pos1, pos2, function(blockpos, action, calls_remaining)
+			if calls_remaining > 0 then
+				return
+			end
+			aperosengine.ipc_set("benchmarks:imbalanced_on_generated", nil)
+			local msg = string.format("Benchmark results: emerge_area: %.2f ms",
+				(aperosengine.get_us_time() - start_time) / 1000)
+			aperosengine.chat_send_player(name, msg)
+		end)
+	end,
+})
@@ -0,0 +1,21 @@
+-- Deliberately imbalanced on_generated callbacks, only active while
+-- the bench_emerge_imbalanced command runs
+
+local function busy_wait(us)
+	local finish = aperosengine.get_us_time() + us
+	while aperosengine.get_us_time() < finish do end
+end
+
+aperosengine.register_on_generated(function(vmanip, minp, maxp, blockseed)
+	local params = aperosengine.ipc_get("benchmarks:imbalanced_on_generated")
+	if not params then
+		return
+	end
+	-- One column of mapchunks out of four is slow
+	local chunk_x = math.floor(minp.x / (maxp.x - minp.x + 1))
+	if chunk_x % 4 == 0 then
+		busy_wait(params.slow_us)
+	else
+		busy_wait(params.fast_us)
+	end
+end)
@@ -0,0 +1,84 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "server/ao_message_router.h"
+#include "server/clientiface.h"
+#include "server/serveractiveobject.h"
+#include "util/numeric.h"
+#include <memory>
+#include <vector>
+
+namespace {
+
+class TestObject : public ServerActiveObject {
+public:
+	TestObject(v3f pos) : ServerActiveObject(nullptr, pos)
+	{}
+
+	ActiveObjectType getType() const {
+		return ACTIVEOBJECT_TYPE_TEST;
+	}
+	bool getCollisionBox(aabb3f *toset) const {
+		return false;
+	}
+	bool getSelectionBox(aabb3f *toset) const {
+		return false;
+	}
+	bool collideWithObjects() const {
+		return true;
+	}
+};
+
+inline v3f randpos()
+{
+	return v3f(myrand_range(-500, 500), 0, myrand_range(-500, 500));
+}
+
+}
+
+TEST_CASE("benchmark_aomessagerouter")
+{
+	constexpr int NUM_CLIENTS = 100;
+	constexpr int NUM_OBJECTS = 5000;
+	// Like active_object_send_range_blocks = 8 on a 1000x1000 area
+	constexpr float SEND_RANGE = 128;
+
+	std::vector<std::unique_ptr<RemoteClient>> clients;
+	std::vector<v3f> client_pos;
+	for (int i = 0; i < NUM_CLIENTS; i++) {
+		clients.push_back(std::make_unique<RemoteClient>());
+		clients.back()->peer_id = 2 + i;
+		client_pos.push_back(randpos());
+	}
+
+	std::vector<std::unique_ptr<TestObject>> objects;
+	std::vector<ActiveObjectMessage> messages;
+	for (int i = 0; i < NUM_OBJECTS; i++) {
+		auto obj = std::make_unique<TestObject>(randpos());
+		obj->setId(1 + i);
+		for (int c = 0; c < NUM_CLIENTS; c++) {
+			if (obj->getBasePosition().getDistanceFrom(client_pos[c]) > SEND_RANGE)
+				continue;
+			clients[c]->m_known_objects.insert(obj->getId());
+			obj->addKnownBy(clients[c]->peer_id);
+		}
+		// Every entity moves, about the size of a position update
+		messages.emplace_back(obj->getId(), false,
+			std::string(1, (char)AO_CMD_UPDATE_POSITION) + std::string(48, 'x'));
+		objects.push_back(std::move(obj));
+	}
+
+	server::AOMessageRouter router;
+	BENCHMARK("route_5000_moving_objects_100_clients") {
+		router.reset();
+		for (auto &client : clients)
+			router.addRecipient(client.get(), 0);
+		for (int i = 0; i < NUM_OBJECTS; i++)
+			router.route(messages[i], objects[i].get());
+		size_t bytes = 0;
+		for (const auto &recipient : router)
+			bytes += recipient.unreliable.size();
+		return bytes;
+	};
+}
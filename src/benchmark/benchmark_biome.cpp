@@ -0,0 +1,100 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "mapgen/mg_biome.h"
+#include "pcg_random.h"
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct BiomeSet {
+	std::vector<std::unique_ptr<Biome>> owned;
+	std::vector<const Biome *> biomes{nullptr};
+};
+
+// Biomes in layers of y ranges, like in larger games
+void makeBiomes(BiomeSet &set, int count)
+{
+	PcgRandom pr(1337);
+	const s16 layers_y[] = {-MAX_MAP_GENERATION_LIMIT, -256, -64, 0, 4, 64, 128,
+		MAX_MAP_GENERATION_LIMIT};
+	for (int i = 0; i < count; i++) {
+		Biome *b = new Biome;
+		set.owned.emplace_back(b);
+		b->heat_point = pr.range(0, 100);
+		b->humidity_point = pr.range(0, 100);
+		int layer = pr.range(0, 6);
+		b->min_pos = v3s16(-MAX_MAP_GENERATION_LIMIT, layers_y[layer],
+			-MAX_MAP_GENERATION_LIMIT);
+		b->max_pos = v3s16(MAX_MAP_GENERATION_LIMIT, layers_y[layer + 1] - 1,
+			MAX_MAP_GENERATION_LIMIT);
+		b->vertical_blend = i % 4 == 0 ? 8 : 0;
+		set.biomes.push_back(b);
+	}
+}
+
+// The previous implementation
+biome_t findByScan(const std::vector<const Biome *> &biomes, float heat,
+	float humidity, v3s16 pos)
+{
+	biome_t closest = BIOME_NONE;
+	float dist_min = FLT_MAX;
+	for (size_t i = 1; i < biomes.size(); i++) {
+		const Biome *b = biomes[i];
+		if (pos.Y < b->min_pos.Y || pos.Y > b->max_pos.Y + b->vertical_blend ||
+				pos.X < b->min_pos.X || pos.X > b->max_pos.X ||
+				pos.Z < b->min_pos.Z || pos.Z > b->max_pos.Z)
+			continue;
+		float d_heat = heat - b->heat_point;
+		float d_humidity = humidity - b->humidity_point;
+		float dist = (d_heat * d_heat) + (d_humidity * d_humidity);
+		if (pos.Y <= b->max_pos.Y && dist < dist_min) {
+			dist_min = dist;
+			closest = i;
+		}
+	}
+	return closest;
+}
+
+void benchBiomeLookup(Catch::Benchmark::Chronometer &meter, int count, bool scan)
+{
+	BiomeSet set;
+	makeBiomes(set, count);
+	BiomeLookup lookup(set.biomes);
+
+	// One mapchunk worth of columns
+	PcgRandom pr(42);
+	std::vector<std::pair<v2f, s16>> queries;
+	for (int i = 0; i < 80 * 80; i++) {
+		queries.emplace_back(v2f(pr.range(-2000, 12000) / 100.0f,
+			pr.range(-2000, 12000) / 100.0f), pr.range(-100, 200));
+	}
+
+	meter.measure([&] {
+		u32 sum = 0;
+		for (const auto &q : queries) {
+			v3s16 pos(0, q.second, 0);
+			sum += scan ? findByScan(set.biomes, q.first.X, q.first.Y, pos) :
+				lookup.find(q.first.X, q.first.Y, pos).closest;
+		}
+		return sum;
+	});
+}
+
+}
+
+#define BENCH_LOOKUP(_count) \
+	BENCHMARK_ADVANCED("scan_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchBiomeLookup(meter, _count, true); }; \
+	BENCHMARK_ADVANCED("lookup_" #_count)(Catch::Benchmark::Chronometer meter) \
+	{ benchBiomeLookup(meter, _count, false); };
+
+TEST_CASE("benchmark_biome")
+{
+	BENCH_LOOKUP(10)
+	BENCH_LOOKUP(50)
+	BENCH_LOOKUP(150)
+	BENCH_LOOKUP(400)
+}
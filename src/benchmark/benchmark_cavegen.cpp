@@ -0,0 +1,213 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "unittest/mock_server.h"
+#include "noise.h"
+#include "mapgen/mg_biome.h"
+#include "mapgen/cavegen.h"
+#include "mapgen/mapgen_v7.h"
+#include "mapgen/mapgen_valleys.h"
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const v3s16 csize(80, 80, 80);
+const s16 water_level = 1;
+const s32 seed = 1234;
+
+struct Nodes {
+	content_t stone, dirt, grass, water, lava;
+};
+
+s16 terrain_height(s16 x, s16 z)
+{
+	return 10 + 30 * std::sin(x * 0.03f) * std::cos(z * 0.02f);
+}
+
+// A mapchunk like after generateTerrain() and generateBiomes()
+struct Chunk {
+	v3s16 nmin, nmax;
+	std::unique_ptr<DummyMap> map;
+	std::unique_ptr<MMVManip> vm;
+	std::vector<MapNode> terrain;
+	s16 heightmap[80 * 80];
+	s16 max_stone_y = -MAX_MAP_GENERATION_LIMIT;
+
+	Chunk(IGameDef *gamedef, const Nodes &nodes, v3s16 bpmin)
+	{
+		const v3s16 bpmax = bpmin + v3s16(4, 4, 4);
+		nmin = bpmin * MAP_BLOCKSIZE;
+		nmax = (bpmax + v3s16(1, 1, 1)) * MAP_BLOCKSIZE - v3s16(1, 1, 1);
+		map = std::make_unique<DummyMap>(gamedef, bpmin - 1, bpmax + 1);
+		vm = std::make_unique<MMVManip>(map.get());
+		vm->initialEmerge(bpmin - 1, bpmax + 1, false);
+
+		const VoxelArea &area = vm->m_area;
+		for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+		for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++) {
+			s16 height = terrain_height(x, z);
+			for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++) {
+				content_t c = CONTENT_AIR;
+				if (y <= height - 4)
+					c = nodes.stone;
+				else if (y < height)
+					c = nodes.dirt;
+				else if (y == height)
+					c = nodes.grass;
+				else if (y <= water_level)
+					c = nodes.water;
+				vm->m_data[area.index(x, y, z)] = MapNode(c);
+			}
+		}
+		terrain.assign(vm->m_data, vm->m_data + area.getVolume());
+
+		for (s16 z = nmin.Z, i = 0; z <= nmax.Z; z++)
+		for (s16 x = nmin.X; x <= nmax.X; x++, i++) {
+			s16 height = terrain_height(x, z);
+			heightmap[i] = rangelim(height, nmin.Y - 1, nmax.Y);
+			max_stone_y = std::max<s16>(max_stone_y, height);
+		}
+	}
+
+	void reset()
+	{
+		memcpy(vm->m_data, terrain.data(), terrain.size() * sizeof(MapNode));
+		memset(vm->m_flags, 0, terrain.size());
+	}
+};
+
+// Like the cave part of MapgenV7::makeChunk() and MapgenValleys::makeChunk()
+template <typename Params>
+bool generate_caves(const NodeDefManager *ndef, const Params &params,
+	const Nodes &nodes, Chunk &chunk, BiomeManager *biomemgr,
+	BiomeGen *biomegen, biome_t *biomemap)
+{
+	NoiseParams np_cave1 = params.np_cave1, np_cave2 = params.np_cave2;
+	NoiseParams np_cavern = params.np_cavern;
+
+	CavesNoiseIntersection caves_noise(ndef, biomemgr, biomegen, csize,
+		&np_cave1, &np_cave2, seed, params.cave_width);
+	caves_noise.generateCaves(chunk.vm.get(), chunk.nmin, chunk.nmax, biomemap);
+
+	bool near_cavern = false;
+	if (chunk.nmin.Y <= params.cavern_limit) {
+		CavernsNoise caverns_noise(ndef, csize, &np_cavern, seed,
+			params.cavern_limit, params.cavern_taper, params.cavern_threshold);
+		near_cavern = caverns_noise.generateCaverns(chunk.vm.get(),
+			chunk.nmin, chunk.nmax);
+	}
+
+	if (chunk.nmax.Y <= params.large_cave_depth && !near_cavern) {
+		PseudoRandom ps(seed + 21343);
+		u32 num_large_caves = ps.range(params.large_cave_num_min,
+			params.large_cave_num_max);
+		for (u32 i = 0; i < num_large_caves; i++) {
+			CavesRandomWalk cave(ndef, nullptr, seed, water_level,
+				nodes.water, nodes.lava, params.large_cave_flooded, biomegen);
+			cave.makeCave(chunk.vm.get(), chunk.nmin, chunk.nmax, &ps, true,
+				chunk.max_stone_y, chunk.heightmap);
+		}
+	}
+	return near_cavern;
+}
+
+}
+
+TEST_CASE("benchmark_cavegen")
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	auto add_node = [ndef] (const char *name, bool liquid) {
+		ContentFeatures f;
+		f.name = name;
+		f.is_ground_content = !liquid;
+		if (liquid)
+			f.liquid_type = LIQUID_SOURCE;
+		return ndef->set(f.name, f);
+	};
+	Nodes nodes;
+	nodes.stone = add_node("stone", false);
+	nodes.dirt = add_node("dirt", false);
+	nodes.grass = add_node("grass", false);
+	nodes.water = add_node("water", true);
+	nodes.lava = add_node("lava", true);
+	ndef->setNodeRegistrationStatus(true);
+
+	MockServer server;
+	BiomeManager biomemgr(&server);
+	{
+		Biome *b = (Biome *)biomemgr.getRaw(0);
+		b->flags = 0;
+		b->c_top = nodes.grass;
+		b->c_filler = nodes.dirt;
+		b->c_stone = nodes.stone;
+		b->c_water_top = nodes.water;
+		b->c_water = nodes.water;
+		b->c_river_water = nodes.water;
+		b->c_riverbed = nodes.dirt;
+		b->c_dust = CONTENT_IGNORE;
+		b->c_cave_liquid = {CONTENT_IGNORE};
+		b->depth_top = 1;
+		b->depth_filler = 3;
+		b->depth_riverbed = 2;
+	}
+	BiomeParamsOriginal bparams;
+	bparams.seed = seed;
+	std::unique_ptr<BiomeGen> biomegen(biomemgr.createBiomeGen(
+		BIOMEGEN_ORIGINAL, &bparams, csize));
+
+	// Above and at the surface and in the cavern layer
+	Chunk sky(&gamedef, nodes, v3s16(-2, 3, -2));
+	Chunk surface(&gamedef, nodes, v3s16(-2, -2, -2));
+	Chunk deep(&gamedef, nodes, v3s16(-2, -27, -2));
+
+	MapgenV7Params v7_params;
+	MapgenValleysParams valleys_params;
+
+	auto bench_chunk = [&] (auto &params, Chunk &chunk) {
+		chunk.reset();
+		biomegen->calcBiomeNoise(chunk.nmin);
+		biome_t *biomemap = biomegen->getBiomes(chunk.heightmap, chunk.nmin);
+		return generate_caves(ndef, params, nodes, chunk, &biomemgr,
+			biomegen.get(), biomemap);
+	};
+
+	BENCHMARK("v7_sky_chunk") {
+		return bench_chunk(v7_params, sky);
+	};
+
+	BENCHMARK("v7_surface_chunk") {
+		return bench_chunk(v7_params, surface);
+	};
+
+	BENCHMARK("v7_cavern_chunk") {
+		return bench_chunk(v7_params, deep);
+	};
+
+	BENCHMARK("valleys_surface_chunk") {
+		return bench_chunk(valleys_params, surface);
+	};
+
+	BENCHMARK("valleys_cavern_chunk") {
+		return bench_chunk(valleys_params, deep);
+	};
+
+	BENCHMARK("CavesRandomWalk_16_caves") {
+		deep.reset();
+		PseudoRandom ps(seed);
+		for (int i = 0; i < 16; i++) {
+			CavesRandomWalk cave(ndef, nullptr, seed, water_level,
+				nodes.water, nodes.lava, 0.5f, biomegen.get());
+			cave.makeCave(deep.vm.get(), deep.nmin, deep.nmax, &ps, i % 2 == 0,
+				deep.max_stone_y, deep.heightmap);
+		}
+		return deep.vm->m_data[0].getContent();
+	};
+}
@@ -0,0 +1,128 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "mapgen/mapgen.h"
+#include "mapgen/mg_decoration.h"
+#include "mapgen/mg_schematic.h"
+#include "pcg_random.h"
+#include <cmath>
+#include <vector>
+
+TEST_CASE("benchmark_decoration")
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	content_t c_stone;
+	{
+		ContentFeatures f;
+		f.name = "stone";
+		c_stone = ndef->set(f.name, f);
+	}
+	{
+		ContentFeatures f;
+		f.name = "tree";
+		f.param_type_2 = CPT2_FACEDIR;
+		ndef->set(f.name, f);
+	}
+	{
+		ContentFeatures f;
+		f.name = "leaves";
+		ndef->set(f.name, f);
+	}
+	ndef->setNodeRegistrationStatus(true);
+
+	// A mapchunk with its border blocks, full of caves
+	const v3s16 bpmin(-1, -1, -1), bpmax(5, 5, 5);
+	const v3s16 nmin(0, 0, 0), nmax(79, 79, 79);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	MMVManip vm(&map);
+	vm.initialEmerge(bpmin, bpmax, false);
+	for (s16 z = vm.m_area.MinEdge.Z; z <= vm.m_area.MaxEdge.Z; z++)
+	for (s16 y = vm.m_area.MinEdge.Y; y <= vm.m_area.MaxEdge.Y; y++)
+	for (s16 x = vm.m_area.MinEdge.X; x <= vm.m_area.MaxEdge.X; x++) {
+		float cave = std::sin(x * 0.2f) + std::sin(y * 0.3f) + std::sin(z * 0.25f);
+		vm.m_data[vm.m_area.index(x, y, z)] =
+			MapNode(cave > 0.8f ? CONTENT_AIR : c_stone);
+	}
+
+	// Columns probed by 40 all_floors decorations, each covering 1/16 of
+	// the mapchunk
+	PcgRandom pr(42);
+	std::vector<v2s16> columns;
+	for (int i = 0; i < 40 * 80 * 80 / 16; i++)
+		columns.emplace_back(pr.range(nmin.X, nmax.X), pr.range(nmin.Z, nmax.Z));
+
+	BENCHMARK("Mapgen::getSurfaces_per_decoration") {
+		size_t count = 0;
+		for (v2s16 p2d : columns) {
+			std::vector<s16> floors, ceilings;
+			floors.reserve(40);
+			ceilings.reserve(40);
+			Mapgen::getSurfaces(&vm, ndef, p2d, nmin.Y, nmax.Y, floors, ceilings);
+			count += floors.size() + ceilings.size();
+		}
+		return count;
+	};
+
+	BENCHMARK("DecoSurfaceIndex") {
+		DecoSurfaceIndex surfaces(&vm, ndef, nmin, nmax);
+		size_t count = 0;
+		for (size_t i = 0; i < columns.size(); i++) {
+			DecoSurfaceIndex::Surfaces column = surfaces.getSurfaces(columns[i]);
+			count += column.num_floors + column.num_ceilings;
+			// Like placed simple decorations and a few schematics
+			if (i % 64 == 0) {
+				surfaces.invalidate(columns[i] - v2s16(4, 4),
+					columns[i] + v2s16(4, 4));
+			} else if (i % 4 == 0) {
+				surfaces.invalidate(columns[i], columns[i]);
+			}
+		}
+		return count;
+	};
+
+	// A small tree
+	Schematic schem;
+	const v3s16 size(5, 7, 5);
+	const u32 volume = size.X * size.Y * size.Z;
+	schem.m_nodenames = {"air", "tree", "leaves"};
+	schem.m_nnlistsizes.push_back(schem.m_nodenames.size());
+	schem.size = size;
+	schem.schemdata = new MapNode[volume];
+	schem.slice_probs = new u8[size.Y];
+	for (s16 y = 0; y < size.Y; y++)
+		schem.slice_probs[y] = APRSCHEM_PROB_ALWAYS;
+	for (s16 z = 0; z < size.Z; z++)
+	for (s16 y = 0; y < size.Y; y++)
+	for (s16 x = 0; x < size.X; x++) {
+		content_t c = 0;
+		u8 prob = APRSCHEM_PROB_NEVER;
+		if (x == 2 && z == 2 && y < 5) {
+			c = 1;
+			prob = APRSCHEM_PROB_ALWAYS | APRSCHEM_FORCE_PLACE;
+		} else if (y >= 3) {
+			c = 2;
+			prob = (x == 0 || x == 4) && (z == 0 || z == 4) ? 64 :
+				APRSCHEM_PROB_ALWAYS;
+		}
+		schem.schemdata[(z * size.Y + y) * size.X + x] = MapNode(c, prob, 1);
+	}
+	ndef->pendNodeResolve(&schem);
+
+	std::vector<std::pair<v3s16, Rotation>> placements;
+	for (int i = 0; i < 1000; i++) {
+		v3s16 p(pr.range(nmin.X, nmax.X), pr.range(nmin.Y, nmax.Y),
+			pr.range(nmin.Z, nmax.Z));
+		placements.emplace_back(p, (Rotation)pr.range(ROTATE_0, ROTATE_270));
+	}
+
+	BENCHMARK("Schematic::blitToVManip") {
+		for (const auto &it : placements)
+			schem.blitToVManip(&vm, it.first, it.second, false);
+		return vm.m_data[0].getContent();
+	};
+}
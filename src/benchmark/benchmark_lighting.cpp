@@ -84,3 +84,90 @@ TEST_CASE("benchmark_lighting")
 		});
 	};
 }
+
+// Edits of a cube with the given edge length (in nodes) at once, as done by
+// VoxelManip:write_to_map and large liquid updates
+static void benchmark_lighting_bulk(s16 size)
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	v3s16 pmin(0, 0, 0);
+	v3s16 pmax(size - 1, size - 1, size - 1);
+	v3s16 bpmin = getNodeBlockPos(pmin), bpmax = getNodeBlockPos(pmax);
+	DummyMap map(&gamedef, bpmin, bpmax);
+
+	content_t content_wall;
+	{
+		ContentFeatures f;
+		f.name = "stone";
+		content_wall = ndef->set(f.name, f);
+	}
+
+	content_t content_light;
+	{
+		ContentFeatures f;
+		f.name = "light";
+		f.param_type = CPT_LIGHT;
+		f.light_propagates = true;
+		f.light_source = 14;
+		content_light = ndef->set(f.name, f);
+	}
+
+	// Floors every 16 nodes with a lamp in the middle of each room below
+	auto fill = [&] (MMVManip &vm, bool lamps) {
+		for (s16 z = pmin.Z; z <= pmax.Z; z++)
+		for (s16 y = pmin.Y; y <= pmax.Y; y++)
+		for (s16 x = pmin.X; x <= pmax.X; x++) {
+			content_t c = CONTENT_AIR;
+			if (y % 16 == 15 && x % 16 != 0)
+				c = content_wall;
+			else if (lamps && x % 16 == 8 && y % 16 == 8 && z % 16 == 8)
+				c = content_light;
+			vm.setNodeNoEmerge(v3s16(x, y, z), MapNode(c));
+		}
+	};
+
+	std::map<v3s16, MapBlock*> modified_blocks;
+	MMVManip vm(&map);
+	vm.initialEmerge(bpmin, bpmax, false);
+	fill(vm, false);
+	voxalgo::blit_back_with_light(&map, &vm, &modified_blocks);
+
+	const std::string label = std::to_string(size);
+
+	BENCHMARK_ADVANCED("voxalgo::blit_back_with_light_" + label)(Catch::Benchmark::Chronometer meter) {
+		bool lamps = false;
+		meter.measure([&] {
+			lamps = !lamps;
+			fill(vm, lamps);
+			voxalgo::blit_back_with_light(&map, &vm, &modified_blocks);
+		});
+	};
+
+	// Remove and put back the top floor, like a liquid flowing over it
+	std::vector<v3s16> roof;
+	for (s16 z = pmin.Z; z <= pmax.Z; z++)
+	for (s16 x = pmin.X + 1; x <= pmax.X; x++)
+		roof.emplace_back(x, pmax.Y, z);
+
+	BENCHMARK_ADVANCED("voxalgo::update_lighting_nodes_" + label)(Catch::Benchmark::Chronometer meter) {
+		std::vector<std::pair<v3s16, MapNode>> oldnodes;
+		bool open = false;
+		meter.measure([&] {
+			open = !open;
+			oldnodes.clear();
+			for (v3s16 p : roof) {
+				oldnodes.emplace_back(p, map.getNode(p));
+				map.setNode(p, MapNode(open ? CONTENT_AIR : content_wall));
+			}
+			voxalgo::update_lighting_nodes(&map, oldnodes, modified_blocks);
+		});
+	};
+}
+
+TEST_CASE("benchmark_lighting_bulk")
+{
+	benchmark_lighting_bulk(64);
+	benchmark_lighting_bulk(256);
+}
@@ -0,0 +1,166 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "unittest/mock_server.h"
+#include "collision.h"
+#include "emerge.h"
+#include "filesys.h"
+#include "mapblock.h"
+#include "nodedef.h"
+#include "servermap.h"
+#include "server/luaentity_sao.h"
+#include "threading/task_pool.h"
+#include "util/metricsbackend.h"
+#include <fstream>
+#include <memory>
+#include <vector>
+
+// Dropped items that step every 0.5 s, see item_entity_step_interval
+static const char *helper_lua_src = R"(
+core.register_node(":bench:stone", {})
+
+local def = table.copy(core.registered_entities["__builtin:item"])
+def.native_step = {on_step_interval = 0.5}
+core.register_entity(":bench:item", def)
+
+core.register_entity(":bench:mob", {
+	initial_properties = {
+		physical = true,
+		collide_with_objects = true,
+		collisionbox = {-0.3, -0.5, -0.3, 0.3, 0.5, 0.3},
+	},
+})
+)";
+
+TEST_CASE("benchmark_luaentity")
+{
+	const std::string world_path = fs::CreateTempDir();
+	const std::string helper_lua = world_path + DIR_DELIM "helper.lua";
+	{
+		std::ofstream ofs(helper_lua, std::ios::out | std::ios::binary);
+		ofs << helper_lua_src;
+		std::ofstream ofs2(world_path + DIR_DELIM "world.apr",
+			std::ios::out | std::ios::binary);
+		ofs2 << "backend = dummy\n";
+	}
+
+	MockServer server(world_path);
+	server.createScripting();
+	auto script = server.getScriptIface();
+	script->loadBuiltin();
+	script->loadMod(helper_lua, BUILTIN_MOD_NAME);
+
+	MetricsBackend mb;
+	EmergeManager emerge(&server, &mb);
+	auto map = std::make_unique<ServerMap>(world_path, &server, &emerge, &mb);
+	ServerMap &smap = *map;
+	ServerEnvironment env(std::move(map), &server, &mb);
+	env.loadMeta();
+	script->initializeEnvironment(&env);
+
+	// A stone floor to drop the items on
+	const content_t c_stone = server.getNodeDefManager()->getId("bench:stone");
+	REQUIRE(c_stone != CONTENT_IGNORE);
+	for (s16 bz = 0; bz < 4; bz++)
+	for (s16 by = -1; by < 1; by++)
+	for (s16 bx = 0; bx < 4; bx++) {
+		MapBlock *block = smap.emergeBlock(v3s16(bx, by, bz), true);
+		REQUIRE(block);
+		for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+		for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+		for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+			content_t c = by < 0 ? c_stone : CONTENT_AIR;
+			block->setNodeNoCheck(x, y, z, MapNode(c));
+		}
+	}
+
+	auto drop_items = [&] (const char *name) {
+		std::vector<LuaEntitySAO *> items;
+		for (int i = 0; i < 1000; i++) {
+			v3f pos(1 + (i % 60), 1, 1 + (i / 60) * 3);
+			auto obj_u = std::make_unique<LuaEntitySAO>(&env, pos * BS, name,
+				"bench:stone 3");
+			LuaEntitySAO *obj = obj_u.get();
+			REQUIRE(env.addActiveObject(std::move(obj_u)) != 0);
+			items.push_back(obj);
+		}
+		// Let them land
+		for (int step = 0; step < 40; step++) {
+			for (LuaEntitySAO *obj : items)
+				obj->step(0.05f, false);
+		}
+		return items;
+	};
+
+	auto step_items = [] (const std::vector<LuaEntitySAO *> &items) {
+		for (LuaEntitySAO *obj : items)
+			obj->step(0.05f, false);
+		return items.size();
+	};
+
+	auto remove_items = [&] (const std::vector<LuaEntitySAO *> &items) {
+		for (LuaEntitySAO *obj : items)
+			obj->markForRemoval();
+		env.step(0.05f);
+	};
+
+	{
+		auto items = drop_items("__builtin:item");
+		BENCHMARK("step_1000_idle_items") {
+			return step_items(items);
+		};
+		remove_items(items);
+	}
+
+	{
+		auto items = drop_items("bench:item");
+		BENCHMARK("step_1000_idle_items_step_interval_0.5") {
+			return step_items(items);
+		};
+		remove_items(items);
+	}
+
+	{
+		// A crowded mob farm, 1000 mobs walking around in 32x32 nodes
+		std::vector<LuaEntitySAO *> mobs;
+		std::vector<CollisionMoveJob> moves;
+		for (int i = 0; i < 1000; i++) {
+			v3f pos(0.5f + (i % 32), 0, 0.5f + (i / 32));
+			auto obj_u = std::make_unique<LuaEntitySAO>(&env, pos * BS,
+				"bench:mob", "");
+			LuaEntitySAO *obj = obj_u.get();
+			REQUIRE(env.addActiveObject(std::move(obj_u)) != 0);
+			obj->setVelocity(v3f((i % 5) - 2, 0, (i % 3) - 1) * BS);
+			obj->setAcceleration(v3f(0, -10, 0) * BS);
+			mobs.push_back(obj);
+			moves.emplace_back();
+			REQUIRE(obj->getCollisionMove(0.05f, moves.back()));
+		}
+
+		BENCHMARK("collisionMoveSimple_1000_mobs") {
+			size_t collisions = 0;
+			for (CollisionMoveJob move : moves) {
+				collisions += collisionMoveSimple(&env, &server, BS * 0.25f,
+					move.box, move.stepheight, move.dtime, &move.new_pos,
+					&move.new_speed, move.accel, move.self,
+					move.collide_with_objects).collisions.size();
+			}
+			return collisions;
+		};
+
+		BENCHMARK("collisionMoveBatch_1000_mobs") {
+			std::vector<CollisionMoveJob> batch = moves;
+			collisionMoveBatch(&env, &server, batch, &TaskPool::getShared());
+			size_t collisions = 0;
+			for (const CollisionMoveJob &move : batch)
+				collisions += move.result.collisions.size();
+			return collisions;
+		};
+
+		remove_items(mobs);
+	}
+
+	env.deactivateBlocksAndObjects();
+	fs::RecursiveDelete(world_path);
+}
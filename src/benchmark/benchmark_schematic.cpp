@@ -0,0 +1,101 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "filesys.h"
+#include "mapgen/mg_schematic.h"
+#include "porting.h"
+#include "settings.h"
+#include <memory>
+#include <vector>
+
+TEST_CASE("benchmark_schematic")
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	content_t c_stone;
+	{
+		ContentFeatures f;
+		f.name = "stone";
+		c_stone = ndef->set(f.name, f);
+	}
+	{
+		ContentFeatures f;
+		f.name = "wood";
+		f.param_type_2 = CPT2_FACEDIR;
+		ndef->set(f.name, f);
+	}
+	{
+		ContentFeatures f;
+		f.name = "glass";
+		ndef->set(f.name, f);
+	}
+	ndef->setNodeRegistrationStatus(true);
+
+	// A large building: floors, walls with windows and some rubble
+	const v3s16 size(96, 64, 96);
+	Schematic schem;
+	schem.size = size;
+	schem.schemdata = new MapNode[size.X * size.Y * size.Z];
+	schem.slice_probs = new u8[size.Y];
+	for (s16 y = 0; y != size.Y; y++)
+		schem.slice_probs[y] = APRSCHEM_PROB_ALWAYS;
+	// Not resolved, content is an index into the names
+	schem.m_nodenames = {"air", "stone", "wood", "glass"};
+	const content_t i_air = 0, i_stone = 1, i_wood = 2, i_glass = 3;
+	u32 i = 0;
+	for (s16 z = 0; z != size.Z; z++)
+	for (s16 y = 0; y != size.Y; y++)
+	for (s16 x = 0; x != size.X; x++, i++) {
+		MapNode n(i_air, APRSCHEM_PROB_ALWAYS, 0);
+		bool wall = x % 12 == 0 || z % 12 == 0;
+		if (y % 8 == 0)
+			n = MapNode(i_stone, APRSCHEM_PROB_ALWAYS, 0);
+		else if (wall && (y % 8 == 4 || y % 8 == 5) && (x + z) % 4 == 1)
+			n = MapNode(i_glass, APRSCHEM_PROB_ALWAYS, 0);
+		else if (wall)
+			n = MapNode(i_wood, APRSCHEM_PROB_ALWAYS, (x * 7 + y * 3 + z) % 4);
+		else if ((x * 31 + y * 17 + z * 13) % 97 == 0)
+			n = MapNode(i_stone, 40, 0);
+		schem.schemdata[i] = n;
+	}
+
+	const std::string path_cache = porting::path_cache;
+	porting::path_cache = fs::CreateTempDir();
+	const std::string file = porting::path_cache + DIR_DELIM "building.mts";
+	REQUIRE(schem.saveSchematicToFile(file, ndef));
+
+	auto load = [&] () {
+		Schematic loaded;
+		bool ok = loaded.loadSchematicFromFile(file, ndef);
+		return ok && loaded.schemdata[0].getContent() == c_stone;
+	};
+
+	g_settings->setBool("schematic_cache", false);
+	BENCHMARK("loadSchematicFromFile_mts") {
+		return load();
+	};
+
+	g_settings->setBool("schematic_cache", true);
+	// Writes the cache file
+	REQUIRE(load());
+	BENCHMARK("loadSchematicFromFile_cached") {
+		return load();
+	};
+	g_settings->remove("schematic_cache");
+
+	// One clone for each emerge thread
+	Schematic loaded;
+	REQUIRE(loaded.loadSchematicFromFile(file, ndef));
+	BENCHMARK("Schematic::clone_x8") {
+		std::vector<std::unique_ptr<ObjDef>> clones;
+		for (int i = 0; i < 8; i++)
+			clones.emplace_back(loaded.clone());
+		return clones.size();
+	};
+
+	fs::RecursiveDelete(porting::path_cache);
+	porting::path_cache = path_cache;
+}
@@ -19,6 +19,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "catch.h"
 #include "util/serialize.h"
+#include "mapblock.h"
+#include "serialization.h"
+#include "pcg_random.h"
+#include "dummygamedef.h"
 #include <sstream>
 #include <ios>
 
@@ -69,3 +73,262 @@ static std::string makeRepeatTo(const std::string &s, size_t length)
 TEST_CASE("benchmark_serialize") {
 	BENCH_ALL()
 }
+
+// Fills a block with a few distinct contents in layers, roughly like
+// an underground block with some ores sprinkled in
+static void fillBlock(MapBlock &block, const std::vector<content_t> &contents,
+		u64 seed = 0x9e3779b9)
+{
+	PcgRandom r(seed);
+	MapNode *data = block.getData();
+	for (u32 i = 0; i < MapBlock::nodecount; i++) {
+		u32 layer = i / (MapBlock::nodecount / 4);
+		content_t c = contents[layer % contents.size()];
+		if (r.range(0, 15) == 0)
+			c = contents[r.range(0, contents.size() - 1)];
+		data[i] = MapNode(c, r.range(0, 15), 0);
+	}
+}
+
+TEST_CASE("benchmark_serialize_mapblock") {
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	std::vector<content_t> contents;
+	for (int i = 0; i < 8; i++) {
+		ContentFeatures f;
+		f.name = "test:node_" + std::to_string(i);
+		contents.push_back(ndef->set(f.name, f));
+	}
+
+	MapBlock block({}, &gamedef);
+	fillBlock(block, contents);
+
+	BENCHMARK_ADVANCED("MapBlock::serialize_disk")(Catch::Benchmark::Chronometer meter) {
+		std::ostringstream os(std::ios_base::binary);
+		meter.measure([&] {
+			os.str("");
+			block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, true, -1);
+			return os.tellp();
+		});
+	};
+
+	std::string serialized;
+	{
+		std::ostringstream os(std::ios_base::binary);
+		block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, true, -1);
+		serialized = os.str();
+	}
+
+	BENCHMARK_ADVANCED("MapBlock::deSerialize_disk")(Catch::Benchmark::Chronometer meter) {
+		MapBlock block2({}, &gamedef);
+		meter.measure([&] {
+			std::istringstream is(serialized, std::ios_base::binary);
+			block2.deSerialize(is, SER_FMT_VER_HIGHEST_WRITE, true);
+			return block2.getData()[0].getContent();
+		});
+	};
+
+	const Buffer<u8> bulk = MapNode::serializeBulk(SER_FMT_VER_HIGHEST_WRITE,
+			block.getData(), MapBlock::nodecount, 2, 2);
+
+	BENCHMARK_ADVANCED("MapNode::serializeBulk")(Catch::Benchmark::Chronometer meter) {
+		meter.measure([&] {
+			return MapNode::serializeBulk(SER_FMT_VER_HIGHEST_WRITE,
+					block.getData(), MapBlock::nodecount, 2, 2).getSize();
+		});
+	};
+
+	BENCHMARK_ADVANCED("MapNode::deSerializeBulk")(Catch::Benchmark::Chronometer meter) {
+		std::string s(reinterpret_cast<const char *>(*bulk), bulk.getSize());
+		MapBlock block2({}, &gamedef);
+		meter.measure([&] {
+			std::istringstream is(s, std::ios_base::binary);
+			MapNode::deSerializeBulk(is, SER_FMT_VER_HIGHEST_WRITE,
+					block2.getData(), MapBlock::nodecount, 2, 2);
+			return block2.getData()[0].getContent();
+		});
+	};
+}
+
+TEST_CASE("benchmark_serialize_dictionary") {
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	std::vector<content_t> contents;
+	for (int i = 0; i < 8; i++) {
+		ContentFeatures f;
+		f.name = "test:node_" + std::to_string(i);
+		contents.push_back(ndef->set(f.name, f));
+	}
+
+	// Serialize a bunch of (slightly different) blocks, uncompressed
+	std::vector<std::string> samples;
+	for (int i = 0; i < 500; i++) {
+		MapBlock block({}, &gamedef);
+		std::vector<content_t> block_contents(contents.begin() + (i % 4),
+				contents.begin() + (i % 4) + 4);
+		fillBlock(block, block_contents, i);
+
+		std::ostringstream os(std::ios_base::binary);
+		block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, true, -1);
+		std::istringstream is(os.str(), std::ios_base::binary);
+		std::ostringstream raw(std::ios_base::binary);
+		decompressZstd(is, raw);
+		samples.push_back(raw.str());
+	}
+
+	auto dict = std::make_shared<ZstdDictionary>(trainZstdDictionary(samples, 112640));
+	registerZstdDictionary(dict);
+
+	std::vector<std::string> plain, with_dict;
+	size_t size_raw = 0, size_plain = 0, size_dict = 0;
+	for (const auto &sample : samples) {
+		std::ostringstream os1(std::ios_base::binary), os2(std::ios_base::binary);
+		compressZstd(sample, os1);
+		compressZstd(sample, os2, 0, dict.get());
+		plain.push_back(os1.str());
+		with_dict.push_back(os2.str());
+		size_raw += sample.size();
+		size_plain += plain.back().size();
+		size_dict += with_dict.back().size();
+	}
+	WARN("raw " << size_raw << " bytes, zstd " << size_plain << " bytes, zstd+dict "
+		<< size_dict << " bytes (" << (100.0f * size_dict / size_plain) << "%)");
+
+	BENCHMARK_ADVANCED("compressZstd_plain")(Catch::Benchmark::Chronometer meter) {
+		std::ostringstream os(std::ios_base::binary);
+		meter.measure([&] (int i) {
+			os.str("");
+			compressZstd(samples[i % samples.size()], os);
+			return os.tellp();
+		});
+	};
+
+	BENCHMARK_ADVANCED("compressZstd_dictionary")(Catch::Benchmark::Chronometer meter) {
+		std::ostringstream os(std::ios_base::binary);
+		meter.measure([&] (int i) {
+			os.str("");
+			compressZstd(samples[i % samples.size()], os, 0, dict.get());
+			return os.tellp();
+		});
+	};
+
+	BENCHMARK_ADVANCED("decompressZstd_plain")(Catch::Benchmark::Chronometer meter) {
+		std::ostringstream os(std::ios_base::binary);
+		meter.measure([&] (int i) {
+			std::istringstream is(plain[i % plain.size()], std::ios_base::binary);
+			os.str("");
+			decompressZstd(is, os);
+			return os.tellp();
+		});
+	};
+
+	BENCHMARK_ADVANCED("decompressZstd_dictionary")(Catch::Benchmark::Chronometer meter) {
+		std::ostringstream os(std::ios_base::binary);
+		meter.measure([&] (int i) {
+			std::istringstream is(with_dict[i % with_dict.size()], std::ios_base::binary);
+			os.str("");
+			decompressZstd(is, os);
+			return os.tellp();
+		});
+	};
+}
+
+TEST_CASE("benchmark_serialize_buffers") {
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+
+	std::vector<content_t> contents;
+	for (int i = 0; i < 8; i++) {
+		ContentFeatures f;
+		f.name = "test:node_" + std::to_string(i);
+		contents.push_back(ndef->set(f.name, f));
+	}
+
+	// Uncompressed block data, the typical input
+	MapBlock block({}, &gamedef);
+	fillBlock(block, contents);
+	std::string raw;
+	{
+		std::ostringstream os(std::ios_base::binary);
+		block.serialize(os, SER_FMT_VER_HIGHEST_WRITE, true, -1);
+		std::istringstream is(os.str(), std::ios_base::binary);
+		std::ostringstream os_raw(std::ios_base::binary);
+		decompressZstd(is, os_raw);
+		raw = os_raw.str();
+	}
+
+	std::ostringstream zstd_os(std::ios_base::binary), zlib_os(std::ios_base::binary);
+	compressZstd(raw, zstd_os);
+	compressZlib(raw, zlib_os);
+	const std::string zstd_data = zstd_os.str(), zlib_data = zlib_os.str();
+
+	BENCHMARK_ADVANCED("compressZstd_stream")(Catch::Benchmark::Chronometer meter) {
+		meter.measure([&] {
+			std::ostringstream os(std::ios_base::binary);
+			compressZstd(raw, os);
+			return os.str().size();
+		});
+	};
+
+	BENCHMARK_ADVANCED("compressZstd_buffer")(Catch::Benchmark::Chronometer meter) {
+		std::string out;
+		meter.measure([&] {
+			out.clear();
+			compressZstd(raw, out);
+			return out.size();
+		});
+	};
+
+	BENCHMARK_ADVANCED("decompressZstd_stream")(Catch::Benchmark::Chronometer meter) {
+		meter.measure([&] {
+			std::istringstream is(zstd_data, std::ios_base::binary);
+			std::ostringstream os(std::ios_base::binary);
+			decompressZstd(is, os);
+			return os.str().size();
+		});
+	};
+
+	BENCHMARK_ADVANCED("decompressZstd_buffer")(Catch::Benchmark::Chronometer meter) {
+		std::string out;
+		meter.measure([&] {
+			out.clear();
+			return decompressZstd(zstd_data, out);
+		});
+	};
+
+	BENCHMARK_ADVANCED("compressZlib_stream")(Catch::Benchmark::Chronometer meter) {
+		meter.measure([&] {
+			std::ostringstream os(std::ios_base::binary);
+			compressZlib(raw, os);
+			return os.str().size();
+		});
+	};
+
+	BENCHMARK_ADVANCED("compressZlib_buffer")(Catch::Benchmark::Chronometer meter) {
+		std::string out;
+		meter.measure([&] {
+			out.clear();
+			compressZlib(raw, out);
+			return out.size();
+		});
+	};
+
+	BENCHMARK_ADVANCED("decompressZlib_stream")(Catch::Benchmark::Chronometer meter) {
+		meter.measure([&] {
+			std::istringstream is(zlib_data, std::ios_base::binary);
+			std::ostringstream os(std::ios_base::binary);
+			decompressZlib(is, os);
+			return os.str().size();
+		});
+	};
+
+	BENCHMARK_ADVANCED("decompressZlib_buffer")(Catch::Benchmark::Chronometer meter) {
+		std::string out;
+		meter.measure([&] {
+			out.clear();
+			return decompressZlib(zlib_data, out);
+		});
+	};
+}
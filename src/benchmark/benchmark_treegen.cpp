@@ -0,0 +1,86 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "catch.h"
+#include "dummygamedef.h"
+#include "dummymap.h"
+#include "mapgen/treegen.h"
+#include "pcg_random.h"
+#include <vector>
+
+static treegen::TreeDef make_tree_def(NodeDefManager *ndef)
+{
+	treegen::TreeDef def;
+	def.trunknode = MapNode(ndef->getId("tree"));
+	def.leavesnode = MapNode(ndef->getId("leaves"));
+	def.leaves2node = MapNode(ndef->getId("leaves"));
+	def.fruitnode = MapNode(ndef->getId("apple"));
+	def.leaves2_chance = 0;
+	def.angle = 30;
+	def.iterations = 2;
+	def.iterations_random_level = 0;
+	def.trunk_type = "single";
+	def.thin_branches = true;
+	def.fruit_chance = 0;
+	def.seed = 0;
+	def.explicit_seed = false;
+	return def;
+}
+
+TEST_CASE("benchmark_treegen")
+{
+	DummyGameDef gamedef;
+	NodeDefManager *ndef = gamedef.getWritableNodeDefManager();
+	for (const char *name : {"tree", "leaves", "apple"}) {
+		ContentFeatures f;
+		f.name = name;
+		ndef->set(f.name, f);
+	}
+	ndef->setNodeRegistrationStatus(true);
+
+	// Apple tree from the Lua API documentation
+	treegen::TreeDef apple_tree = make_tree_def(ndef);
+	apple_tree.initial_axiom = "FFFFFAFFBF";
+	apple_tree.rules_a = "[&&&FFFFF&&FFFF][&&&++++FFFFF&&FFFF][&&&----FFFFF&&FFFF]";
+	apple_tree.rules_b = "[&&&++FFFF&&FFFF][&&&--FFFF&&FFFF][&&&------FFFF&&FFFF]";
+	apple_tree.fruit_chance = 10;
+
+	// Large jungle tree with random branches
+	treegen::TreeDef jungle_tree = make_tree_def(ndef);
+	jungle_tree.initial_axiom = "TTTTTTTTA";
+	jungle_tree.rules_a = "FF[&&-FbB][&&+FbB][&&---FbB][&&/FbB]a";
+	jungle_tree.rules_b = "[&FFf/Gf][^Ff]";
+	jungle_tree.iterations = 5;
+	jungle_tree.iterations_random_level = 1;
+	jungle_tree.trunk_type = "double";
+	jungle_tree.thin_branches = true;
+
+	// A mapchunk with its border blocks
+	const v3s16 bpmin(-1, -1, -1), bpmax(5, 5, 5);
+	DummyMap map(&gamedef, bpmin, bpmax);
+	MMVManip vm(&map);
+	vm.initialEmerge(bpmin, bpmax, false);
+	const u32 volume = vm.m_area.getVolume();
+
+	PcgRandom pr(42);
+	std::vector<v3s16> positions;
+	for (int i = 0; i < 1000; i++)
+		positions.emplace_back(pr.range(0, 79), pr.range(0, 20), pr.range(0, 79));
+
+	auto spawn_trees = [&] (const treegen::TreeDef &def) {
+		for (u32 i = 0; i < volume; i++)
+			vm.m_data[i] = MapNode(CONTENT_AIR);
+		int errors = 0;
+		for (v3s16 p : positions)
+			errors += treegen::make_ltree(vm, p, def) != treegen::SUCCESS;
+		return errors;
+	};
+
+	BENCHMARK("make_ltree_1000_apple_trees") {
+		return spawn_trees(apple_tree);
+	};
+
+	BENCHMARK("make_ltree_1000_jungle_trees") {
+		return spawn_trees(jungle_tree);
+	};
+}
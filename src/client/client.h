@@ -195,6 +195,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void handleCommand_Breath(NetworkPacket* pkt);
 	void handleCommand_MovePlayer(NetworkPacket* pkt);
 	void handleCommand_MovePlayerRel(NetworkPacket* pkt);
+	void handleCommand_MapDictionary(NetworkPacket* pkt);
 	void handleCommand_DeathScreenLegacy(NetworkPacket* pkt);
 	void handleCommand_AnnounceMedia(NetworkPacket* pkt);
 	void handleCommand_Media(NetworkPacket* pkt);
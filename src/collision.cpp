@@ -18,7 +18,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "collision.h"
+#include <algorithm>
 #include <cmath>
+#include <functional>
+#include <unordered_map>
 #include "mapblock.h"
 #include "map.h"
 #include "nodedef.h"
@@ -31,6 +34,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server/serveractiveobject.h"
 #include "util/timetaker.h"
 #include "profiler.h"
+#include "threading/task_pool.h"
+#include "voxel.h"
 
 #ifdef __FAST_MATH__
 #warning "-ffast-math is known to cause bugs in collision code, do not use!"
@@ -218,56 +223,75 @@ bool wouldCollideWithCeiling(
 	return false;
 }
 
+// Adds the collision boxes of the node at p, returns whether the position
+// is valid, i.e. loaded and not CONTENT_IGNORE
+static bool add_node_boxes(const v3s16 p, Map *map, const NodeDefManager *nodedef,
+		std::vector<NearbyCollisionInfo> &cinfo)
+{
+	thread_local std::vector<aabb3f> nodeboxes;
+
+	bool is_position_valid;
+	MapNode n = map->getNode(p, &is_position_valid);
+
+	if (is_position_valid && n.getContent() != CONTENT_IGNORE) {
+		// Object collides into walkable nodes
+		const ContentFeatures &f = nodedef->get(n);
+
+		if (!f.walkable)
+			return true;
+
+		// Negative bouncy may have a meaning, but we need +value here.
+		int n_bouncy_value = abs(itemgroup_get(f.groups, "bouncy"));
+
+		u8 neighbors = n.getNeighbors(p, map);
+
+		nodeboxes.clear();
+		n.getCollisionBoxes(nodedef, &nodeboxes, neighbors);
+
+		// Calculate float position only once
+		v3f posf = intToFloat(p, BS);
+		for (auto box : nodeboxes) {
+			box.MinEdge += posf;
+			box.MaxEdge += posf;
+			cinfo.emplace_back(false, n_bouncy_value, p, box);
+		}
+		return true;
+	}
+
+	// Collide with unloaded nodes (position invalid) and loaded
+	// CONTENT_IGNORE nodes (position valid)
+	aabb3f box = getNodeBox(p, BS);
+	cinfo.emplace_back(true, 0, p, box);
+	return false;
+}
+
 static bool add_area_node_boxes(const v3s16 min, const v3s16 max, IGameDef *gamedef,
 		Environment *env, std::vector<NearbyCollisionInfo> &cinfo)
 {
 	const auto *nodedef = gamedef->getNodeDefManager();
 	bool any_position_valid = false;
 
-	thread_local std::vector<aabb3f> nodeboxes;
 	Map *map = &env->getMap();
 
 	v3s16 p;
 	for (p.Z = min.Z; p.Z <= max.Z; p.Z++)
 	for (p.Y = min.Y; p.Y <= max.Y; p.Y++)
 	for (p.X = min.X; p.X <= max.X; p.X++) {
-		bool is_position_valid;
-		MapNode n = map->getNode(p, &is_position_valid);
-
-		if (is_position_valid && n.getContent() != CONTENT_IGNORE) {
-			// Object collides into walkable nodes
-
+		if (add_node_boxes(p, map, nodedef, cinfo))
 			any_position_valid = true;
-			const ContentFeatures &f = nodedef->get(n);
-
-			if (!f.walkable)
-				continue;
-
-			// Negative bouncy may have a meaning, but we need +value here.
-			int n_bouncy_value = abs(itemgroup_get(f.groups, "bouncy"));
-
-			u8 neighbors = n.getNeighbors(p, map);
-
-			nodeboxes.clear();
-			n.getCollisionBoxes(nodedef, &nodeboxes, neighbors);
-
-			// Calculate float position only once
-			v3f posf = intToFloat(p, BS);
-			for (auto box : nodeboxes) {
-				box.MinEdge += posf;
-				box.MaxEdge += posf;
-				cinfo.emplace_back(false, n_bouncy_value, p, box);
-			}
-		} else {
-			// Collide with unloaded nodes (position invalid) and loaded
-			// CONTENT_IGNORE nodes (position valid)
-			aabb3f box = getNodeBox(p, BS);
-			cinfo.emplace_back(true, 0, p, box);
-		}
 	}
 	return any_position_valid;
 }
 
+// Distance of the objects that a move can collide with
+static inline f32 object_search_distance(const aabb3f &box_0, f32 dtime,
+		const v3f speed_f)
+{
+	// Calculate distance by speed, add own extent and 1.5m of tolerance
+	return speed_f.getLength() * dtime +
+		box_0.getExtent().getLength() + 1.5f * BS;
+}
+
 static void add_object_boxes(Environment *env,
 		const aabb3f &box_0, f32 dtime,
 		const v3f pos_f, const v3f speed_f, ActiveObject *self,
@@ -281,9 +305,7 @@ static void add_object_boxes(Environment *env,
 		}
 	};
 
-	// Calculate distance by speed, add own extent and 1.5m of tolerance
-	const f32 distance = speed_f.getLength() * dtime +
-		box_0.getExtent().getLength() + 1.5f * BS;
+	const f32 distance = object_search_distance(box_0, dtime, speed_f);
 
 #ifndef SERVER
 	ClientEnvironment *c_env = dynamic_cast<ClientEnvironment*>(env);
@@ -333,42 +355,33 @@ static void add_object_boxes(Environment *env,
 	}
 }
 
-#define PROFILER_NAME(text) (dynamic_cast<ServerEnvironment*>(env) ? ("Server: " text) : ("Client: " text))
-
-collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
-		f32 pos_max_d, const aabb3f &box_0,
-		f32 stepheight, f32 dtime,
-		v3f *pos_f, v3f *speed_f,
-		v3f accel_f, ActiveObject *self,
-		bool collide_with_objects)
+/*
+	Calculate new velocity. Returns false if the object doesn't move, otherwise
+	min and max receive the area of nodes that it can collide with.
+*/
+static bool collision_move_area(f32 *dtime, const aabb3f &box_0,
+		const v3f pos_f, v3f *speed_f, v3f accel_f, v3s16 *min, v3s16 *max)
 {
 	static bool time_notification_done = false;
 
-	ScopeProfiler sp(g_profiler, PROFILER_NAME("collisionMoveSimple()"), SPT_AVG, PRECISION_MICRO);
-
-	collisionMoveResult result;
-
-	/*
-		Calculate new velocity
-	*/
-	if (dtime > DTIME_LIMIT) {
+	if (*dtime > DTIME_LIMIT) {
 		if (!time_notification_done) {
 			time_notification_done = true;
 			warningstream << "collisionMoveSimple: maximum step interval exceeded,"
 					" lost movement details!"<< '\n';
 		}
-		dtime = DTIME_LIMIT;
+		*dtime = DTIME_LIMIT;
 	} else {
 		time_notification_done = false;
 	}
 
-	v3f dpos_f = (*speed_f + accel_f * 0.5f * dtime) * dtime;
-	v3f newpos_f = *pos_f + dpos_f;
-	*speed_f += accel_f * dtime;
+	v3f dpos_f = (*speed_f + accel_f * 0.5f * *dtime) * *dtime;
+	v3f newpos_f = pos_f + dpos_f;
+	*speed_f += accel_f * *dtime;
 
 	// If the object is static, there are no collisions
 	if (dpos_f == v3f())
-		return result;
+		return false;
 
 	// Limit speed for avoiding hangs
 	speed_f->Y = rangelim(speed_f->Y, -5000, 5000);
@@ -377,47 +390,26 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 
 	*speed_f = truncate(*speed_f, 10000.0f);
 
-	/*
-		Collect node boxes in movement range
-	*/
-
-	// cached allocation
-	thread_local std::vector<NearbyCollisionInfo> cinfo;
-	cinfo.clear();
-
-	{
-		v3f minpos_f(
-			MYMIN(pos_f->X, newpos_f.X),
-			MYMIN(pos_f->Y, newpos_f.Y) + 0.01f * BS, // bias rounding, player often at +/-n.5
-			MYMIN(pos_f->Z, newpos_f.Z)
-		);
-		v3f maxpos_f(
-			MYMAX(pos_f->X, newpos_f.X),
-			MYMAX(pos_f->Y, newpos_f.Y),
-			MYMAX(pos_f->Z, newpos_f.Z)
-		);
-		v3s16 min = floatToInt(minpos_f + box_0.MinEdge, BS) - v3s16(1, 1, 1);
-		v3s16 max = floatToInt(maxpos_f + box_0.MaxEdge, BS) + v3s16(1, 1, 1);
-
-		bool any_position_valid = add_area_node_boxes(min, max, gamedef, env, cinfo);
-
-		// Do not move if world has not loaded yet, since custom node boxes
-		// are not available for collision detection.
-		// This also intentionally occurs in the case of the object being positioned
-		// solely on loaded CONTENT_IGNORE nodes, no matter where they come from.
-		if (!any_position_valid) {
-			*speed_f = v3f(0, 0, 0);
-			return result;
-		}
-	}
-
-	/*
-		Collect object boxes in movement range
-	*/
-	if (collide_with_objects) {
-		add_object_boxes(env, box_0, dtime, *pos_f, *speed_f, self, cinfo);
-	}
+	v3f minpos_f(
+		MYMIN(pos_f.X, newpos_f.X),
+		MYMIN(pos_f.Y, newpos_f.Y) + 0.01f * BS, // bias rounding, player often at +/-n.5
+		MYMIN(pos_f.Z, newpos_f.Z)
+	);
+	v3f maxpos_f(
+		MYMAX(pos_f.X, newpos_f.X),
+		MYMAX(pos_f.Y, newpos_f.Y),
+		MYMAX(pos_f.Z, newpos_f.Z)
+	);
+	*min = floatToInt(minpos_f + box_0.MinEdge, BS) - v3s16(1, 1, 1);
+	*max = floatToInt(maxpos_f + box_0.MaxEdge, BS) + v3s16(1, 1, 1);
+	return true;
+}
 
+// Moves the object through the collected boxes
+static void collision_move_solve(std::vector<NearbyCollisionInfo> &cinfo,
+		const aabb3f &box_0, f32 stepheight, f32 dtime,
+		v3f *pos_f, v3f *speed_f, collisionMoveResult &result)
+{
 	/*
 		Collision detection
 	*/
@@ -592,7 +584,54 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 			}
 		}
 	}
+}
+
+#define PROFILER_NAME(text) (dynamic_cast<ServerEnvironment*>(env) ? ("Server: " text) : ("Client: " text))
+
+collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
+		f32 pos_max_d, const aabb3f &box_0,
+		f32 stepheight, f32 dtime,
+		v3f *pos_f, v3f *speed_f,
+		v3f accel_f, ActiveObject *self,
+		bool collide_with_objects)
+{
+	ScopeProfiler sp(g_profiler, PROFILER_NAME("collisionMoveSimple()"), SPT_AVG, PRECISION_MICRO);
 
+	collisionMoveResult result;
+
+	v3s16 min, max;
+	if (!collision_move_area(&dtime, box_0, *pos_f, speed_f, accel_f, &min, &max))
+		return result;
+
+	/*
+		Collect node boxes in movement range
+	*/
+
+	// cached allocation
+	thread_local std::vector<NearbyCollisionInfo> cinfo;
+	cinfo.clear();
+
+	{
+		bool any_position_valid = add_area_node_boxes(min, max, gamedef, env, cinfo);
+
+		// Do not move if world has not loaded yet, since custom node boxes
+		// are not available for collision detection.
+		// This also intentionally occurs in the case of the object being positioned
+		// solely on loaded CONTENT_IGNORE nodes, no matter where they come from.
+		if (!any_position_valid) {
+			*speed_f = v3f(0, 0, 0);
+			return result;
+		}
+	}
+
+	/*
+		Collect object boxes in movement range
+	*/
+	if (collide_with_objects) {
+		add_object_boxes(env, box_0, dtime, *pos_f, *speed_f, self, cinfo);
+	}
+
+	collision_move_solve(cinfo, box_0, stepheight, dtime, pos_f, speed_f, result);
 	return result;
 }
 
@@ -638,3 +677,261 @@ bool collision_check_intersection(Environment *env, IGameDef *gamedef,
 
 	return false;
 }
+
+namespace {
+
+// Node boxes of an area, collected once for all moves inside of it
+struct NodeBoxRegion
+{
+	VoxelArea area;
+	std::vector<NearbyCollisionInfo> boxes;
+	// Boxes of the node with index i are boxes[first[i]] to boxes[first[i + 1]]
+	std::vector<u32> first;
+	std::vector<bool> valid;
+
+	NodeBoxRegion(const VoxelArea &area) : area(area) {}
+
+	void collect(Map *map, const NodeDefManager *nodedef)
+	{
+		const u32 volume = area.getVolume();
+		first.resize(volume + 1);
+		valid.resize(volume);
+		u32 i = 0;
+		v3s16 p;
+		for (p.Z = area.MinEdge.Z; p.Z <= area.MaxEdge.Z; p.Z++)
+		for (p.Y = area.MinEdge.Y; p.Y <= area.MaxEdge.Y; p.Y++)
+		for (p.X = area.MinEdge.X; p.X <= area.MaxEdge.X; p.X++, i++) {
+			first[i] = boxes.size();
+			valid[i] = add_node_boxes(p, map, nodedef, boxes);
+		}
+		first[volume] = boxes.size();
+	}
+
+	// Same as add_area_node_boxes, the area must be inside of the region
+	bool addBoxes(v3s16 min, v3s16 max,
+			std::vector<NearbyCollisionInfo> &cinfo) const
+	{
+		bool any_position_valid = false;
+		for (s16 z = min.Z; z <= max.Z; z++)
+		for (s16 y = min.Y; y <= max.Y; y++) {
+			const u32 i0 = area.index(min.X, y, z);
+			const u32 i1 = i0 + (max.X - min.X) + 1;
+			for (u32 i = i0; i < i1; i++)
+				any_position_valid |= valid[i];
+			cinfo.insert(cinfo.end(), boxes.begin() + first[i0],
+				boxes.begin() + first[i1]);
+		}
+		return any_position_valid;
+	}
+};
+
+struct ObjectBox
+{
+	ActiveObject *obj;
+	ActiveObject *parent;
+	v3f pos;
+	aabb3f box;
+};
+
+// Collision boxes of the objects around the moves, to look up by position
+class ObjectBoxGrid
+{
+public:
+	void collect(ServerEnvironment *env, const aabb3f &area)
+	{
+		auto include_obj_cb = [this] (ServerActiveObject *obj) {
+			aabb3f box;
+			if (!obj->isGone() && obj->collideWithObjects() &&
+					obj->getCollisionBox(&box)) {
+				m_cells[cellOf(obj->getBasePosition())].push_back(m_objects.size());
+				m_objects.push_back({obj, obj->getParent(),
+					obj->getBasePosition(), box});
+			}
+			return false;
+		};
+		// nothing is put into this vector
+		std::vector<ServerActiveObject*> s_objects;
+		env->getObjectsInArea(s_objects, area, include_obj_cb);
+	}
+
+	// Same as add_object_boxes on the server
+	void addBoxes(const v3f pos, f32 distance, ActiveObject *self,
+			std::vector<NearbyCollisionInfo> &cinfo) const
+	{
+		thread_local std::vector<u32> found;
+		found.clear();
+
+		const v3s16 min = cellOf(pos - distance), max = cellOf(pos + distance);
+		const v3s32 extent = v3s32(max.X, max.Y, max.Z) -
+			v3s32(min.X, min.Y, min.Z) + v3s32(1, 1, 1);
+		if ((u64)extent.X * extent.Y * extent.Z > m_cells.size()) {
+			for (const auto &it : m_cells)
+				found.insert(found.end(), it.second.begin(), it.second.end());
+		} else {
+			v3s16 p;
+			for (p.Z = min.Z; p.Z <= max.Z; p.Z++)
+			for (p.Y = min.Y; p.Y <= max.Y; p.Y++)
+			for (p.X = min.X; p.X <= max.X; p.X++) {
+				auto it = m_cells.find(p);
+				if (it != m_cells.end())
+					found.insert(found.end(), it->second.begin(), it->second.end());
+			}
+		}
+		// In the order of the object ids, like the environment has them
+		std::sort(found.begin(), found.end());
+
+		const f32 r2 = distance * distance;
+		for (u32 i : found) {
+			const ObjectBox &o = m_objects[i];
+			if (o.pos.getDistanceFromSQ(pos) > r2)
+				continue;
+			// Do collide with everything but itself and children
+			if (self && (self == o.obj || self == o.parent))
+				continue;
+			cinfo.emplace_back(o.obj, 0, o.box);
+		}
+	}
+
+private:
+	static v3s16 cellOf(const v3f pos)
+	{
+		return floatToInt(pos, CELL_SIZE * BS);
+	}
+
+	static constexpr f32 CELL_SIZE = 8.0f;
+
+	std::vector<ObjectBox> m_objects;
+	std::unordered_map<v3s16, std::vector<u32>> m_cells;
+};
+
+}
+
+void collisionMoveBatch(Environment *env, IGameDef *gamedef,
+		std::vector<CollisionMoveJob> &jobs, TaskPool *pool)
+{
+	ScopeProfiler sp(g_profiler, PROFILER_NAME("collisionMoveBatch()"), SPT_AVG, PRECISION_MICRO);
+
+	// Largest area that moves share node boxes of
+	constexpr s32 MAX_SHARED_VOLUME = 1 << 18;
+
+	struct Move {
+		CollisionMoveJob *job;
+		f32 dtime;
+		v3s16 min, max;
+		f32 object_distance;
+		u32 region;
+	};
+	std::vector<Move> moves;
+	moves.reserve(jobs.size());
+
+	aabb3f object_area;
+	bool any_objects = false;
+	for (CollisionMoveJob &job : jobs) {
+		job.new_pos = job.pos;
+		job.new_speed = job.speed;
+		job.result = collisionMoveResult();
+
+		Move move;
+		move.job = &job;
+		move.dtime = job.dtime;
+		if (!collision_move_area(&move.dtime, job.box, job.pos, &job.new_speed,
+				job.accel, &move.min, &move.max))
+			continue;
+
+		if (job.collide_with_objects) {
+			move.object_distance = object_search_distance(job.box, move.dtime,
+				job.new_speed);
+			aabb3f search(job.pos - move.object_distance - BS,
+				job.pos + move.object_distance + BS);
+			if (any_objects)
+				object_area.addInternalBox(search);
+			else
+				object_area = search;
+			any_objects = true;
+		}
+		moves.push_back(move);
+	}
+
+	/*
+		Collect node boxes, once for the moves close to each other
+		if that means visiting fewer nodes
+	*/
+	std::unordered_map<v3s16, std::vector<u32>> groups;
+	for (u32 i = 0; i < moves.size(); i++) {
+		v3s16 center = (moves[i].min + moves[i].max) / 2;
+		groups[v3s16(center.X >> 3, center.Y >> 3, center.Z >> 3)].push_back(i);
+	}
+
+	std::vector<NodeBoxRegion> regions;
+	for (const auto &it : groups) {
+		VoxelArea shared;
+		s64 volume_sum = 0;
+		for (u32 i : it.second) {
+			VoxelArea area(moves[i].min, moves[i].max);
+			shared.addArea(area);
+			volume_sum += area.getVolume();
+		}
+		if (it.second.size() > 1 && shared.getVolume() <= volume_sum &&
+				shared.getVolume() <= MAX_SHARED_VOLUME) {
+			for (u32 i : it.second)
+				moves[i].region = regions.size();
+			regions.emplace_back(shared);
+		} else {
+			for (u32 i : it.second) {
+				moves[i].region = regions.size();
+				regions.emplace_back(VoxelArea(moves[i].min, moves[i].max));
+			}
+		}
+	}
+
+	Map *map = &env->getMap();
+	const NodeDefManager *nodedef = gamedef->getNodeDefManager();
+	for (NodeBoxRegion &region : regions)
+		region.collect(map, nodedef);
+
+	ObjectBoxGrid objects;
+	if (any_objects) {
+		if (auto *s_env = dynamic_cast<ServerEnvironment*>(env))
+			objects.collect(s_env, object_area);
+	}
+
+	/*
+		Do the moves, these only read what was collected above
+	*/
+	auto run_moves = [&] (size_t begin, size_t end) {
+		thread_local std::vector<NearbyCollisionInfo> cinfo;
+		for (size_t i = begin; i < end; i++) {
+			const Move &move = moves[i];
+			CollisionMoveJob &job = *move.job;
+
+			cinfo.clear();
+			if (!regions[move.region].addBoxes(move.min, move.max, cinfo)) {
+				// See collisionMoveSimple
+				job.new_speed = v3f(0, 0, 0);
+				continue;
+			}
+			if (job.collide_with_objects)
+				objects.addBoxes(job.pos, move.object_distance, job.self, cinfo);
+
+			collision_move_solve(cinfo, job.box, job.stepheight, move.dtime,
+				&job.new_pos, &job.new_speed, job.result);
+		}
+	};
+
+	// Enough moves for each task to be worth it
+	constexpr size_t MIN_MOVES_PER_TASK = 16;
+	size_t num_tasks = pool ? std::min<size_t>(pool->getWorkerCount() + 1,
+		moves.size() / MIN_MOVES_PER_TASK) : 0;
+	if (num_tasks < 2) {
+		run_moves(0, moves.size());
+		return;
+	}
+
+	std::vector<std::function<void()>> tasks;
+	for (size_t t = 0; t < num_tasks; t++) {
+		size_t begin = moves.size() * t / num_tasks;
+		size_t end = moves.size() * (t + 1) / num_tasks;
+		tasks.emplace_back([&run_moves, begin, end] { run_moves(begin, end); });
+	}
+	pool->run(tasks);
+}
@@ -20,12 +20,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include "irrlichttypes_bloated.h"
+#include "constants.h"
 #include <vector>
 
 class Map;
 class IGameDef;
 class Environment;
 class ActiveObject;
+class TaskPool;
 
 enum CollisionType
 {
@@ -65,6 +67,30 @@ struct collisionMoveResult
 	std::vector<CollisionInfo> collisions;
 };
 
+/// Collision boxes of the nodes of a MapBlock, relative to each node. They are
+/// found for each node on first use and all dropped when a node changes.
+struct MapBlockCollisionBoxes
+{
+	enum Kind : u8 {
+		UNKNOWN, // not looked at yet
+		NONE, // not walkable
+		IGNORE, // CONTENT_IGNORE, collides like an unloaded node
+		UNIT, // a single box of the node's size
+		BOXES, // boxes[first] to boxes[first + count - 1]
+		LIVE, // depends on nodes of other blocks, not cached
+	};
+
+	struct Node {
+		Kind kind = UNKNOWN;
+		u8 bouncy = 0;
+		u8 count = 0;
+		u16 first = 0;
+	};
+
+	Node nodes[MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE];
+	std::vector<aabb3f> boxes;
+};
+
 /// @brief Moves using a single iteration; speed should not exceed pos_max_d/dtime
 /// @param self (optional) ActiveObject to ignore in the collision detection.
 collisionMoveResult collisionMoveSimple(Environment *env,IGameDef *gamedef,
@@ -74,6 +100,32 @@ collisionMoveResult collisionMoveSimple(Environment *env,IGameDef *gamedef,
 		v3f accel_f, ActiveObject *self=NULL,
 		bool collide_with_objects=true);
 
+/// Arguments and results of one move in collisionMoveBatch
+struct CollisionMoveJob
+{
+	// Like the arguments of collisionMoveSimple
+	aabb3f box;
+	f32 stepheight = 0.0f;
+	f32 dtime = 0.0f;
+	v3f pos;
+	v3f speed;
+	v3f accel;
+	ActiveObject *self = nullptr;
+	bool collide_with_objects = true;
+
+	// Position and speed after the move
+	v3f new_pos;
+	v3f new_speed;
+	collisionMoveResult result;
+};
+
+/// @brief Does collisionMoveSimple for many objects. Node boxes are collected
+///        once for objects close to each other and the moves run on `pool`
+///        if given. Objects collide with the others where they were before
+///        any of the moves, this is only done on the server.
+void collisionMoveBatch(Environment *env, IGameDef *gamedef,
+		std::vector<CollisionMoveJob> &jobs, TaskPool *pool = nullptr);
+
 /// @brief A simpler version of "collisionMoveSimple" that only checks whether
 ///        a collision occurs at the given position.
 /// @param self (optional) ActiveObject to ignore in the collision detection.
@@ -493,6 +493,7 @@ void set_default_settings()
 	settings->setDefault("chat_message_limit_trigger_kick", "50");
 	settings->setDefault("sqlite_synchronous", "2");
 	settings->setDefault("map_compression_level_disk", "-1");
+	settings->setDefault("map_compression_dictionary", "true");
 	settings->setDefault("map_compression_level_net", "-1");
 	settings->setDefault("full_block_send_enable_min_time_from_building", "2.0");
 	settings->setDefault("dedicated_server_step", "0.09");
@@ -531,6 +532,8 @@ void set_default_settings()
 	settings->setDefault("liquid_loop_max", "100000");
 	settings->setDefault("liquid_queue_purge_time", "0");
 	settings->setDefault("liquid_update", "1.0");
+	settings->setDefault("deferred_lighting", "false");
+	settings->setDefault("deferred_lighting_time_budget", "0.2");
 
 	// Mapgen
 	settings->setDefault("mg_name", "carpathian");
@@ -540,6 +543,7 @@ void set_default_settings()
 	settings->setDefault("fixed_map_seed", "");
 	settings->setDefault("max_block_generate_distance", "10");
 	settings->setDefault("enable_mapgen_debug_info", "false");
+	settings->setDefault("schematic_cache", "true");
 	Mapgen::setDefaultSettings(settings);
 
 	// Server list announcing
@@ -36,6 +36,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapgen/mg_biome.h"
 #include "mapgen/mg_ore.h"
 #include "mapgen/mg_decoration.h"
+#include "mapgen/mg_noise_cache.h"
+#include "mapgen/mg_stage_profiler.h"
 #include "mapgen/mg_schematic.h"
 #include "nodedef.h"
 #include "profiler.h"
@@ -66,7 +68,9 @@ EmergeParams::EmergeParams(EmergeManager *parent, const BiomeGen *biomegen,
 	gen_notify_on_deco_ids(&parent->gen_notify_on_deco_ids),
 	gen_notify_on_custom(&parent->gen_notify_on_custom),
 	biomemgr(biomemgr->clone()), oremgr(oremgr->clone()),
-	decomgr(decomgr->clone()), schemmgr(schemmgr->clone())
+	decomgr(decomgr->clone()), schemmgr(schemmgr->clone()),
+	noise_cache(parent->getNoiseCache()),
+	stage_profiler(parent->getStageProfiler())
 {
 	this->biomegen = biomegen->clone(this->biomemgr);
 }
@@ -82,6 +86,8 @@ EmergeManager::EmergeManager(Server *server, MetricsBackend *mb)
 	this->oremgr    = new OreManager(server);
 	this->decomgr   = new DecorationManager(server);
 	this->schemmgr  = new SchematicManager(server);
+	this->noise_cache = new NoiseMapCache(NOISE_CACHE_MAX_BYTES, mb);
+	this->stage_profiler = new MapgenStageProfiler(mb);
 
 	// initialized later
 	this->mgparams = nullptr;
@@ -125,8 +131,18 @@ EmergeManager::EmergeManager(Server *server, MetricsBackend *mb)
 	m_qlimit_diskonly = rangelim(m_qlimit_diskonly, 1, 1000000);
 	m_qlimit_generate = rangelim(m_qlimit_generate, 1, 1000000);
 
-	for (s16 i = 0; i < nthreads; i++)
-		m_threads.push_back(new EmergeThread(server, i));
+	m_stolen_emerge_counter = mb->addCounter("minetest_emerge_stolen",
+		"Number of blocks taken from the queue of another emerge thread");
+
+	for (s16 i = 0; i < nthreads; i++) {
+		EmergeThread *thread = new EmergeThread(server, i);
+		thread->m_busy_time_counter = mb->addCounter(
+			"minetest_emerge_thread_busy_seconds",
+			"Time spent by an emerge thread handling blocks",
+			{{"thread", itos(i)}}
+		);
+		m_threads.push_back(thread);
+	}
 
 	infostream << "EmergeManager: using " << nthreads << " threads" << '\n';
 }
@@ -155,6 +171,8 @@ EmergeManager::~EmergeManager()
 	delete oremgr;
 	delete decomgr;
 	delete schemmgr;
+	delete noise_cache;
+	delete stage_profiler;
 }
 
 
@@ -207,6 +225,7 @@ void EmergeManager::initMapgens(MapgenParams *params)
 
 	v3s16 csize = v3s16(1, 1, 1) * (params->chunksize * MAP_BLOCKSIZE);
 	biomegen = biomemgr->createBiomeGen(BIOMEGEN_ORIGINAL, params->bparams, csize);
+	biomegen->setNoiseCache(noise_cache);
 
 	for (u32 i = 0; i != m_threads.size(); i++) {
 		EmergeParams *p = new EmergeParams(this, biomegen,
@@ -441,20 +460,48 @@ EmergeThread *EmergeManager::getOptimalThread()
 
 	FATAL_ERROR_IF(nthreads == 0, "No emerge threads!");
 
+	// Waiting threads come first, the others still have to finish their
+	// current block
 	size_t index = 0;
 	size_t nitems_lowest = m_threads[0]->m_block_queue.size();
+	bool idle_lowest = m_threads[0]->m_idle;
 
 	for (size_t i = 1; i < nthreads; i++) {
 		size_t nitems = m_threads[i]->m_block_queue.size();
-		if (nitems < nitems_lowest) {
+		bool idle = m_threads[i]->m_idle;
+		if (idle > idle_lowest || (idle == idle_lowest && nitems < nitems_lowest)) {
 			index = i;
 			nitems_lowest = nitems;
+			idle_lowest = idle;
 		}
 	}
 
 	return m_threads[index];
 }
 
+bool EmergeManager::stealBlock(EmergeThread *thief, v3s16 *pos)
+{
+	EmergeThread *victim = nullptr;
+	size_t nitems_highest = 0;
+
+	for (EmergeThread *thread : m_threads) {
+		size_t nitems = thread->m_block_queue.size();
+		if (thread != thief && nitems > nitems_highest) {
+			victim = thread;
+			nitems_highest = nitems;
+		}
+	}
+
+	if (!victim)
+		return false;
+
+	// The oldest block, like the victim would have done next
+	*pos = victim->m_block_queue.front();
+	victim->m_block_queue.pop();
+	m_stolen_emerge_counter->increment();
+	return true;
+}
+
 void EmergeManager::reportCompletedEmerge(EmergeAction action)
 {
 	assert((size_t)action < ARRLEN(m_completed_emerge_counter));
@@ -531,12 +578,18 @@ bool EmergeThread::popBlockEmerge(v3s16 *pos, BlockEmergeData *bedata)
 {
 	MutexAutoLock queuelock(m_emerge->m_queue_mutex);
 
-	if (m_block_queue.empty())
+	if (!m_block_queue.empty()) {
+		*pos = m_block_queue.front();
+		m_block_queue.pop();
+	} else if (m_emerge->stealBlock(this, pos)) {
+		// Help out a thread that is stuck in a slow block
+		g_profiler->add(m_name + ": stolen [#]", 1);
+	} else {
+		m_idle = true;
 		return false;
+	}
 
-	*pos = m_block_queue.front();
-	m_block_queue.pop();
-
+	m_idle = false;
 	m_emerge->popBlockEmergeData(*pos, bedata);
 
 	return true;
@@ -619,11 +672,15 @@ MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	/*
 		Run Lua on_generated callbacks in the server environment
 	*/
-	try {
-		m_server->getScriptIface()->environment_OnGenerated(
-			minp, maxp, m_mapgen->blockseed);
-	} catch (LuaError &e) {
-		m_server->setAsyncFatalError(e);
+	{
+		MapgenStageTimer stage_timer(m_emerge->getStageProfiler());
+		stage_timer.start(MGSTAGE_LUA_SERVER);
+		try {
+			m_server->getScriptIface()->environment_OnGenerated(
+				minp, maxp, m_mapgen->blockseed);
+		} catch (LuaError &e) {
+			m_server->setAsyncFatalError(e);
+		}
 	}
 
 	EMERGE_DBG_OUT("ended up with: " << analyze_block(block));
@@ -692,6 +749,20 @@ void *EmergeThread::run()
 		stop(); // do not enter main loop
 	}
 
+	// Adds the time taken by a block to the busy time
+	struct BusyTimeAccounter {
+		EmergeThread *thread;
+		u64 start_us = porting::getTimeUs();
+
+		BusyTimeAccounter(EmergeThread *thread) : thread(thread) {}
+		~BusyTimeAccounter()
+		{
+			u64 time_us = porting::getTimeUs() - start_us;
+			thread->m_busy_time_counter->increment(time_us / 1000000.0);
+			g_profiler->add(thread->m_name + ": busy [ms]", time_us / 1000.0f);
+		}
+	};
+
 	try {
 	while (!stopRequested()) {
 		BlockEmergeData bedata;
@@ -707,6 +778,7 @@ void *EmergeThread::run()
 		}
 
 		g_profiler->add(m_name + ": processed [#]", 1);
+		BusyTimeAccounter busy_time(this);
 
 		if (blockpos_over_max_limit(pos))
 			continue;
@@ -744,6 +816,8 @@ void *EmergeThread::run()
 			{
 				ScopeProfiler sp(g_profiler,
 					"EmergeThread: Lua on_generated", SPT_AVG);
+				MapgenStageTimer stage_timer(m_emerge->getStageProfiler());
+				stage_timer.start(MGSTAGE_LUA_MAPGEN);
 
 				try {
 					m_script->on_generated(&bmdata, m_mapgen->blockseed);
@@ -44,6 +44,8 @@ class BiomeManager;
 class OreManager;
 class DecorationManager;
 class SchematicManager;
+class NoiseMapCache;
+class MapgenStageProfiler;
 class Server;
 class ModApiMapgen;
 struct MapDatabaseAccessor;
@@ -116,6 +118,8 @@ class EmergeParams {
 	OreManager *oremgr;
 	DecorationManager *decomgr;
 	SchematicManager *schemmgr;
+	NoiseMapCache *noise_cache; // shared
+	MapgenStageProfiler *stage_profiler; // shared
 
 	inline GenerateNotifier createNotifier() const {
 		return GenerateNotifier(gen_notify_on, gen_notify_on_deco_ids,
@@ -161,6 +165,10 @@ class EmergeManager {
 	DISABLE_CLASS_COPY(EmergeManager);
 
 	const BiomeGen *getBiomeGen() const { return biomegen; }
+	// shared by all mapgens and the script API, thread-safe
+	NoiseMapCache *getNoiseCache() const { return noise_cache; }
+	// shared by all mapgens, thread-safe
+	MapgenStageProfiler *getStageProfiler() const { return stage_profiler; }
 
 	// no usage restrictions
 	const BiomeManager *getBiomeManager() const { return biomemgr; }
@@ -197,6 +205,7 @@ class EmergeManager {
 		void *callback_param);
 
 	size_t getQueueSize();
+	size_t getThreadCount() const { return m_threads.size(); }
 	bool isBlockInQueue(v3s16 pos);
 
 	Mapgen *getCurrentMapgen();
@@ -225,6 +234,7 @@ class EmergeManager {
 
 	// Emerge metrics
 	MetricCounterPtr m_completed_emerge_counter[5];
+	MetricCounterPtr m_stolen_emerge_counter;
 
 	// Managers of various map generation-related components
 	// Note that each Mapgen gets a copy(!) of these to work with
@@ -234,8 +244,14 @@ class EmergeManager {
 	DecorationManager *decomgr;
 	SchematicManager *schemmgr;
 
+	NoiseMapCache *noise_cache;
+	MapgenStageProfiler *stage_profiler;
+
 	// Requires m_queue_mutex held
 	EmergeThread *getOptimalThread();
+	// Requires m_queue_mutex held
+	// Takes the oldest block of the longest queue of another thread
+	bool stealBlock(EmergeThread *thief, v3s16 *pos);
 
 	bool pushBlockEmergeData(
 		v3s16 pos,
@@ -74,6 +74,11 @@ class EmergeThread : public Thread {
 
 	Event m_queue_event;
 	std::queue<v3s16> m_block_queue;
+	// Waiting for blocks, requires queue mutex held
+	bool m_idle = false;
+
+	// Time spent handling blocks
+	MetricCounterPtr m_busy_time_counter;
 
 	bool initScripting();
 
@@ -40,6 +40,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "porting.h"
 #include "network/socket.h"
 #include "mapblock.h"
+#include "server/world_pregen.h"
+#include "util/string.h"
 #if USE_CURSES
 	#include "terminal_chat_console.h"
 #endif
@@ -125,6 +127,8 @@ static bool determine_subgame(GameParams *game_params);
 static bool run_dedicated_server(const GameParams &game_params, const Settings &cmd_args);
 static bool migrate_map_database(const GameParams &game_params, const Settings &cmd_args);
 static bool recompress_map_database(const GameParams &game_params, const Settings &cmd_args);
+static bool parse_pregen_area(const std::string &str, v3s16 &minp, v3s16 &maxp);
+static bool train_map_dictionary(const GameParams &game_params, const Settings &cmd_args);
 
 /**********************************************************************/
 
@@ -376,6 +380,10 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Feature an interactive terminal (Only works when using minetestserver or with --server)"))));
 	allowed_options->insert(std::make_pair("recompress", ValueSpec(VALUETYPE_FLAG,
 			_("Recompress the blocks of the given map database."))));
+	allowed_options->insert(std::make_pair("train-map-dictionary", ValueSpec(VALUETYPE_FLAG,
+			_("Train a zstd dictionary from the blocks of the given map database."))));
+	allowed_options->insert(std::make_pair("pregen", ValueSpec(VALUETYPE_STRING,
+			_("Generate the area \"(x1,y1,z1) (x2,y2,z2)\" of the world, then shut down (Only works when using minetestserver or with --server)"))));
 #ifndef SERVER
 	allowed_options->insert(std::make_pair("address", ValueSpec(VALUETYPE_STRING,
 			_("Address to connect to. ('' = local game)"))));
@@ -1070,6 +1078,18 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	if (cmd_args.getFlag("recompress"))
 		return recompress_map_database(game_params, cmd_args);
 
+	if (cmd_args.getFlag("train-map-dictionary"))
+		return train_map_dictionary(game_params, cmd_args);
+
+	// World pregeneration
+	v3s16 pregen_minp, pregen_maxp;
+	const bool pregen = cmd_args.exists("pregen");
+	if (pregen && !parse_pregen_area(cmd_args.get("pregen"), pregen_minp, pregen_maxp)) {
+		errorstream << "Invalid --pregen area, expected \"(x1,y1,z1) (x2,y2,z2)\""
+			<< '\n';
+		return false;
+	}
+
 	// Bind address
 	std::string bind_str = g_settings->get("bind_address");
 	Address bind_addr(0, 0, 0, 0, game_params.socket_port);
@@ -1123,6 +1143,8 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 			g_term_console.start();
 
 			server.start();
+			if (pregen)
+				server.getWorldPregen()->start(pregen_minp, pregen_maxp, true);
 			// Run server
 			dedicated_server_loop(server, kill);
 		} catch (const ModError &e) {
@@ -1152,6 +1174,8 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 			Server server(game_params.world_path, game_params.game_spec, false,
 				bind_addr, true);
 			server.start();
+			if (pregen)
+				server.getWorldPregen()->start(pregen_minp, pregen_maxp, true);
 
 			// Run server
 			bool &kill = *porting::signal_handler_killstatus();
@@ -1237,6 +1261,20 @@ static bool migrate_map_database(const GameParams &game_params, const Settings &
 	return true;
 }
 
+static bool parse_pregen_area(const std::string &str, v3s16 &minp, v3s16 &maxp)
+{
+	// "(x1,y1,z1) (x2,y2,z2)"
+	size_t split = str.find(')');
+	if (split == std::string::npos || str.find('(') > split ||
+			str.find('(', split) == std::string::npos ||
+			str.find(')', split + 1) == std::string::npos)
+		return false;
+
+	minp = floatToInt(str_to_v3f(str.substr(0, split + 1)), 1.0f);
+	maxp = floatToInt(str_to_v3f(str.substr(split + 1)), 1.0f);
+	return true;
+}
+
 static bool recompress_map_database(const GameParams &game_params, const Settings &cmd_args)
 {
 	Settings world_mt;
@@ -1250,6 +1288,11 @@ static bool recompress_map_database(const GameParams &game_params, const Setting
 	Server server(game_params.world_path, game_params.game_spec, false, Address(), false);
 	MapDatabase *db = ServerMap::createDatabase(backend, game_params.world_path, world_mt);
 
+	// Existing blocks may need the dictionary to be read
+	auto dict = ServerMap::loadMapDictionary(game_params.world_path);
+	if (!g_settings->getBool("map_compression_dictionary"))
+		dict.reset();
+
 	u32 count = 0;
 	u64 last_update_time = 0;
 	bool &kill = *porting::signal_handler_killstatus();
@@ -1281,7 +1324,7 @@ static bool recompress_map_database(const GameParams &game_params, const Setting
 			oss.str("");
 			oss.clear();
 			writeU8(oss, serialize_as_ver);
-			mb.serialize(oss, serialize_as_ver, true, -1);
+			mb.serialize(oss, serialize_as_ver, true, -1, dict.get());
 		}
 
 		db->saveBlock(*it, oss.str());
@@ -1301,3 +1344,97 @@ static bool recompress_map_database(const GameParams &game_params, const Setting
 	actionstream << "Done, " << count << " blocks were recompressed." << '\n';
 	return true;
 }
+
+static bool train_map_dictionary(const GameParams &game_params, const Settings &cmd_args)
+{
+	Settings world_mt;
+	const std::string world_mt_path = game_params.world_path + DIR_DELIM + "world.apr";
+
+	if (!world_mt.readConfigFile(world_mt_path.c_str())) {
+		errorstream << "Cannot read world.apr at " << world_mt_path << '\n';
+		return false;
+	}
+	// Replacing the dictionary would make the blocks using it unreadable
+	const std::string path = ServerMap::getMapDictionaryPath(game_params.world_path);
+	if (fs::PathExists(path)) {
+		errorstream << path << " already exists. To retrain, recompress the map "
+			"with map_compression_dictionary = false and remove it first." << '\n';
+		return false;
+	}
+
+	const std::string &backend = world_mt.get("backend");
+	MapDatabase *db = ServerMap::createDatabase(backend, game_params.world_path, world_mt);
+
+	bool &kill = *porting::signal_handler_killstatus();
+	const int level = rangelim(g_settings->getS16("map_compression_level_disk"), -1, 9) + 1;
+
+	std::vector<v3s16> blocks;
+	db->listAllLoadableBlocks(blocks);
+
+	// More samples barely improve the dictionary but slow down training,
+	// so take them evenly spread over the map.
+	const size_t max_samples = 50000;
+	const size_t step = std::max<size_t>(blocks.size() / max_samples, 1);
+
+	std::vector<std::string> samples;
+	size_t compressed_size = 0;
+	std::ostringstream oss(std::ios_base::binary);
+	for (size_t i = 0; i < blocks.size(); i += step) {
+		if (kill) {
+			delete db;
+			return false;
+		}
+
+		std::string data;
+		db->loadBlock(blocks[i], &data);
+		// zstd is only used since version 29
+		if (data.size() < 2 || (u8)data[0] < 29)
+			continue;
+
+		std::istringstream iss(data, std::ios_base::binary);
+		iss.seekg(1);
+		oss.str("");
+		try {
+			decompressZstd(iss, oss);
+		} catch (SerializationError &e) {
+			errorstream << "Failed to decompress block " << blocks[i]
+				<< ": " << e.what() << '\n';
+			continue;
+		}
+		compressed_size += data.size() - 1;
+		samples.push_back(oss.str());
+	}
+	delete db;
+
+	actionstream << "Training map dictionary from " << samples.size()
+		<< " blocks" << '\n';
+
+	std::string dict_data;
+	try {
+		dict_data = trainZstdDictionary(samples, 112640);
+	} catch (SerializationError &e) {
+		errorstream << e.what() << '\n';
+		return false;
+	}
+
+	// Report the gain on the samples
+	ZstdDictionary dict(dict_data);
+	size_t dict_compressed_size = 0;
+	for (const auto &sample : samples) {
+		oss.str("");
+		compressZstd(sample, oss, level, &dict);
+		dict_compressed_size += oss.tellp();
+	}
+	actionstream << "Compressed size of the sampled blocks: " << compressed_size
+		<< " bytes without, " << dict_compressed_size << " bytes with the dictionary ("
+		<< (100.0f * dict_compressed_size / std::max<size_t>(compressed_size, 1)) << "%)" << '\n';
+
+	if (!fs::safeWriteToFile(path, dict_data)) {
+		errorstream << "Failed to write " << path << '\n';
+		return false;
+	}
+
+	actionstream << "Map dictionary " << dict.getId() << " written to " << path
+		<< ", use --recompress to apply it to the existing blocks." << '\n';
+	return true;
+}
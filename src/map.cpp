@@ -199,10 +199,14 @@ void Map::addNodeAndUpdate(v3s16 p, MapNode n,
 		n.setLight(LIGHTBANK_NIGHT, 0, f);
 		set_node_in_block(m_gamedef->ndef(), block, relpos, n);
 
-		// Update lighting
-		std::vector<std::pair<v3s16, MapNode> > oldnodes;
-		oldnodes.emplace_back(p, oldnode);
-		voxalgo::update_lighting_nodes(this, oldnodes, modified_blocks);
+		if (deferLightingUpdate(blockpos)) {
+			modified_blocks[blockpos] = block;
+		} else {
+			// Update lighting
+			std::vector<std::pair<v3s16, MapNode> > oldnodes;
+			oldnodes.emplace_back(p, oldnode);
+			voxalgo::update_lighting_nodes(this, oldnodes, modified_blocks);
+		}
 	}
 
 	if (n.getContent() != oldnode.getContent() &&
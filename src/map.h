@@ -306,6 +306,10 @@ class Map /*: public NodeContainer*/
 	// Can be implemented by child class
 	virtual void reportMetrics(u64 save_time_us, u32 saved_blocks, u32 all_blocks) {}
 
+	// Can be implemented by child class to postpone the light update of
+	// a node change in the given block. Return true if it was postponed.
+	virtual bool deferLightingUpdate(v3s16 blockpos) { return false; }
+
 	bool determineAdditionalOcclusionCheck(v3s16 pos_camera,
 		const core::aabbox3d<s16> &block_bounds, v3s16 &to_check);
 	bool isOccluded(v3s16 pos_camera, v3s16 pos_target,
@@ -37,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "porting.h"
 #include "util/string.h"
 #include "util/serialize.h"
+#include "util/stream.h"
 #include "util/basic_macros.h"
 
 static const char *modified_reason_strings[] = {
@@ -186,6 +187,7 @@ void MapBlock::copyFrom(VoxelManipulator &dst)
 	// Copy from VoxelManipulator to data
 	dst.copyTo(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
+	expireCollisionBoxes();
 }
 
 void MapBlock::actuallyUpdateIsAir()
@@ -215,44 +217,67 @@ void MapBlock::expireIsAirCache()
 	Serialization
 */
 
+// Dense content id lookup table, reused between blocks by the same thread.
+// Entries that are not in use are kept at 0xFFFF, so instead of clearing the
+// whole table only the entries touched by the previous block get reset.
+// The static memory requires about 65535 * 2 bytes RAM in order to be
+// sure we can handle all content ids. But it's absolutely worth it as it
+// replaces a lookup per node with a single array access.
+namespace {
+struct ContentIdLUT
+{
+	ContentIdLUT():
+		map(std::make_unique<content_t[]>(CONTENT_MAX + 1))
+	{
+		static_assert(sizeof(content_t) == 2, "content_t must be 16-bit");
+		memset(map.get(), 0xFF, (CONTENT_MAX + 1) * sizeof(content_t));
+	}
+
+	void reset()
+	{
+		for (content_t c : used)
+			map[c] = 0xFFFF;
+		used.clear();
+	}
+
+	std::unique_ptr<content_t[]> map;
+	std::vector<content_t> used;
+};
+}
+
+static ContentIdLUT &getContentIdLUT()
+{
+	thread_local ContentIdLUT lut;
+	lut.reset();
+	return lut;
+}
+
 // List relevant id-name pairs for ids in the block using nodedef
-// Renumbers the content IDs (starting at 0 and incrementing)
+// Renumbers the content IDs (starting at 0 and incrementing) and returns
+// the global -> block-local id table, the nodes themselves are not modified.
 // Note that there's no technical reason why we *have to* renumber the IDs,
 // but we do it anyway as it also helps compressability.
-static void getBlockNodeIdMapping(NameIdMapping *nimap, MapNode *nodes,
-	const NodeDefManager *nodedef)
+static const content_t *getBlockNodeIdMapping(NameIdMapping *nimap,
+	const MapNode *nodes, const NodeDefManager *nodedef)
 {
-	// The static memory requires about 65535 * 2 bytes RAM in order to be
-	// sure we can handle all content ids. But it's absolutely worth it as it's
-	// a speedup of 4 for one of the major time consuming functions on storing
-	// mapblocks.
-	thread_local std::unique_ptr<content_t[]> mapping;
-	static_assert(sizeof(content_t) == 2, "content_t must be 16-bit");
-	if (!mapping)
-		mapping = std::make_unique<content_t[]>(CONTENT_MAX + 1);
-
-	memset(mapping.get(), 0xFF, (CONTENT_MAX + 1) * sizeof(content_t));
+	ContentIdLUT &lut = getContentIdLUT();
+	content_t *mapping = lut.map.get();
 
 	content_t id_counter = 0;
 	for (u32 i = 0; i < MapBlock::nodecount; i++) {
 		content_t global_id = nodes[i].getContent();
-		content_t id = CONTENT_IGNORE;
-
-		// Try to find an existing mapping
-		if (mapping[global_id] != 0xFFFF) {
-			id = mapping[global_id];
-		} else {
-			// We have to assign a new mapping
-			id = id_counter++;
-			mapping[global_id] = id;
+		if (mapping[global_id] != 0xFFFF)
+			continue;
 
-			const auto &name = nodedef->get(global_id).name;
-			nimap->set(id, name);
-		}
+		// We have to assign a new mapping
+		mapping[global_id] = id_counter++;
+		lut.used.push_back(global_id);
 
-		// Update the MapNode
-		nodes[i].setContent(id);
+		const auto &name = nodedef->get(global_id).name;
+		nimap->set(mapping[global_id], name);
 	}
+
+	return mapping;
 }
 
 // Correct ids in the block to match nodedef based on names.
@@ -269,43 +294,35 @@ static void correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
 	std::unordered_set<content_t> unnamed_contents;
 	std::unordered_set<std::string> unallocatable_contents;
 
-	bool previous_exists = false;
-	content_t previous_local_id = CONTENT_IGNORE;
-	content_t previous_global_id = CONTENT_IGNORE;
+	// Every distinct local id is resolved once (in order of appearance) and
+	// the result is stored in a local -> global table. Ids that can't be
+	// resolved map to themselves, i.e. the node is left untouched.
+	ContentIdLUT &lut = getContentIdLUT();
+	content_t *mapping = lut.map.get();
 
+	std::string name;
 	for (u32 i = 0; i < MapBlock::nodecount; i++) {
 		content_t local_id = nodes[i].getContent();
-		// If previous node local_id was found and same than before, don't lookup maps
-		// apply directly previous resolved id
-		// This permits to massively improve loading performance when nodes are similar
-		// example: default:air, default:stone are massively present
-		if (previous_exists && local_id == previous_local_id) {
-			nodes[i].setContent(previous_global_id);
+		content_t global_id = mapping[local_id];
+		if (global_id != 0xFFFF) {
+			nodes[i].setContent(global_id);
 			continue;
 		}
 
-		std::string name;
+		global_id = local_id;
 		if (!nimap->getName(local_id, name)) {
 			unnamed_contents.insert(local_id);
-			previous_exists = false;
-			continue;
-		}
-
-		content_t global_id;
-		if (!nodedef->getId(name, global_id)) {
+		} else if (!nodedef->getId(name, global_id)) {
 			global_id = gamedef->allocateUnknownNodeId(name);
 			if (global_id == CONTENT_IGNORE) {
 				unallocatable_contents.insert(name);
-				previous_exists = false;
-				continue;
+				global_id = local_id;
 			}
 		}
-		nodes[i].setContent(global_id);
+		mapping[local_id] = global_id;
+		lut.used.push_back(local_id);
 
-		// Save previous node local_id & global_id result
-		previous_local_id = local_id;
-		previous_global_id = global_id;
-		previous_exists = true;
+		nodes[i].setContent(global_id);
 	}
 
 	for (const content_t c: unnamed_contents) {
@@ -320,14 +337,19 @@ static void correctBlockNodeIds(const NameIdMapping *nimap, MapNode *nodes,
 	}
 }
 
-void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int compression_level)
+void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int compression_level,
+		const ZstdDictionary *dict)
 {
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapBlock format not supported");
 
 	FATAL_ERROR_IF(version < SER_FMT_VER_LOWEST_WRITE, "Serialization version error");
 
-	std::ostringstream os_raw(std::ios_base::binary);
+	// The uncompressed data is collected in a buffer that is kept around
+	thread_local std::string raw_buf;
+	raw_buf.clear();
+	StringAppendStreamBuffer raw_sb(raw_buf);
+	std::ostream os_raw(&raw_sb);
 	std::ostream &os = version >= 29 ? os_raw : os_compressed;
 
 	// First byte
@@ -357,13 +379,11 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 	const u8 params_width = 2;
  	if(disk)
 	{
-		MapNode *tmp_nodes = new MapNode[nodecount];
-		memcpy(tmp_nodes, data, nodecount * sizeof(MapNode));
-		getBlockNodeIdMapping(&nimap, tmp_nodes, m_gamedef->ndef());
+		const content_t *id_map =
+				getBlockNodeIdMapping(&nimap, data, m_gamedef->ndef());
 
-		buf = MapNode::serializeBulk(version, tmp_nodes, nodecount,
-				content_width, params_width);
-		delete[] tmp_nodes;
+		buf = MapNode::serializeBulk(version, data, nodecount,
+				content_width, params_width, id_map);
 
 		// write timestamp and node/id mapping first
 		if (version >= 29) {
@@ -396,7 +416,7 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 		// use os_raw from above to avoid allocating another stream object
 		m_node_metadata.serialize(os_raw, version, disk);
 		// prior to 29 node data was compressed individually
-		compress(os_raw.str(), os, version, compression_level);
+		compress(raw_buf, os, version, compression_level);
 	}
 
 	/*
@@ -427,7 +447,10 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 
 	if (version >= 29) {
 		// now compress the whole thing
-		compress(os_raw.str(), os_compressed, version, compression_level);
+		thread_local std::string compressed;
+		compressed.clear();
+		compress(raw_buf, compressed, version, compression_level, dict);
+		os_compressed.write(compressed.data(), compressed.size());
 	}
 }
 
@@ -436,6 +459,36 @@ void MapBlock::serializeNetworkSpecific(std::ostream &os)
 	writeU8(os, 2); // version
 }
 
+// Decompresses a whole block (version >= 29) into out, leaving `is` right
+// after the compressed data.
+static void decompressBlock(std::istream &is, std::string &out, u8 version)
+{
+	out.clear();
+
+	std::streampos start = is.tellg();
+	if (start == std::streampos(-1)) {
+		// Not seekable, so the stream must be consumed bit by bit
+		StringAppendStreamBuffer out_sb(out);
+		std::ostream os(&out_sb);
+		decompress(is, os, version);
+		return;
+	}
+
+	// Working on memory avoids the 16 KiB chunking of the stream variant
+	thread_local std::string in_buf;
+	is.seekg(0, std::ios_base::end);
+	std::streamoff size = is.tellg() - start;
+	is.seekg(start);
+	in_buf.resize(size);
+	is.read(&in_buf[0], size);
+	in_buf.resize(is.gcount());
+
+	size_t used = decompress(in_buf, out, version);
+
+	is.clear();
+	is.seekg(start + std::streamoff(used));
+}
+
 void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 {
 	if(!ser_ver_supported(version))
@@ -444,6 +497,7 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()<< '\n');
 
 	m_is_air_expired = true;
+	expireCollisionBoxes();
 
 	if(version <= 21)
 	{
@@ -452,10 +506,13 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 	}
 
 	// Decompress the whole block (version >= 29)
-	std::stringstream in_raw(std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+	thread_local std::string raw_buf;
 	if (version >= 29)
-		decompress(in_compressed, in_raw, version);
-	std::istream &is = version >= 29 ? in_raw : in_compressed;
+		decompressBlock(in_compressed, raw_buf, version);
+	StringViewStreamBuffer raw_sb(raw_buf);
+	std::istream in_view(&raw_sb);
+	std::istream &is = version >= 29 ? in_view : in_compressed;
+	std::stringstream in_raw(std::ios_base::binary | std::ios_base::in | std::ios_base::out);
 
 	u8 flags = readU8(is);
 	is_underground = (flags & 0x01) != 0;
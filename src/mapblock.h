@@ -19,8 +19,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <memory>
 #include <vector>
 #include "irr_v3d.h"
+#include "collision.h"
 #include "mapnode.h"
 #include "exceptions.h"
 #include "constants.h"
@@ -36,6 +38,7 @@ class NodeMetadataList;
 class IGameDef;
 class MapBlockMesh;
 class VoxelManipulator;
+class ZstdDictionary;
 
 #define BLOCK_TIMESTAMP_UNDEFINED 0xffffffff
 
@@ -92,6 +95,7 @@ class MapBlock
 	{
 		for (u32 i = 0; i < nodecount; i++)
 			data[i] = MapNode(CONTENT_IGNORE);
+		expireCollisionBoxes();
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
 	}
 
@@ -271,6 +275,7 @@ class MapBlock
 			throw InvalidPositionException();
 
 		data[z * zstride + y * ystride + x] = n;
+		expireCollisionBoxes();
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
 
@@ -296,6 +301,7 @@ class MapBlock
 	inline void setNodeNoCheck(s16 x, s16 y, s16 z, MapNode n)
 	{
 		data[z * zstride + y * ystride + x] = n;
+		expireCollisionBoxes();
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
 
@@ -325,6 +331,21 @@ class MapBlock
 		return m_is_air;
 	}
 
+	// Collision boxes of the nodes, see collision.cpp
+	MapBlockCollisionBoxes &getCollisionBoxes()
+	{
+		if (!m_collision_boxes)
+			m_collision_boxes = std::make_unique<MapBlockCollisionBoxes>();
+		return *m_collision_boxes;
+	}
+
+	// Call this when nodes change
+	inline void expireCollisionBoxes()
+	{
+		if (m_collision_boxes)
+			m_collision_boxes.reset();
+	}
+
 	bool onObjectsActivation();
 	bool saveStaticObject(u16 id, const StaticObject &obj, u32 reason);
 
@@ -428,7 +449,9 @@ class MapBlock
 	// These don't write or read version by itself
 	// Set disk to true for on-disk format, false for over-the-network format
 	// Precondition: version >= SER_FMT_VER_LOWEST_WRITE
-	void serialize(std::ostream &result, u8 version, bool disk, int compression_level);
+	// dict: optional zstd dictionary to compress with (version >= 29)
+	void serialize(std::ostream &result, u8 version, bool disk, int compression_level,
+			const ZstdDictionary *dict = nullptr);
 	// If disk == true: In addition to doing other things, will add
 	// unknown blocks from id-name mapping to wndef
 	void deSerialize(std::istream &is, u8 version, bool disk);
@@ -519,6 +542,8 @@ class MapBlock
 	bool m_is_air = false;
 	bool m_is_air_expired = true;
 
+	std::unique_ptr<MapBlockCollisionBoxes> m_collision_boxes;
+
 	/*
 		- On the server, this is used for telling whether the
 		  block has been modified from the one on disk.
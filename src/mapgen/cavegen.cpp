@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "util/numeric.h"
 #include <cmath>
+#include <vector>
 #include "map.h"
 #include "mapgen.h"
 #include "mapgen_v5.h"
@@ -70,20 +71,68 @@ CavesNoiseIntersection::~CavesNoiseIntersection()
 }
 
 
+// Same as contour() from noise.cpp, inlined so the intersection loop
+// below can be vectorized
+static inline float contour_inline(float v)
+{
+	v = std::fabs(v);
+	if (v >= 1.0f)
+		return 0.0f;
+	return 1.0f - v;
+}
+
+
 void CavesNoiseIntersection::generateCaves(MMVManip *vm,
 	v3s16 nmin, v3s16 nmax, biome_t *biomemap)
 {
 	assert(vm);
 	assert(biomemap);
 
+	const v3s16 &em = vm->m_area.getExtent();
+
+	// Only ground content is excavated and everything else done in a column
+	// follows an excavation above, so columns without any ground content
+	// are left as they are. Mapchunks above the terrain have no such column
+	// and don't need the noise at all.
+	std::vector<bool> column_has_ground(m_csize.X * m_csize.Z, false);
+	bool has_ground = false;
+	u32 index2d = 0;  // Biomemap index
+
+	for (s16 z = nmin.Z; z <= nmax.Z; z++)
+	for (s16 x = nmin.X; x <= nmax.X; x++, index2d++) {
+		u32 vi = vm->m_area.index(x, nmin.Y - 1, z);
+		for (s16 y = nmin.Y - 1; y <= nmax.Y; y++, VoxelArea::add_y(em, vi, 1)) {
+			content_t c = vm->m_data[vi].getContent();
+			if (c != CONTENT_AIR && m_ndef->get(c).is_ground_content) {
+				column_has_ground[index2d] = true;
+				has_ground = true;
+				break;
+			}
+		}
+	}
+
+	if (!has_ground)
+		return;
+
 	noise_cave1->perlinMap3D(nmin.X, nmin.Y - 1, nmin.Z);
 	noise_cave2->perlinMap3D(nmin.X, nmin.Y - 1, nmin.Z);
 
-	const v3s16 &em = vm->m_area.getExtent();
-	u32 index2d = 0;  // Biomemap index
+	// Tunnels are where the intersection is above the cave width
+	const u32 volume = m_zstride_1d * m_csize.Z;
+	const float *result1 = noise_cave1->result;
+	const float *result2 = noise_cave2->result;
+	std::vector<u8> in_tunnel(volume);
+	for (u32 i = 0; i < volume; i++)
+		in_tunnel[i] = contour_inline(result1[i]) * contour_inline(result2[i]) >
+			m_cave_width;
+
+	index2d = 0;
 
 	for (s16 z = nmin.Z; z <= nmax.Z; z++)
 	for (s16 x = nmin.X; x <= nmax.X; x++, index2d++) {
+		if (!column_has_ground[index2d])
+			continue;
+
 		bool column_is_open = false;  // Is column open to overground
 		bool is_under_river = false;  // Is column under river water
 		bool is_under_tunnel = false;  // Is tunnel or is under tunnel
@@ -136,10 +185,7 @@ void CavesNoiseIntersection::generateCaves(MMVManip *vm,
 			}
 
 			// Ground
-			float d1 = contour(noise_cave1->result[index3d]);
-			float d2 = contour(noise_cave2->result[index3d]);
-
-			if (d1 * d2 > m_cave_width && m_ndef->get(c).is_ground_content) {
+			if (in_tunnel[index3d] && m_ndef->get(c).is_ground_content) {
 				// In tunnel and ground content, excavate
 				vm->m_data[vi] = MapNode(CONTENT_AIR);
 				is_under_tunnel = true;
@@ -236,51 +282,42 @@ bool CavernsNoise::generateCaverns(MMVManip *vm, v3s16 nmin, v3s16 nmax)
 	noise_cavern->perlinMap3D(nmin.X, nmin.Y - 1, nmin.Z);
 
 	// Cache cavern_amp values
-	float *cavern_amp = new float[m_csize.Y + 1];
-	u8 cavern_amp_index = 0;  // Index zero at column top
-	for (s16 y = nmax.Y; y >= nmin.Y - 1; y--, cavern_amp_index++) {
-		cavern_amp[cavern_amp_index] =
+	std::vector<float> cavern_amp(m_csize.Y + 1);  // Index zero at nmin.Y - 1
+	for (s16 y = nmin.Y - 1; y <= nmax.Y; y++) {
+		cavern_amp[y - nmin.Y + 1] =
 			MYMIN((m_cavern_limit - y) / (float)m_cavern_taper, 1.0f);
 	}
 
 	//// Place nodes
+	// Every node is independent of the others here, so both the noise and
+	// the voxelmanip are walked along X rows in memory order.
 	bool near_cavern = false;
-	const v3s16 &em = vm->m_area.getExtent();
-	u32 index2d = 0;
+	const float near_threshold = m_cavern_threshold - 0.1f;
 
+	// Don't excavate the overgenerated stone at node_max.Y + 1,
+	// this creates a 'roof' over the cavern, preventing light in
+	// caverns at mapchunk borders when generating mapchunks upwards.
+	// This 'roof' is excavated when the mapchunk above is generated.
 	for (s16 z = nmin.Z; z <= nmax.Z; z++)
-	for (s16 x = nmin.X; x <= nmax.X; x++, index2d++) {
-		// Reset cave_amp index to column top
-		cavern_amp_index = 0;
-		// Initial voxelmanip index at column top
-		u32 vi = vm->m_area.index(x, nmax.Y, z);
-		// Initial 3D noise index at column top
-		u32 index3d = (z - nmin.Z) * m_zstride_1d + m_csize.Y * m_ystride +
-			(x - nmin.X);
-		// Don't excavate the overgenerated stone at node_max.Y + 1,
-		// this creates a 'roof' over the cavern, preventing light in
-		// caverns at mapchunk borders when generating mapchunks upwards.
-		// This 'roof' is excavated when the mapchunk above is generated.
-		for (s16 y = nmax.Y; y >= nmin.Y - 1; y--,
-				index3d -= m_ystride,
-				VoxelArea::add_y(em, vi, -1),
-				cavern_amp_index++) {
-			content_t c = vm->m_data[vi].getContent();
-			float n_absamp_cavern = std::fabs(noise_cavern->result[index3d]) *
-				cavern_amp[cavern_amp_index];
+	for (s16 y = nmin.Y - 1; y <= nmax.Y; y++) {
+		const float amp = cavern_amp[y - nmin.Y + 1];
+		// Initial voxelmanip and 3D noise indexes at row start
+		u32 vi = vm->m_area.index(nmin.X, y, z);
+		const float *row = &noise_cavern->result[(z - nmin.Z) * m_zstride_1d +
+			(y - nmin.Y + 1) * m_ystride];
+		for (s16 x = 0; x < m_csize.X; x++, vi++) {
+			float n_absamp_cavern = std::fabs(row[x]) * amp;
 			// Disable CavesRandomWalk at a safe distance from caverns
 			// to avoid excessively spreading liquids in caverns.
-			if (n_absamp_cavern > m_cavern_threshold - 0.1f) {
+			if (n_absamp_cavern > near_threshold) {
 				near_cavern = true;
 				if (n_absamp_cavern > m_cavern_threshold &&
-						m_ndef->get(c).is_ground_content)
+						m_ndef->get(vm->m_data[vi]).is_ground_content)
 					vm->m_data[vi] = MapNode(CONTENT_AIR);
 			}
 		}
 	}
 
-	delete[] cavern_amp;
-
 	return near_cavern;
 }
 
@@ -563,42 +600,62 @@ void CavesRandomWalk::carveRoute(v3f vec, float f, bool randomize_xz)
 
 	bool flat_cave_floor = !large_cave && ps->range(0, 2) == 2;
 
+	// Vertical range of every column, independent of its size
+	s16 y0_min = -MAX_MAP_GENERATION_LIMIT;
+	s16 y0_max = MAX_MAP_GENERATION_LIMIT;
+	// Make better floors in small caves
+	if (flat_cave_floor && rs <= 7)
+		y0_min = -rs / 2 + 1;
+	// Make large caves not so tall
+	if (large_cave_is_flat && rs > 7) {
+		y0_min = -rs / 3 + 1;
+		y0_max = rs / 3 - 1;
+	}
+
+	const VoxelArea &area = vm->m_area;
+	const v3s16 &em = area.getExtent();
+	// Column positions are relative to this
+	const v3s16 cpo = cp + of;
+	y0_min = MYMAX(y0_min, area.MinEdge.Y - cpo.Y);
+	y0_max = MYMIN(y0_max, area.MaxEdge.Y - cpo.Y);
+
+	const int full_ymin = node_min.Y - MAP_BLOCKSIZE;
+	const int full_ymax = node_max.Y + MAP_BLOCKSIZE;
+	const bool flooded_at_water_level = flooded &&
+		full_ymin < water_level && full_ymax > water_level;
+	const bool flooded_below_water_level = flooded && full_ymax < water_level;
+
 	for (s16 z0 = d0; z0 <= d1; z0++) {
 		s16 si = rs / 2 - MYMAX(0, abs(z0) - rs / 7 - 1);
 		for (s16 x0 = -si - ps->range(0,1); x0 <= si - 1 + ps->range(0,1); x0++) {
+			// The condition above consumes randomness, so this can't skip
+			// the whole row when it is outside of the voxelmanip
+			v3s16 p(cpo.X + x0, 0, cpo.Z + z0);
+			if (p.X < area.MinEdge.X || p.X > area.MaxEdge.X ||
+					p.Z < area.MinEdge.Z || p.Z > area.MaxEdge.Z)
+				continue;
+
 			s16 maxabsxz = MYMAX(abs(x0), abs(z0));
 
 			s16 si2 = rs / 2 - MYMAX(0, maxabsxz - rs / 7 - 1);
 
-			for (s16 y0 = -si2; y0 <= si2; y0++) {
-				// Make better floors in small caves
-				if (flat_cave_floor && y0 <= -rs / 2 && rs <= 7)
-					continue;
-
-				if (large_cave_is_flat) {
-					// Make large caves not so tall
-					if (rs > 7 && abs(y0) >= rs / 3)
-						continue;
-				}
-
-				v3s16 p(cp.X + x0, cp.Y + y0, cp.Z + z0);
-				p += of;
-
-				if (!vm->m_area.contains(p))
-					continue;
+			s16 y0_start = MYMAX(-si2, y0_min);
+			s16 y0_end = MYMIN(si2, y0_max);
+			if (y0_start > y0_end)
+				continue;
 
-				u32 i = vm->m_area.index(p);
+			p.Y = cpo.Y + y0_start;
+			u32 i = area.index(p);
+			for (s16 y0 = y0_start; y0 <= y0_end; y0++, p.Y++,
+					VoxelArea::add_y(em, i, 1)) {
 				content_t c = vm->m_data[i].getContent();
 				if (!ndef->get(c).is_ground_content)
 					continue;
 
 				if (large_cave) {
-					int full_ymin = node_min.Y - MAP_BLOCKSIZE;
-					int full_ymax = node_max.Y + MAP_BLOCKSIZE;
-
-					if (flooded && full_ymin < water_level && full_ymax > water_level)
+					if (flooded_at_water_level)
 						vm->m_data[i] = (p.Y <= water_level) ? waternode : airnode;
-					else if (flooded && full_ymax < water_level)
+					else if (flooded_below_water_level)
 						vm->m_data[i] = (p.Y < startp.Y - 4) ? liquidnode : airnode;
 					else
 						vm->m_data[i] = airnode;
@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "noise.h"
 #include "gamedef.h"
 #include "mg_biome.h"
+#include "mg_noise_cache.h"
 #include "mapblock.h"
 #include "mapnode.h"
 #include "map.h"
@@ -310,6 +311,14 @@ void Mapgen::updateHeightmap(v3s16 nmin, v3s16 nmax)
 
 void Mapgen::getSurfaces(v2s16 p2d, s16 ymin, s16 ymax,
 	std::vector<s16> &floors, std::vector<s16> &ceilings)
+{
+	getSurfaces(vm, ndef, p2d, ymin, ymax, floors, ceilings);
+}
+
+
+void Mapgen::getSurfaces(MMVManip *vm, const NodeDefManager *ndef,
+	v2s16 p2d, s16 ymin, s16 ymax,
+	std::vector<s16> &floors, std::vector<s16> &ceilings)
 {
 	const v3s16 &em = vm->m_area.getExtent();
 
@@ -647,7 +656,7 @@ void MapgenBasic::generateBiomes()
 	const v3s16 &em = vm->m_area.getExtent();
 	u32 index = 0;
 
-	noise_filler_depth->perlinMap2D(node_min.X, node_min.Z);
+	m_emerge->noise_cache->perlinMap2D(noise_filler_depth, node_min.X, node_min.Z);
 
 	for (s16 z = node_min.Z; z <= node_max.Z; z++)
 	for (s16 x = node_min.X; x <= node_max.X; x++, index++) {
@@ -204,6 +204,9 @@ class Mapgen {
 	void updateHeightmap(v3s16 nmin, v3s16 nmax);
 	void getSurfaces(v2s16 p2d, s16 ymin, s16 ymax,
 		std::vector<s16> &floors, std::vector<s16> &ceilings);
+	static void getSurfaces(MMVManip *vm, const NodeDefManager *ndef,
+		v2s16 p2d, s16 ymin, s16 ymax,
+		std::vector<s16> &floors, std::vector<s16> &ceilings);
 
 	void updateLiquid(UniqueQueue<v3s16> *trans_liquid, v3s16 nmin, v3s16 nmax);
 
@@ -36,6 +36,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mg_biome.h"
 #include "mg_ore.h"
 #include "mg_decoration.h"
+#include "mg_noise_cache.h"
+#include "mg_stage_profiler.h"
 #include "mapgen_carpathian.h"
 
 
@@ -275,18 +277,23 @@ void MapgenCarpathian::makeChunk(BlockMakeData *data)
 	// Create a block-specific seed
 	blockseed = getBlockSeed2(full_node_min, seed);
 
+	MapgenStageTimer stage_timer(m_emerge->stage_profiler);
+
+	stage_timer.start(MGSTAGE_TERRAIN);
 	// Generate terrain
 	s16 stone_surface_max_y = generateTerrain();
 
 	// Create heightmap
 	updateHeightmap(node_min, node_max);
 
+	stage_timer.start(MGSTAGE_BIOMES);
 	// Init biome generator, place biome-specific nodes, and build biomemap
 	if (flags & MG_BIOMES) {
 		biomegen->calcBiomeNoise(node_min);
 		generateBiomes();
 	}
 
+	stage_timer.start(MGSTAGE_CAVES);
 	// Generate tunnels, caverns and large randomwalk caves
 	if (flags & MG_CAVES) {
 		// Generate tunnels first as caverns confuse them
@@ -308,25 +315,31 @@ void MapgenCarpathian::makeChunk(BlockMakeData *data)
 			generateCavesRandomWalk(stone_surface_max_y, large_cave_depth);
 	}
 
+	stage_timer.start(MGSTAGE_ORES);
 	// Generate the registered ores
 	if (flags & MG_ORES)
 		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_DUNGEONS);
 	// Generate dungeons
 	if (flags & MG_DUNGEONS)
 		generateDungeons(stone_surface_max_y);
 
+	stage_timer.start(MGSTAGE_DECORATIONS);
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
 		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_BIOMES);
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
 		dustTopNodes();
 
+	stage_timer.start(MGSTAGE_LIQUID);
 	// Update liquids
 	updateLiquid(&data->transforming_liquid, full_node_min, full_node_max);
 
+	stage_timer.start(MGSTAGE_LIGHTING);
 	// Calculate lighting
 	if (flags & MG_LIGHT) {
 		calcLighting(node_min - v3s16(0, 1, 0), node_max + v3s16(0, 1, 0),
@@ -444,20 +457,21 @@ int MapgenCarpathian::generateTerrain()
 	MapNode mn_water(c_water_source);
 
 	// Calculate noise for terrain generation
-	noise_height1->perlinMap2D(node_min.X, node_min.Z);
-	noise_height2->perlinMap2D(node_min.X, node_min.Z);
-	noise_height3->perlinMap2D(node_min.X, node_min.Z);
-	noise_height4->perlinMap2D(node_min.X, node_min.Z);
-	noise_hills_terrain->perlinMap2D(node_min.X, node_min.Z);
-	noise_ridge_terrain->perlinMap2D(node_min.X, node_min.Z);
-	noise_step_terrain->perlinMap2D(node_min.X, node_min.Z);
-	noise_hills->perlinMap2D(node_min.X, node_min.Z);
-	noise_ridge_mnt->perlinMap2D(node_min.X, node_min.Z);
-	noise_step_mnt->perlinMap2D(node_min.X, node_min.Z);
+	NoiseMapCache *noise_cache = m_emerge->noise_cache;
+	noise_cache->perlinMap2D(noise_height1, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_height2, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_height3, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_height4, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_hills_terrain, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_ridge_terrain, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_step_terrain, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_hills, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_ridge_mnt, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_step_mnt, node_min.X, node_min.Z);
 	noise_mnt_var->perlinMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 
 	if (spflags & MGCARPATHIAN_RIVERS)
-		noise_rivers->perlinMap2D(node_min.X, node_min.Z);
+		noise_cache->perlinMap2D(noise_rivers, node_min.X, node_min.Z);
 
 	//// Place nodes
 	const v3s16 &em = vm->m_area.getExtent();
@@ -36,6 +36,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mg_biome.h"
 #include "mg_ore.h"
 #include "mg_decoration.h"
+#include "mg_noise_cache.h"
+#include "mg_stage_profiler.h"
 #include "mapgen_fractal.h"
 
 
@@ -226,44 +228,55 @@ void MapgenFractal::makeChunk(BlockMakeData *data)
 
 	blockseed = getBlockSeed2(full_node_min, seed);
 
+	MapgenStageTimer stage_timer(m_emerge->stage_profiler);
+
+	stage_timer.start(MGSTAGE_TERRAIN);
 	// Generate fractal and optional terrain
 	s16 stone_surface_max_y = generateTerrain();
 
 	// Create heightmap
 	updateHeightmap(node_min, node_max);
 
+	stage_timer.start(MGSTAGE_BIOMES);
 	// Init biome generator, place biome-specific nodes, and build biomemap
 	if (flags & MG_BIOMES) {
 		biomegen->calcBiomeNoise(node_min);
 		generateBiomes();
 	}
 
+	stage_timer.start(MGSTAGE_CAVES);
 	// Generate tunnels and randomwalk caves
 	if (flags & MG_CAVES) {
 		generateCavesNoiseIntersection(stone_surface_max_y);
 		generateCavesRandomWalk(stone_surface_max_y, large_cave_depth);
 	}
 
+	stage_timer.start(MGSTAGE_ORES);
 	// Generate the registered ores
 	if (flags & MG_ORES)
 		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_DUNGEONS);
 	// Generate dungeons
 	if (flags & MG_DUNGEONS)
 		generateDungeons(stone_surface_max_y);
 
+	stage_timer.start(MGSTAGE_DECORATIONS);
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
 		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_BIOMES);
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
 		dustTopNodes();
 
+	stage_timer.start(MGSTAGE_LIQUID);
 	// Update liquids
 	if (spflags & MGFRACTAL_TERRAIN)
 		updateLiquid(&data->transforming_liquid, full_node_min, full_node_max);
 
+	stage_timer.start(MGSTAGE_LIGHTING);
 	// Calculate lighting
 	if (flags & MG_LIGHT)
 		calcLighting(node_min - v3s16(0, 1, 0), node_max + v3s16(0, 1, 0),
@@ -415,7 +428,7 @@ s16 MapgenFractal::generateTerrain()
 	u32 index2d = 0;
 
 	if (noise_seabed)
-		noise_seabed->perlinMap2D(node_min.X, node_min.Z);
+		m_emerge->noise_cache->perlinMap2D(noise_seabed, node_min.X, node_min.Z);
 
 	for (s16 z = node_min.Z; z <= node_max.Z; z++) {
 		for (s16 y = node_min.Y - 1; y <= node_max.Y + 1; y++) {
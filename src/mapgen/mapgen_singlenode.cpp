@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "nodedef.h"
 #include "voxelalgorithms.h"
 #include "emerge.h"
+#include "mg_stage_profiler.h"
 
 
 MapgenSinglenode::MapgenSinglenode(MapgenParams *params, EmergeParams *emerge)
@@ -62,6 +63,9 @@ void MapgenSinglenode::makeChunk(BlockMakeData *data)
 
 	blockseed = getBlockSeed2(node_min, data->seed);
 
+	MapgenStageTimer stage_timer(m_emerge->stage_profiler);
+
+	stage_timer.start(MGSTAGE_TERRAIN);
 	MapNode n_node(c_node);
 
 	for (s16 z = node_min.Z; z <= node_max.Z; z++)
@@ -74,9 +78,11 @@ void MapgenSinglenode::makeChunk(BlockMakeData *data)
 		}
 	}
 
+	stage_timer.start(MGSTAGE_LIQUID);
 	if (ndef->get(n_node).isLiquid())
 		updateLiquid(&data->transforming_liquid, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_LIGHTING);
 	// Set lighting
 	if ((flags & MG_LIGHT) && set_light == LIGHT_SUN)
 		setLighting(LIGHT_SUN, node_min, node_max);
@@ -35,6 +35,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mg_biome.h"
 #include "mg_ore.h"
 #include "mg_decoration.h"
+#include "mg_noise_cache.h"
+#include "mg_stage_profiler.h"
 #include "mapgen_v5.h"
 
 
@@ -217,18 +219,23 @@ void MapgenV5::makeChunk(BlockMakeData *data)
 	// Create a block-specific seed
 	blockseed = getBlockSeed2(full_node_min, seed);
 
+	MapgenStageTimer stage_timer(m_emerge->stage_profiler);
+
+	stage_timer.start(MGSTAGE_TERRAIN);
 	// Generate base terrain
 	s16 stone_surface_max_y = generateBaseTerrain();
 
 	// Create heightmap
 	updateHeightmap(node_min, node_max);
 
+	stage_timer.start(MGSTAGE_BIOMES);
 	// Init biome generator, place biome-specific nodes, and build biomemap
 	if (flags & MG_BIOMES) {
 		biomegen->calcBiomeNoise(node_min);
 		generateBiomes();
 	}
 
+	stage_timer.start(MGSTAGE_CAVES);
 	// Generate tunnels, caverns and large randomwalk caves
 	if (flags & MG_CAVES) {
 		// Generate tunnels first as caverns confuse them
@@ -250,27 +257,33 @@ void MapgenV5::makeChunk(BlockMakeData *data)
 			generateCavesRandomWalk(stone_surface_max_y, large_cave_depth);
 	}
 
+	stage_timer.start(MGSTAGE_ORES);
 	// Generate the registered ores
 	if (flags & MG_ORES)
 		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_DUNGEONS);
 	// Generate dungeons and desert temples
 	if (flags & MG_DUNGEONS)
 		generateDungeons(stone_surface_max_y);
 
+	stage_timer.start(MGSTAGE_DECORATIONS);
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
 		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_BIOMES);
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
 		dustTopNodes();
 
 	//printf("makeChunk: %dms\n", t.stop());
 
+	stage_timer.start(MGSTAGE_LIQUID);
 	// Add top and bottom side of water to transforming_liquid queue
 	updateLiquid(&data->transforming_liquid, full_node_min, full_node_max);
 
+	stage_timer.start(MGSTAGE_LIGHTING);
 	// Calculate lighting
 	if (flags & MG_LIGHT) {
 		calcLighting(node_min - v3s16(0, 1, 0), node_max + v3s16(0, 1, 0),
@@ -287,8 +300,9 @@ int MapgenV5::generateBaseTerrain()
 	u32 index2d = 0;
 	int stone_surface_max_y = -MAX_MAP_GENERATION_LIMIT;
 
-	noise_factor->perlinMap2D(node_min.X, node_min.Z);
-	noise_height->perlinMap2D(node_min.X, node_min.Z);
+	NoiseMapCache *noise_cache = m_emerge->noise_cache;
+	noise_cache->perlinMap2D(noise_factor, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_height, node_min.X, node_min.Z);
 	noise_ground->perlinMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 
 	for (s16 z=node_min.Z; z<=node_max.Z; z++) {
@@ -37,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "treegen.h"
 #include "mg_ore.h"
 #include "mg_decoration.h"
+#include "mg_stage_profiler.h"
 #include "mapgen_v6.h"
 
 
@@ -521,6 +522,9 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	// Create a block-specific seed
 	blockseed = get_blockseed(data->seed, full_node_min);
 
+	MapgenStageTimer stage_timer(m_emerge->stage_profiler);
+
+	stage_timer.start(MGSTAGE_NOISE);
 	// Make some noise
 	calculateNoise();
 
@@ -528,6 +532,7 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	// This is used to guide the cave generation
 	s16 stone_surface_max_y;
 
+	stage_timer.start(MGSTAGE_TERRAIN);
 	// Generate general ground level to full area
 	stone_surface_max_y = generateGround();
 
@@ -542,10 +547,12 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	// Loop this part, it will make stuff look older and newer nicely
 	const u32 age_loops = 2;
 	for (u32 i_age = 0; i_age < age_loops; i_age++) { // Aging loop
+		stage_timer.start(MGSTAGE_CAVES);
 		// Make caves (this code is relatively horrible)
 		if (flags & MG_CAVES)
 			generateCaves(stone_surface_max_y);
 
+		stage_timer.start(MGSTAGE_TERRAIN);
 		// Add mud to the central chunk
 		addMud();
 
@@ -558,6 +565,7 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	// Update heightmap after mudflow
 	updateHeightmap(node_min, node_max);
 
+	stage_timer.start(MGSTAGE_DUNGEONS);
 	// Add dungeons
 	if ((flags & MG_DUNGEONS) && stone_surface_max_y >= node_min.Y &&
 			full_node_min.Y >= dungeon_ymin && full_node_max.Y <= dungeon_ymax) {
@@ -612,12 +620,15 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 		}
 	}
 
+	stage_timer.start(MGSTAGE_LIQUID);
 	// Add top and bottom side of water to transforming_liquid queue
 	updateLiquid(&data->transforming_liquid, full_node_min, full_node_max);
 
+	stage_timer.start(MGSTAGE_BIOMES);
 	// Add surface nodes
 	growGrass();
 
+	stage_timer.start(MGSTAGE_DECORATIONS);
 	// Generate some trees, and add grass, if a jungle
 	if (spflags & MGV6_TREES)
 		placeTreesAndJungleGrass();
@@ -626,10 +637,12 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	if (flags & MG_DECORATIONS)
 		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_ORES);
 	// Generate the registered ores
 	if (flags & MG_ORES)
 		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_LIGHTING);
 	// Calculate lighting
 	if (flags & MG_LIGHT)
 		calcLighting(node_min - v3s16(1, 1, 1) * MAP_BLOCKSIZE,
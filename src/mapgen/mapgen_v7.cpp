@@ -36,6 +36,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mg_biome.h"
 #include "mg_ore.h"
 #include "mg_decoration.h"
+#include "mg_noise_cache.h"
+#include "mg_stage_profiler.h"
 #include "mapgen_v7.h"
 
 
@@ -333,18 +335,23 @@ void MapgenV7::makeChunk(BlockMakeData *data)
 
 	blockseed = getBlockSeed2(full_node_min, seed);
 
+	MapgenStageTimer stage_timer(m_emerge->stage_profiler);
+
+	stage_timer.start(MGSTAGE_TERRAIN);
 	// Generate base and mountain terrain
 	s16 stone_surface_max_y = generateTerrain();
 
 	// Create heightmap
 	updateHeightmap(node_min, node_max);
 
+	stage_timer.start(MGSTAGE_BIOMES);
 	// Init biome generator, place biome-specific nodes, and build biomemap
 	if (flags & MG_BIOMES) {
 		biomegen->calcBiomeNoise(node_min);
 		generateBiomes();
 	}
 
+	stage_timer.start(MGSTAGE_CAVES);
 	// Generate tunnels, caverns and large randomwalk caves
 	if (flags & MG_CAVES) {
 		// Generate tunnels first as caverns confuse them
@@ -366,25 +373,31 @@ void MapgenV7::makeChunk(BlockMakeData *data)
 			generateCavesRandomWalk(stone_surface_max_y, large_cave_depth);
 	}
 
+	stage_timer.start(MGSTAGE_ORES);
 	// Generate the registered ores
 	if (flags & MG_ORES)
 		m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_DUNGEONS);
 	// Generate dungeons
 	if (flags & MG_DUNGEONS)
 		generateDungeons(stone_surface_max_y);
 
+	stage_timer.start(MGSTAGE_DECORATIONS);
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
 		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
 
+	stage_timer.start(MGSTAGE_BIOMES);
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
 		dustTopNodes();
 
+	stage_timer.start(MGSTAGE_LIQUID);
 	// Update liquids
 	updateLiquid(&data->transforming_liquid, full_node_min, full_node_max);
 
+	stage_timer.start(MGSTAGE_LIGHTING);
 	// Calculate lighting
 	// Limit floatland shadows
 	bool propagate_shadow = !((spflags & MGV7_FLOATLANDS) &&
@@ -487,15 +500,16 @@ int MapgenV7::generateTerrain()
 	MapNode n_water(c_water_source);
 
 	//// Calculate noise for terrain generation
-	noise_terrain_persist->perlinMap2D(node_min.X, node_min.Z);
-	float *persistmap = noise_terrain_persist->result;
-
-	noise_terrain_base->perlinMap2D(node_min.X, node_min.Z, persistmap);
-	noise_terrain_alt->perlinMap2D(node_min.X, node_min.Z, persistmap);
-	noise_height_select->perlinMap2D(node_min.X, node_min.Z);
+	NoiseMapCache *noise_cache = m_emerge->noise_cache;
+	noise_cache->perlinMap2D(noise_terrain_persist, node_min.X, node_min.Z);
+	noise_cache->perlinMap2D(noise_terrain_base, node_min.X, node_min.Z,
+		noise_terrain_persist);
+	noise_cache->perlinMap2D(noise_terrain_alt, node_min.X, node_min.Z,
+		noise_terrain_persist);
+	noise_cache->perlinMap2D(noise_height_select, node_min.X, node_min.Z);
 
 	if (spflags & MGV7_MOUNTAINS) {
-		noise_mount_height->perlinMap2D(node_min.X, node_min.Z);
+		noise_cache->perlinMap2D(noise_mount_height, node_min.X, node_min.Z);
 		noise_mountain->perlinMap3D(node_min.X, node_min.Y - 1, node_min.Z);
 	}
 
@@ -534,7 +548,7 @@ int MapgenV7::generateTerrain()
 		!gen_floatlands;
 	if (gen_rivers) {
 		noise_ridge->perlinMap3D(node_min.X, node_min.Y - 1, node_min.Z);
-		noise_ridge_uwater->perlinMap2D(node_min.X, node_min.Z);
+		noise_cache->perlinMap2D(noise_ridge_uwater, node_min.X, node_min.Z);
 	}
 
 	//// Place nodes
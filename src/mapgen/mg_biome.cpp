@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "mg_biome.h"
 #include "mg_decoration.h"
+#include "mg_noise_cache.h"
 #include "emerge.h"
 #include "server.h"
 #include "nodedef.h"
@@ -30,6 +31,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "pcg_random.h"
 
 #include <algorithm>
+#include <cmath>
+#include <map>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -123,10 +126,200 @@ void BiomeParamsOriginal::writeParams(Settings *settings) const
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+
+// Sets up to this size are scanned, a grid doesn't pay off
+constexpr size_t BIOME_LOOKUP_MIN_GRID_SITES = 8;
+constexpr u32 BIOME_LOOKUP_MAX_GRID_CELLS = 32;
+
+BiomeLookup::BiomeLookup(const std::vector<const Biome *> &biomes)
+{
+	const v3s16 no_limit_min(-MAX_MAP_GENERATION_LIMIT, 0, -MAX_MAP_GENERATION_LIMIT);
+	const v3s16 no_limit_max(MAX_MAP_GENERATION_LIMIT, 0, MAX_MAP_GENERATION_LIMIT);
+
+	std::vector<s32> bounds_y;
+	for (size_t i = 1; i < biomes.size(); i++) {
+		const Biome *b = biomes[i];
+		if (!b)
+			continue;
+
+		Site site;
+		site.heat = b->heat_point;
+		site.humidity = b->humidity_point;
+		site.min_x = b->min_pos.X;
+		site.max_x = b->max_pos.X;
+		site.min_z = b->min_pos.Z;
+		site.max_z = b->max_pos.Z;
+		site.limited_xz = b->min_pos.X > no_limit_min.X ||
+			b->min_pos.Z > no_limit_min.Z || b->max_pos.X < no_limit_max.X ||
+			b->max_pos.Z < no_limit_max.Z;
+		site.index = i;
+		m_sites.push_back(site);
+
+		bounds_y.push_back(b->min_pos.Y);
+		bounds_y.push_back((s32)b->max_pos.Y + 1);
+		bounds_y.push_back((s32)b->max_pos.Y + b->vertical_blend + 1);
+	}
+
+	std::sort(bounds_y.begin(), bounds_y.end());
+	bounds_y.erase(std::unique(bounds_y.begin(), bounds_y.end()), bounds_y.end());
+
+	// The candidates are the same everywhere in a range, many ranges
+	// share the same candidates
+	std::map<std::vector<u16>, s32> set_ids;
+	auto get_set = [&] (std::vector<u16> &&sites) -> s32 {
+		if (sites.empty())
+			return -1;
+		auto it = set_ids.find(sites);
+		if (it != set_ids.end())
+			return it->second;
+		s32 id = m_sets.size();
+		set_ids.emplace(sites, id);
+		m_sets.emplace_back();
+		m_sets.back().sites = std::move(sites);
+		buildGrid(m_sets.back());
+		return id;
+	};
+
+	for (s32 y : bounds_y) {
+		std::vector<u16> within, blend;
+		for (size_t i = 0; i < m_sites.size(); i++) {
+			const Biome *b = biomes[m_sites[i].index];
+			if (y < b->min_pos.Y || y > b->max_pos.Y + b->vertical_blend)
+				continue;
+			if (y <= b->max_pos.Y)
+				within.push_back(i);
+			else
+				blend.push_back(i);
+		}
+		m_range_y.push_back(y);
+		m_range_sets.emplace_back(get_set(std::move(within)),
+			get_set(std::move(blend)));
+	}
+}
+
+void BiomeLookup::buildGrid(SiteSet &set)
+{
+	if (set.sites.size() <= BIOME_LOOKUP_MIN_GRID_SITES)
+		return;
+
+	float heat_min = FLT_MAX, heat_max = -FLT_MAX;
+	float humidity_min = FLT_MAX, humidity_max = -FLT_MAX;
+	for (u16 i : set.sites) {
+		heat_min = std::min(heat_min, m_sites[i].heat);
+		heat_max = std::max(heat_max, m_sites[i].heat);
+		humidity_min = std::min(humidity_min, m_sites[i].humidity);
+		humidity_max = std::max(humidity_max, m_sites[i].humidity);
+	}
+	// Noise values outside of the grid are rare, these scan the whole set
+	float pad = std::max(std::max(heat_max - heat_min, humidity_max - humidity_min),
+		1.0f) * 0.5f;
+	heat_min -= pad;
+	humidity_min -= pad;
+
+	// About one site per cell and a few candidates
+	set.cells = std::min<u32>(BIOME_LOOKUP_MAX_GRID_CELLS,
+		2 * std::ceil(std::sqrt((float)set.sites.size())));
+	set.heat_min = heat_min;
+	set.humidity_min = humidity_min;
+	set.cell_heat = (heat_max + pad - heat_min) / set.cells;
+	set.cell_humidity = (humidity_max + pad - humidity_min) / set.cells;
+
+	auto sq = [] (float v) { return v * v; };
+
+	set.cell_start.reserve(set.cells * set.cells + 1);
+	for (u32 cz = 0; cz < set.cells; cz++)
+	for (u32 cx = 0; cx < set.cells; cx++) {
+		set.cell_start.push_back(set.cell_sites.size());
+
+		// Slightly larger than the cell to be safe from rounding errors
+		float h0 = heat_min + cx * set.cell_heat - set.cell_heat * 0.001f;
+		float h1 = heat_min + (cx + 1) * set.cell_heat + set.cell_heat * 0.001f;
+		float u0 = humidity_min + cz * set.cell_humidity - set.cell_humidity * 0.001f;
+		float u1 = humidity_min + (cz + 1) * set.cell_humidity + set.cell_humidity * 0.001f;
+
+		// The closest site is never further than the furthest point of the
+		// cell is from any site. Sites limited in X/Z may be skipped, so
+		// don't count on them.
+		float bound = FLT_MAX;
+		for (u16 i : set.sites) {
+			const Site &site = m_sites[i];
+			if (site.limited_xz)
+				continue;
+			float d = sq(std::max(std::fabs(site.heat - h0), std::fabs(site.heat - h1))) +
+				sq(std::max(std::fabs(site.humidity - u0), std::fabs(site.humidity - u1)));
+			bound = std::min(bound, d);
+		}
+		bound = bound * 1.0001f + 0.0001f;
+
+		for (u16 i : set.sites) {
+			const Site &site = m_sites[i];
+			float d = sq(std::max(std::max(h0 - site.heat, site.heat - h1), 0.0f)) +
+				sq(std::max(std::max(u0 - site.humidity, site.humidity - u1), 0.0f));
+			if (site.limited_xz || d <= bound)
+				set.cell_sites.push_back(i);
+		}
+	}
+	set.cell_start.push_back(set.cell_sites.size());
+}
+
+void BiomeLookup::findInSet(s32 set_id, float heat, float humidity, v3s16 pos,
+	biome_t *closest, float *dist) const
+{
+	if (set_id < 0)
+		return;
+	const SiteSet &set = m_sets[set_id];
+
+	const u16 *begin = set.sites.data();
+	const u16 *end = begin + set.sites.size();
+	if (set.cells > 0) {
+		float fx = (heat - set.heat_min) / set.cell_heat;
+		float fz = (humidity - set.humidity_min) / set.cell_humidity;
+		// Also false for NaN
+		if (fx >= 0.0f && fx < set.cells && fz >= 0.0f && fz < set.cells) {
+			u32 cell = std::min((u32)fz, set.cells - 1) * set.cells +
+				std::min((u32)fx, set.cells - 1);
+			begin = set.cell_sites.data() + set.cell_start[cell];
+			end = set.cell_sites.data() + set.cell_start[cell + 1];
+		}
+	}
+
+	// In index order, the first of equally close biomes wins
+	for (const u16 *it = begin; it != end; ++it) {
+		const Site &site = m_sites[*it];
+		if (site.limited_xz && (pos.X < site.min_x || pos.X > site.max_x ||
+				pos.Z < site.min_z || pos.Z > site.max_z))
+			continue;
+
+		float d_heat = heat - site.heat;
+		float d_humidity = humidity - site.humidity;
+		float d = (d_heat * d_heat) + (d_humidity * d_humidity);
+		if (d < *dist) {
+			*dist = d;
+			*closest = site.index;
+		}
+	}
+}
+
+BiomeLookup::Result BiomeLookup::find(float heat, float humidity, v3s16 pos) const
+{
+	Result result;
+	auto it = std::upper_bound(m_range_y.begin(), m_range_y.end(), (s32)pos.Y);
+	if (it == m_range_y.begin())
+		return result;
+
+	const auto &sets = m_range_sets[it - m_range_y.begin() - 1];
+	findInSet(sets.first, heat, humidity, pos, &result.closest, &result.dist);
+	findInSet(sets.second, heat, humidity, pos, &result.closest_blend,
+		&result.dist_blend);
+	return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 BiomeGenOriginal::BiomeGenOriginal(BiomeManager *biomemgr,
-	const BiomeParamsOriginal *params, v3s16 chunksize)
+	const BiomeParamsOriginal *params, v3s16 chunksize,
+	std::shared_ptr<const BiomeLookup> lookup)
 {
 	m_bmgr   = biomemgr;
 	m_params = params;
@@ -163,6 +356,15 @@ BiomeGenOriginal::BiomeGenOriginal(BiomeManager *biomemgr,
 	values.erase(std::unique(values.begin(), values.end()), values.end());
 
 	m_transitions_y = std::move(values);
+
+	if (!lookup) {
+		std::vector<const Biome *> biomes;
+		biomes.reserve(m_bmgr->getNumObjects());
+		for (size_t i = 0; i < m_bmgr->getNumObjects(); i++)
+			biomes.push_back((const Biome *)m_bmgr->getRaw(i));
+		lookup = std::make_shared<BiomeLookup>(biomes);
+	}
+	m_lookup = std::move(lookup);
 }
 
 BiomeGenOriginal::~BiomeGenOriginal()
@@ -184,19 +386,38 @@ s16 BiomeGenOriginal::getNextTransitionY(s16 y) const
 
 BiomeGen *BiomeGenOriginal::clone(BiomeManager *biomemgr) const
 {
-	return new BiomeGenOriginal(biomemgr, m_params, m_csize);
+	// The cloned manager has the same biomes at the same indices
+	BiomeGen *biomegen = new BiomeGenOriginal(biomemgr, m_params, m_csize,
+		m_lookup);
+	biomegen->setNoiseCache(m_noise_cache);
+	return biomegen;
+}
+
+float BiomeGenOriginal::calcNoiseAtPoint(const NoiseParams &np, v3s16 pos) const
+{
+	if (m_noise_cache) {
+		// Same origin as the maps of calcBiomeNoise()
+		v3s16 chunk_min = EmergeManager::getContainingChunk(getNodeBlockPos(pos),
+			m_csize.X / MAP_BLOCKSIZE) * MAP_BLOCKSIZE;
+		float value;
+		if (m_noise_cache->getValue(np, m_params->seed,
+				v2s32(chunk_min.X, chunk_min.Z), v2u32(m_csize.X, m_csize.Z),
+				v2s32(pos.X, pos.Z), &value))
+			return value;
+	}
+	return NoisePerlin2D(&np, pos.X, pos.Z, m_params->seed);
 }
 
 float BiomeGenOriginal::calcHeatAtPoint(v3s16 pos) const
 {
-	return NoisePerlin2D(&m_params->np_heat, pos.X, pos.Z, m_params->seed) +
-		NoisePerlin2D(&m_params->np_heat_blend, pos.X, pos.Z, m_params->seed);
+	return calcNoiseAtPoint(m_params->np_heat, pos) +
+		calcNoiseAtPoint(m_params->np_heat_blend, pos);
 }
 
 float BiomeGenOriginal::calcHumidityAtPoint(v3s16 pos) const
 {
-	return NoisePerlin2D(&m_params->np_humidity, pos.X, pos.Z, m_params->seed) +
-		NoisePerlin2D(&m_params->np_humidity_blend, pos.X, pos.Z, m_params->seed);
+	return calcNoiseAtPoint(m_params->np_humidity, pos) +
+		calcNoiseAtPoint(m_params->np_humidity_blend, pos);
 }
 
 Biome *BiomeGenOriginal::calcBiomeAtPoint(v3s16 pos) const
@@ -209,10 +430,16 @@ void BiomeGenOriginal::calcBiomeNoise(v3s16 pmin)
 {
 	m_pmin = pmin;
 
-	noise_heat->perlinMap2D(pmin.X, pmin.Z);
-	noise_humidity->perlinMap2D(pmin.X, pmin.Z);
-	noise_heat_blend->perlinMap2D(pmin.X, pmin.Z);
-	noise_humidity_blend->perlinMap2D(pmin.X, pmin.Z);
+	auto calc_map = [&] (Noise *noise) {
+		if (m_noise_cache)
+			m_noise_cache->perlinMap2D(noise, pmin.X, pmin.Z);
+		else
+			noise->perlinMap2D(pmin.X, pmin.Z);
+	};
+	calc_map(noise_heat);
+	calc_map(noise_humidity);
+	calc_map(noise_heat_blend);
+	calc_map(noise_humidity_blend);
 
 	for (s32 i = 0; i < m_csize.X * m_csize.Z; i++) {
 		noise_heat->result[i]     += noise_heat_blend->result[i];
@@ -257,33 +484,13 @@ Biome *BiomeGenOriginal::getBiomeAtIndex(size_t index, v3s16 pos) const
 
 Biome *BiomeGenOriginal::calcBiomeFromNoise(float heat, float humidity, v3s16 pos) const
 {
-	Biome *biome_closest = nullptr;
-	Biome *biome_closest_blend = nullptr;
-	float dist_min = FLT_MAX;
-	float dist_min_blend = FLT_MAX;
-
-	for (size_t i = 1; i < m_bmgr->getNumObjects(); i++) {
-		Biome *b = (Biome *)m_bmgr->getRaw(i);
-		if (!b ||
-				pos.Y < b->min_pos.Y || pos.Y > b->max_pos.Y + b->vertical_blend ||
-				pos.X < b->min_pos.X || pos.X > b->max_pos.X ||
-				pos.Z < b->min_pos.Z || pos.Z > b->max_pos.Z)
-			continue;
-
-		float d_heat = heat - b->heat_point;
-		float d_humidity = humidity - b->humidity_point;
-		float dist = (d_heat * d_heat) + (d_humidity * d_humidity);
-
-		if (pos.Y <= b->max_pos.Y) { // Within y limits of biome b
-			if (dist < dist_min) {
-				dist_min = dist;
-				biome_closest = b;
-			}
-		} else if (dist < dist_min_blend) { // Blend area above biome b
-			dist_min_blend = dist;
-			biome_closest_blend = b;
-		}
-	}
+	BiomeLookup::Result found = m_lookup->find(heat, humidity, pos);
+	Biome *biome_closest = found.closest != BIOME_NONE ?
+		(Biome *)m_bmgr->getRaw(found.closest) : nullptr;
+	Biome *biome_closest_blend = found.closest_blend != BIOME_NONE ?
+		(Biome *)m_bmgr->getRaw(found.closest_blend) : nullptr;
+	float dist_min = found.dist;
+	float dist_min_blend = found.dist_blend;
 
 	// Carefully tune pseudorandom seed variation to avoid single node dither
 	// and create larger scale blending patterns similar to horizontal biome
@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <cfloat>
+#include <memory>
 #include "objdef.h"
 #include "nodedef.h"
 #include "noise.h"
@@ -27,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 class Server;
 class Settings;
 class BiomeManager;
+class NoiseMapCache;
 
 ////
 //// Biome
@@ -134,11 +137,16 @@ class BiomeGen {
 		return y == S16_MIN ? y : (y - 1);
 	};
 
+	// Shares the noise maps with the other users of the cache, which must
+	// outlive this BiomeGen and its clones.
+	void setNoiseCache(NoiseMapCache *cache) { m_noise_cache = cache; }
+
 	// Result of calcBiomes bulk computation.
 	biome_t *biomemap = nullptr;
 
 protected:
 	BiomeManager *m_bmgr = nullptr;
+	NoiseMapCache *m_noise_cache = nullptr;
 	v3s16 m_pmin;
 	v3s16 m_csize;
 };
@@ -170,10 +178,69 @@ struct BiomeParamsOriginal : public BiomeParams {
 	NoiseParams np_humidity_blend;
 };
 
+// Finds the biomes with the closest heat and humidity point without testing
+// every biome. Biomes are bucketed by the Y ranges in which the candidates
+// don't change, and each bucket has a grid over heat and humidity listing
+// the biomes that can be the closest within a cell.
+// Immutable once built, shared by the clones of a BiomeGen.
+class BiomeLookup {
+public:
+	// biomes[i] is the biome with index i, BIOME_NONE and null entries are
+	// never returned
+	BiomeLookup(const std::vector<const Biome *> &biomes);
+
+	struct Result {
+		// Closest biome within its y limits
+		biome_t closest = BIOME_NONE;
+		float dist = FLT_MAX;
+		// Closest biome with pos in its vertical blend area
+		biome_t closest_blend = BIOME_NONE;
+		float dist_blend = FLT_MAX;
+	};
+
+	// Same result as testing every biome in index order
+	Result find(float heat, float humidity, v3s16 pos) const;
+
+private:
+	struct Site {
+		float heat, humidity;
+		s16 min_x, max_x, min_z, max_z;
+		// Has X or Z limits, which are checked for each position
+		bool limited_xz;
+		biome_t index;
+	};
+
+	// Biomes that are candidates in a y range
+	struct SiteSet {
+		std::vector<u16> sites;
+		// Grid, unused for small sets
+		u32 cells = 0;
+		float heat_min, humidity_min;
+		float cell_heat, cell_humidity;
+		// Sites of cell i are cell_sites[cell_start[i]] to cell_sites[cell_start[i + 1]]
+		std::vector<u32> cell_start;
+		std::vector<u16> cell_sites;
+	};
+
+	void buildGrid(SiteSet &set);
+	void findInSet(s32 set_id, float heat, float humidity, v3s16 pos,
+		biome_t *closest, float *dist) const;
+
+	std::vector<Site> m_sites;
+	std::vector<SiteSet> m_sets;
+	// Y range i starts at m_range_y[i] and ends before m_range_y[i + 1]
+	std::vector<s32> m_range_y;
+	// Sets of biomes within their y limits and in their blend area per range,
+	// -1 if none
+	std::vector<std::pair<s32, s32>> m_range_sets;
+};
+
 class BiomeGenOriginal final : public BiomeGen {
 public:
+	// @param lookup shared lookup structure, built if null
 	BiomeGenOriginal(BiomeManager *biomemgr,
-		const BiomeParamsOriginal *params, v3s16 chunksize);
+		const BiomeParamsOriginal *params, v3s16 chunksize,
+		std::shared_ptr<const BiomeLookup> lookup = nullptr);
 	virtual ~BiomeGenOriginal();
 
 	BiomeGenType getType() const { return BIOMEGEN_ORIGINAL; }
@@ -198,6 +265,9 @@ class BiomeGenOriginal final : public BiomeGen {
 	float *humidmap;
 
 private:
+	// Value of the noise at pos, from the cached map of its mapchunk if any
+	float calcNoiseAtPoint(const NoiseParams &np, v3s16 pos) const;
+
 	const BiomeParamsOriginal *m_params;
 
 	Noise *noise_heat;
@@ -207,6 +277,8 @@ class BiomeGenOriginal final : public BiomeGen {
 
 	// ordered descending
 	std::vector<s16> m_transitions_y;
+
+	std::shared_ptr<const BiomeLookup> m_lookup;
 };
 
 
@@ -45,6 +45,75 @@ FlagDesc flagdesc_deco[] = {
 ///////////////////////////////////////////////////////////////////////////////
 
 
+DecoSurfaceIndex::DecoSurfaceIndex(MMVManip *vm, const NodeDefManager *ndef,
+	v3s16 nmin, v3s16 nmax) :
+	m_vm(vm),
+	m_ndef(ndef),
+	m_nmin(nmin),
+	m_nmax(nmax),
+	m_sizex(nmax.X - nmin.X + 1)
+{
+}
+
+
+DecoSurfaceIndex::Surfaces DecoSurfaceIndex::getSurfaces(v2s16 p2d)
+{
+	if (m_columns.empty())
+		m_columns.resize((size_t)m_sizex * (m_nmax.Z - m_nmin.Z + 1));
+
+	Column &column = m_columns[(size_t)m_sizex * (p2d.Y - m_nmin.Z) +
+		(p2d.X - m_nmin.X)];
+	if (column.generation != m_generation) {
+		if (m_surfaces_unused) {
+			m_surfaces.clear();
+			m_surfaces_unused = false;
+		}
+
+		m_floors.clear();
+		m_ceilings.clear();
+		Mapgen::getSurfaces(m_vm, m_ndef, p2d, m_nmin.Y, m_nmax.Y,
+			m_floors, m_ceilings);
+
+		column.generation = m_generation;
+		column.offset = m_surfaces.size();
+		column.num_floors = m_floors.size();
+		column.num_ceilings = m_ceilings.size();
+		m_surfaces.insert(m_surfaces.end(), m_floors.begin(), m_floors.end());
+		m_surfaces.insert(m_surfaces.end(), m_ceilings.begin(), m_ceilings.end());
+	}
+
+	const s16 *floors = m_surfaces.data() + column.offset;
+	return {floors, column.num_floors,
+		floors + column.num_floors, column.num_ceilings};
+}
+
+
+void DecoSurfaceIndex::invalidate(v2s16 pmin, v2s16 pmax)
+{
+	if (m_columns.empty())
+		return;
+
+	s16 x0 = MYMAX(pmin.X, m_nmin.X), x1 = MYMIN(pmax.X, m_nmax.X);
+	s16 z0 = MYMAX(pmin.Y, m_nmin.Z), z1 = MYMIN(pmax.Y, m_nmax.Z);
+	for (s16 z = z0; z <= z1; z++) {
+		size_t i = (size_t)m_sizex * (z - m_nmin.Z) + (x0 - m_nmin.X);
+		for (s16 x = x0; x <= x1; x++, i++)
+			m_columns[i].generation = 0;
+	}
+}
+
+
+void DecoSurfaceIndex::invalidateAll()
+{
+	m_generation++;
+	// Still in use until the next lookup
+	m_surfaces_unused = true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
 DecorationManager::DecorationManager(IGameDef *gamedef) :
 	ObjDefManager(gamedef, OBJDEF_DECORATION)
 {
@@ -55,13 +124,14 @@ size_t DecorationManager::placeAllDecos(Mapgen *mg, u32 blockseed,
 	v3s16 nmin, v3s16 nmax)
 {
 	size_t nplaced = 0;
+	DecoSurfaceIndex surfaces(mg->vm, mg->ndef, nmin, nmax);
 
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Decoration *deco = (Decoration *)m_objects[i];
 		if (!deco)
 			continue;
 
-		nplaced += deco->placeDeco(mg, blockseed, nmin, nmax);
+		nplaced += deco->placeDeco(mg, blockseed, nmin, nmax, surfaces);
 		blockseed++;
 	}
 
@@ -143,7 +213,8 @@ bool Decoration::canPlaceDecoration(MMVManip *vm, v3s16 p)
 }
 
 
-size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	DecoSurfaceIndex &surfaces)
 {
 	PcgRandom ps(blockseed + 53);
 	int carea_size = nmax.X - nmin.X + 1;
@@ -220,36 +291,37 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 						continue;
 				}
 
-				// Get all floors and ceilings in node column
-				u16 size = (nmax.Y - nmin.Y + 1) / 2;
-				std::vector<s16> floors;
-				std::vector<s16> ceilings;
-				floors.reserve(size);
-				ceilings.reserve(size);
-
-				mg->getSurfaces(v2s16(x, z), nmin.Y, nmax.Y, floors, ceilings);
+				// Get all floors and ceilings in node column. Placing decorations
+				// only invalidates them, they are found again on the next lookup.
+				DecoSurfaceIndex::Surfaces column = surfaces.getSurfaces(v2s16(x, z));
 
 				if (flags & DECO_ALL_FLOORS) {
 					// Floor decorations
-					for (const s16 y : floors) {
+					for (u16 j = 0; j < column.num_floors; j++) {
+						s16 y = column.floors[j];
 						if (y < y_min || y > y_max)
 							continue;
 
 						v3s16 pos(x, y, z);
-						if (generate(mg->vm, &ps, pos, false))
+						size_t placed = generate(mg->vm, &ps, pos, false);
+						if (placed)
 							mg->gennotify.addDecorationEvent(pos, index);
+						invalidateSurfaces(surfaces, pos, placed);
 					}
 				}
 
 				if (flags & DECO_ALL_CEILINGS) {
 					// Ceiling decorations
-					for (const s16 y : ceilings) {
+					for (u16 j = 0; j < column.num_ceilings; j++) {
+						s16 y = column.ceilings[j];
 						if (y < y_min || y > y_max)
 							continue;
 
 						v3s16 pos(x, y, z);
-						if (generate(mg->vm, &ps, pos, true))
+						size_t placed = generate(mg->vm, &ps, pos, true);
+						if (placed)
 							mg->gennotify.addDecorationEvent(pos, index);
+						invalidateSurfaces(surfaces, pos, placed);
 					}
 				}
 			} else { // Heightmap decorations
@@ -271,8 +343,10 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 				}
 
 				v3s16 pos(x, y, z);
-				if (generate(mg->vm, &ps, pos, false))
+				size_t placed = generate(mg->vm, &ps, pos, false);
+				if (placed)
 					mg->gennotify.addDecorationEvent(pos, index);
+				invalidateSurfaces(surfaces, pos, placed);
 			}
 		}
 	}
@@ -281,6 +355,17 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 }
 
 
+void Decoration::invalidateSurfaces(DecoSurfaceIndex &surfaces, v3s16 p,
+	size_t placed) const
+{
+	v2s16 pmin, pmax;
+	if (!getChangedColumns(p, &pmin, &pmax))
+		surfaces.invalidateAll();
+	else if (placed)
+		surfaces.invalidate(pmin, pmax);
+}
+
+
 void Decoration::cloneTo(Decoration *def) const
 {
 	ObjDef::cloneTo(def);
@@ -325,6 +410,13 @@ void DecoSimple::resolveNodeNames()
 }
 
 
+bool DecoSimple::getChangedColumns(v3s16 p, v2s16 *pmin, v2s16 *pmax) const
+{
+	*pmin = *pmax = v2s16(p.X, p.Z);
+	return true;
+}
+
+
 size_t DecoSimple::generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling)
 {
 	// Don't bother if there aren't any decorations to place
@@ -422,6 +514,16 @@ ObjDef *DecoSchematic::clone() const
 }
 
 
+bool DecoSchematic::getChangedColumns(v3s16 p, v2s16 *pmin, v2s16 *pmax) const
+{
+	// Any rotation and centering
+	s16 r = schematic ? MYMAX(schematic->size.X, schematic->size.Z) - 1 : 0;
+	*pmin = v2s16(p.X - r, p.Z - r);
+	*pmax = v2s16(p.X + r, p.Z + r);
+	return true;
+}
+
+
 size_t DecoSchematic::generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling)
 {
 	// Schematic could have been unloaded but not the decoration
@@ -52,6 +52,58 @@ enum DecorationType {
 extern FlagDesc flagdesc_deco[];
 
 
+/*
+	Floors and ceilings of the node columns of a mapchunk, shared by all
+	decorations placed in it so that a column is only scanned again after
+	a decoration changed it.
+*/
+class DecoSurfaceIndex {
+public:
+	struct Surfaces {
+		const s16 *floors;
+		u16 num_floors;
+		const s16 *ceilings;
+		u16 num_ceilings;
+	};
+
+	DecoSurfaceIndex(MMVManip *vm, const NodeDefManager *ndef,
+		v3s16 nmin, v3s16 nmax);
+
+	// Same as Mapgen::getSurfaces() from nmin.Y to nmax.Y. The result stays
+	// valid until the next call.
+	Surfaces getSurfaces(v2s16 p2d);
+
+	// Columns that have to be scanned again, clamped to the mapchunk
+	void invalidate(v2s16 pmin, v2s16 pmax);
+	void invalidateAll();
+
+private:
+	struct Column {
+		// Valid if equal to m_generation
+		u32 generation = 0;
+		// Floors followed by ceilings in m_surfaces
+		u32 offset = 0;
+		u16 num_floors = 0;
+		u16 num_ceilings = 0;
+	};
+
+	MMVManip *m_vm;
+	const NodeDefManager *m_ndef;
+	v3s16 m_nmin, m_nmax;
+	s16 m_sizex;
+	u32 m_generation = 1;
+	// Allocated on first use
+	std::vector<Column> m_columns;
+	// Surfaces of all columns, including the ones of invalidated columns
+	// until everything is invalidated
+	std::vector<s16> m_surfaces;
+	// None of m_surfaces is referenced by a valid column
+	bool m_surfaces_unused = false;
+	// Reused for scanning
+	std::vector<s16> m_floors, m_ceilings;
+};
+
+
 class Decoration : public ObjDef, public NodeResolver {
 public:
 	Decoration() = default;
@@ -60,9 +112,17 @@ class Decoration : public ObjDef, public NodeResolver {
 	virtual void resolveNodeNames();
 
 	bool canPlaceDecoration(MMVManip *vm, v3s16 p);
-	size_t placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
+	size_t placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+		DecoSurfaceIndex &surfaces);
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling) = 0;
+	// Node columns that generate() at p changes if it returned non-zero.
+	// Returns false if it can change nodes anywhere, whatever it returned.
+	// The default is for DecoLSystem, which returns 0 on success.
+	virtual bool getChangedColumns(v3s16 p, v2s16 *pmin, v2s16 *pmax) const
+	{
+		return false;
+	}
 
 	u32 flags = 0;
 	int mapseed = 0;
@@ -81,6 +141,11 @@ class Decoration : public ObjDef, public NodeResolver {
 
 protected:
 	void cloneTo(Decoration *def) const;
+
+private:
+	// Called after every generate() call
+	void invalidateSurfaces(DecoSurfaceIndex &surfaces, v3s16 p,
+		size_t placed) const;
 };
 
 
@@ -90,6 +155,7 @@ class DecoSimple : public Decoration {
 
 	virtual void resolveNodeNames();
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling);
+	virtual bool getChangedColumns(v3s16 p, v2s16 *pmin, v2s16 *pmax) const;
 
 	std::vector<content_t> c_decos;
 	s16 deco_height;
@@ -107,6 +173,7 @@ class DecoSchematic : public Decoration {
 	virtual ~DecoSchematic();
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling);
+	virtual bool getChangedColumns(v3s16 p, v2s16 *pmin, v2s16 *pmax) const;
 
 	Rotation rotation;
 	Schematic *schematic = nullptr;
@@ -0,0 +1,191 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "mg_noise_cache.h"
+#include <cstring>
+#include <functional>
+#include "profiler.h"
+#include "threading/mutex_auto_lock.h"
+
+static bool noise_params_equal(const NoiseParams &a, const NoiseParams &b)
+{
+	return a.offset == b.offset && a.scale == b.scale &&
+		a.spread == b.spread && a.seed == b.seed &&
+		a.octaves == b.octaves && a.persist == b.persist &&
+		a.lacunarity == b.lacunarity && a.flags == b.flags;
+}
+
+static inline void hash_combine(size_t &h, size_t v)
+{
+	h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+}
+
+static void hash_noise_params(size_t &h, const NoiseParams &np)
+{
+	std::hash<float> hf;
+	hash_combine(h, hf(np.offset));
+	hash_combine(h, hf(np.scale));
+	hash_combine(h, hf(np.spread.X));
+	hash_combine(h, hf(np.spread.Y));
+	hash_combine(h, hf(np.spread.Z));
+	hash_combine(h, np.seed);
+	hash_combine(h, np.octaves);
+	hash_combine(h, hf(np.persist));
+	hash_combine(h, hf(np.lacunarity));
+	hash_combine(h, np.flags);
+}
+
+bool NoiseMapCache::Key::operator==(const Key &other) const
+{
+	if (seed != other.seed || origin != other.origin || size != other.size ||
+			has_persist != other.has_persist ||
+			!noise_params_equal(np, other.np))
+		return false;
+	return !has_persist || (persist_seed == other.persist_seed &&
+		noise_params_equal(persist_np, other.persist_np));
+}
+
+size_t NoiseMapCache::KeyHash::operator()(const Key &key) const
+{
+	size_t h = 0;
+	hash_noise_params(h, key.np);
+	hash_combine(h, key.seed);
+	hash_combine(h, key.origin.X);
+	hash_combine(h, key.origin.Y);
+	hash_combine(h, key.size.X);
+	hash_combine(h, key.size.Y);
+	if (key.has_persist) {
+		hash_noise_params(h, key.persist_np);
+		hash_combine(h, key.persist_seed);
+	}
+	return h;
+}
+
+NoiseMapCache::NoiseMapCache(size_t max_bytes, MetricsBackend *mb) :
+	m_max_bytes(max_bytes)
+{
+	if (mb) {
+		m_hit_counter = mb->addCounter("minetest_mapgen_noise_cache_hits",
+			"Number of 2D noise maps found in the cache");
+		m_miss_counter = mb->addCounter("minetest_mapgen_noise_cache_misses",
+			"Number of 2D noise maps not found in the cache");
+	}
+}
+
+NoiseMapCache::Key NoiseMapCache::makeKey(const Noise *noise, s32 x, s32 y,
+	const Noise *persist)
+{
+	Key key;
+	key.np = noise->np;
+	key.seed = noise->seed;
+	key.origin = v2s32(x, y);
+	key.size = v2u32(noise->sx, noise->sy);
+	if (persist) {
+		key.has_persist = true;
+		key.persist_np = persist->np;
+		key.persist_seed = persist->seed;
+	}
+	return key;
+}
+
+float *NoiseMapCache::perlinMap2D(Noise *noise, s32 x, s32 y, const Noise *persist)
+{
+	Key key = makeKey(noise, x, y, persist);
+	const size_t count = (size_t)noise->sx * noise->sy;
+
+	// Copied outside of the lock, the entry can't change
+	Result cached = get(key);
+	g_profiler->avg("Mapgen: noise cache hit rate [%]", cached ? 100 : 0);
+	if (cached) {
+		memcpy(noise->result, cached->data(), count * sizeof(float));
+		return noise->result;
+	}
+
+	noise->perlinMap2D(x, y, persist ? persist->result : nullptr);
+	put(key, std::make_shared<std::vector<float>>(
+		noise->result, noise->result + count));
+	return noise->result;
+}
+
+bool NoiseMapCache::getValue(const NoiseParams &np, s32 seed, v2s32 origin,
+	v2u32 size, v2s32 pos, float *value)
+{
+	Key key;
+	key.np = np;
+	key.seed = seed;
+	key.origin = origin;
+	key.size = size;
+
+	v2s32 rel = pos - origin;
+	if (rel.X < 0 || rel.Y < 0 || (u32)rel.X >= size.X || (u32)rel.Y >= size.Y)
+		return false;
+
+	Result cached = get(key);
+	if (!cached)
+		return false;
+	*value = (*cached)[(size_t)rel.Y * size.X + rel.X];
+	return true;
+}
+
+NoiseMapCache::Result NoiseMapCache::get(const Key &key)
+{
+	Result result;
+	{
+		MutexAutoLock lock(m_mutex);
+		auto it = m_entries.find(key);
+		if (it != m_entries.end()) {
+			m_lru.splice(m_lru.begin(), m_lru, it->second.lru_it);
+			result = it->second.result;
+			m_hits++;
+		} else {
+			m_misses++;
+		}
+	}
+
+	MetricCounterPtr &counter = result ? m_hit_counter : m_miss_counter;
+	if (counter)
+		counter->increment();
+	return result;
+}
+
+void NoiseMapCache::put(const Key &key, Result result)
+{
+	const size_t bytes = result->size() * sizeof(float);
+	if (bytes > m_max_bytes)
+		return;
+
+	MutexAutoLock lock(m_mutex);
+	// Another thread computed the same map meanwhile
+	if (m_entries.find(key) != m_entries.end())
+		return;
+
+	while (m_bytes + bytes > m_max_bytes && !m_lru.empty()) {
+		auto it = m_entries.find(m_lru.back());
+		m_bytes -= it->second.result->size() * sizeof(float);
+		m_entries.erase(it);
+		m_lru.pop_back();
+	}
+
+	m_lru.push_front(key);
+	m_entries[key] = Entry{std::move(result), m_lru.begin()};
+	m_bytes += bytes;
+}
+
+NoiseMapCache::Stats NoiseMapCache::getStats()
+{
+	MutexAutoLock lock(m_mutex);
+	Stats stats;
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.entries = m_entries.size();
+	stats.bytes = m_bytes;
+	return stats;
+}
+
+void NoiseMapCache::clear()
+{
+	MutexAutoLock lock(m_mutex);
+	m_entries.clear();
+	m_lru.clear();
+	m_bytes = 0;
+}
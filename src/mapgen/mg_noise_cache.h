@@ -0,0 +1,99 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "irr_v2d.h"
+#include "noise.h"
+#include "util/basic_macros.h"
+#include "util/metricsbackend.h"
+
+// Default size, enough for the 2D maps of some dozen mapchunk columns
+constexpr size_t NOISE_CACHE_MAX_BYTES = 16 * 1024 * 1024;
+
+/**
+ * Bounded cache of 2D noise maps, shared by the mapgens of all emerge
+ * threads and the Lua biome API.
+ *
+ * 2D noise only depends on the X and Z position, so all mapchunks of a
+ * column compute the same maps. Entries are keyed by the noise parameters,
+ * seed, origin and size, the least recently used ones are dropped first.
+ * Thread-safe.
+ */
+class NoiseMapCache
+{
+public:
+	struct Stats {
+		u64 hits = 0;
+		u64 misses = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+	};
+
+	/// @param mb registers hit and miss counters if not null
+	NoiseMapCache(size_t max_bytes, MetricsBackend *mb = nullptr);
+
+	DISABLE_CLASS_COPY(NoiseMapCache)
+
+	/// Same as noise->perlinMap2D(x, y, persist ? persist->result : nullptr),
+	/// using a cached result if there is one.
+	/// @param persist noise whose map at the same position was just computed
+	///   and is used as persistence map
+	float *perlinMap2D(Noise *noise, s32 x, s32 y, const Noise *persist = nullptr);
+
+	/// Looks up the value at pos of a cached map without persistence map.
+	/// @return false if the map is not cached
+	bool getValue(const NoiseParams &np, s32 seed, v2s32 origin, v2u32 size,
+		v2s32 pos, float *value);
+
+	Stats getStats();
+	void clear();
+
+private:
+	struct Key {
+		NoiseParams np;
+		s32 seed;
+		v2s32 origin;
+		v2u32 size;
+		// Parameters of the persistence map noise, if used
+		bool has_persist = false;
+		NoiseParams persist_np;
+		s32 persist_seed = 0;
+
+		bool operator==(const Key &other) const;
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key &key) const;
+	};
+
+	using Result = std::shared_ptr<const std::vector<float>>;
+
+	struct Entry {
+		Result result;
+		std::list<Key>::iterator lru_it;
+	};
+
+	static Key makeKey(const Noise *noise, s32 x, s32 y, const Noise *persist);
+
+	Result get(const Key &key);
+	void put(const Key &key, Result result);
+
+	const size_t m_max_bytes;
+
+	std::mutex m_mutex;
+	std::unordered_map<Key, Entry, KeyHash> m_entries;
+	// Most recently used first
+	std::list<Key> m_lru;
+	size_t m_bytes = 0;
+	u64 m_hits = 0;
+	u64 m_misses = 0;
+
+	MetricCounterPtr m_hit_counter;
+	MetricCounterPtr m_miss_counter;
+};
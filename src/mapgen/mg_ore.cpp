@@ -94,6 +94,13 @@ void Ore::resolveNodeNames()
 {
 	getIdFromNrBacklog(&c_ore, "", CONTENT_AIR);
 	getIdsFromNrBacklog(&c_wherein);
+
+	m_wherein_lookup.clear();
+	for (content_t c : c_wherein) {
+		if (c >= m_wherein_lookup.size())
+			m_wherein_lookup.resize(c + 1, false);
+		m_wherein_lookup[c] = true;
+	}
 }
 
 
@@ -121,6 +128,7 @@ void Ore::cloneTo(Ore *def) const
 	NodeResolver::cloneTo(def);
 	def->c_ore = c_ore;
 	def->c_wherein = c_wherein;
+	def->m_wherein_lookup = m_wherein_lookup;
 	def->clust_scarcity = clust_scarcity;
 	def->clust_num_ores = clust_num_ores;
 	def->clust_size = clust_size;
@@ -177,16 +185,16 @@ void OreScatter::generate(MMVManip *vm, int mapseed, u32 blockseed,
 		}
 
 		for (u32 z1 = 0; z1 != csize; z1++)
-		for (u32 y1 = 0; y1 != csize; y1++)
-		for (u32 x1 = 0; x1 != csize; x1++) {
-			if (pr.range(1, cvolume) > clust_num_ores)
-				continue;
-
-			u32 i = vm->m_area.index(x0 + x1, y0 + y1, z0 + z1);
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
-				continue;
-
-			vm->m_data[i] = n_ore;
+		for (u32 y1 = 0; y1 != csize; y1++) {
+			u32 i = vm->m_area.index(x0, y0 + y1, z0 + z1);
+			for (u32 x1 = 0; x1 != csize; x1++, i++) {
+				if (pr.range(1, cvolume) > clust_num_ores)
+					continue;
+				if (!isWherein(vm->m_data[i].getContent()))
+					continue;
+
+				vm->m_data[i] = n_ore;
+			}
 		}
 	}
 }
@@ -248,11 +256,12 @@ void OreSheet::generate(MMVManip *vm, int mapseed, u32 blockseed,
 		int y0 = MYMAX(nmin.Y, ymidpoint - height * (1 - column_midpoint_factor));
 		int y1 = MYMIN(nmax.Y, y0 + height - 1);
 
-		for (int y = y0; y <= y1; y++) {
-			u32 i = vm->m_area.index(x, y, z);
+		const u32 ystride = vm->m_area.getExtent().X;
+		u32 i = vm->m_area.index(x, y0, z);
+		for (int y = y0; y <= y1; y++, i += ystride) {
 			if (!vm->m_area.contains(i))
 				continue;
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
+			if (!isWherein(vm->m_data[i].getContent()))
 				continue;
 
 			vm->m_data[i] = n_ore;
@@ -342,11 +351,12 @@ void OrePuff::generate(MMVManip *vm, int mapseed, u32 blockseed,
 		if ((flags & OREFLAG_PUFF_ADDITIVE) && (y0 > y1))
 			SWAP(int, y0, y1);
 
-		for (int y = y0; y <= y1; y++) {
-			u32 i = vm->m_area.index(x, y, z);
+		const u32 ystride = vm->m_area.getExtent().X;
+		u32 i = vm->m_area.index(x, y0, z);
+		for (int y = y0; y <= y1; y++, i += ystride) {
 			if (!vm->m_area.contains(i))
 				continue;
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
+			if (!isWherein(vm->m_data[i].getContent()))
 				continue;
 
 			vm->m_data[i] = n_ore;
@@ -399,31 +409,32 @@ void OreBlob::generate(MMVManip *vm, int mapseed, u32 blockseed,
 
 		size_t index = 0;
 		for (u32 z1 = 0; z1 != csize; z1++)
-		for (u32 y1 = 0; y1 != csize; y1++)
-		for (u32 x1 = 0; x1 != csize; x1++, index++) {
-			u32 i = vm->m_area.index(x0 + x1, y0 + y1, z0 + z1);
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
-				continue;
+		for (u32 y1 = 0; y1 != csize; y1++) {
+			u32 i = vm->m_area.index(x0, y0 + y1, z0 + z1);
+			for (u32 x1 = 0; x1 != csize; x1++, index++, i++) {
+				if (!isWherein(vm->m_data[i].getContent()))
+					continue;
 
-			// Lazily generate noise only if there's a chance of ore being placed
-			// This simple optimization makes calls 6x faster on average
-			if (!noise_generated) {
-				noise_generated = true;
-				noise->perlinMap3D(x0, y0, z0);
-			}
+				// Lazily generate noise only if there's a chance of ore being placed
+				// This simple optimization makes calls 6x faster on average
+				if (!noise_generated) {
+					noise_generated = true;
+					noise->perlinMap3D(x0, y0, z0);
+				}
 
-			float noiseval = noise->result[index];
+				float noiseval = noise->result[index];
 
-			float xdist = (s32)x1 - (s32)csize / 2;
-			float ydist = (s32)y1 - (s32)csize / 2;
-			float zdist = (s32)z1 - (s32)csize / 2;
+				float xdist = (s32)x1 - (s32)csize / 2;
+				float ydist = (s32)y1 - (s32)csize / 2;
+				float zdist = (s32)z1 - (s32)csize / 2;
 
-			noiseval -= std::sqrt(xdist * xdist + ydist * ydist + zdist * zdist) / csize;
+				noiseval -= std::sqrt(xdist * xdist + ydist * ydist + zdist * zdist) / csize;
 
-			if (noiseval < nthresh)
-				continue;
+				if (noiseval < nthresh)
+					continue;
 
-			vm->m_data[i] = n_ore;
+				vm->m_data[i] = n_ore;
+			}
 		}
 	}
 }
@@ -473,43 +484,49 @@ void OreVein::generate(MMVManip *vm, int mapseed, u32 blockseed,
 		sizey_prev = sizey;
 	}
 
+	// Look the biomes up once per column instead of per node
+	std::vector<bool> column_allowed;
+	if (biomemap && !biomes.empty()) {
+		int sizez = nmax.Z - nmin.Z + 1;
+		column_allowed.resize(sizex * sizez);
+		for (int j = 0; j < sizex * sizez; j++)
+			column_allowed[j] = biomes.find(biomemap[j]) != biomes.end();
+	}
+
 	bool noise_generated = false;
 	size_t index = 0;
 	for (int z = nmin.Z; z <= nmax.Z; z++)
-	for (int y = nmin.Y; y <= nmax.Y; y++)
-	for (int x = nmin.X; x <= nmax.X; x++, index++) {
-		u32 i = vm->m_area.index(x, y, z);
-		if (!vm->m_area.contains(i))
-			continue;
-		if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
-			continue;
-
-		if (biomemap && !biomes.empty()) {
-			u32 bmapidx = sizex * (z - nmin.Z) + (x - nmin.X);
-			auto it = biomes.find(biomemap[bmapidx]);
-			if (it == biomes.end())
+	for (int y = nmin.Y; y <= nmax.Y; y++) {
+		u32 i = vm->m_area.index(nmin.X, y, z);
+		u32 bmapidx = sizex * (z - nmin.Z);
+		for (int x = nmin.X; x <= nmax.X; x++, index++, i++, bmapidx++) {
+			if (!vm->m_area.contains(i))
+				continue;
+			if (!isWherein(vm->m_data[i].getContent()))
+				continue;
+			if (!column_allowed.empty() && !column_allowed[bmapidx])
 				continue;
-		}
 
-		// Same lazy generation optimization as in OreBlob
-		if (!noise_generated) {
-			noise_generated = true;
-			noise->perlinMap3D(nmin.X, nmin.Y, nmin.Z);
-			noise2->perlinMap3D(nmin.X, nmin.Y, nmin.Z);
-		}
+			// Same lazy generation optimization as in OreBlob
+			if (!noise_generated) {
+				noise_generated = true;
+				noise->perlinMap3D(nmin.X, nmin.Y, nmin.Z);
+				noise2->perlinMap3D(nmin.X, nmin.Y, nmin.Z);
+			}
 
-		// randval ranges from -1..1
-		/*
-			Note: can generate values slightly larger than 1
-			but this can't be changed as mapgen must be deterministic accross versions.
-		*/
-		float randval   = (float)pr.next() / float(pr.RANDOM_RANGE / 2) - 1.f;
-		float noiseval  = contour(noise->result[index]);
-		float noiseval2 = contour(noise2->result[index]);
-		if (noiseval * noiseval2 + randval * random_factor < nthresh)
-			continue;
+			// randval ranges from -1..1
+			/*
+				Note: can generate values slightly larger than 1
+				but this can't be changed as mapgen must be deterministic accross versions.
+			*/
+			float randval   = (float)pr.next() / float(pr.RANDOM_RANGE / 2) - 1.f;
+			float noiseval  = contour(noise->result[index]);
+			float noiseval2 = contour(noise2->result[index]);
+			if (noiseval * noiseval2 + randval * random_factor < nthresh)
+				continue;
 
-		vm->m_data[i] = n_ore;
+			vm->m_data[i] = n_ore;
+		}
 	}
 }
 
@@ -560,6 +577,7 @@ void OreStratum::generate(MMVManip *vm, int mapseed, u32 blockseed,
 		noise_stratum_thickness->perlinMap2D(nmin.X, nmin.Z);
 	}
 
+	const u32 ystride = vm->m_area.getExtent().X;
 	size_t index = 0;
 
 	for (int z = nmin.Z; z <= nmax.Z; z++)
@@ -585,14 +603,13 @@ void OreStratum::generate(MMVManip *vm, int mapseed, u32 blockseed,
 			y1 = nmax.Y;
 		}
 
-		for (int y = y0; y <= y1; y++) {
+		u32 i = vm->m_area.index(x, y0, z);
+		for (int y = y0; y <= y1; y++, i += ystride) {
 			if (pr.range(1, clust_scarcity) != 1)
 				continue;
-
-			u32 i = vm->m_area.index(x, y, z);
 			if (!vm->m_area.contains(i))
 				continue;
-			if (!CONTAINS(c_wherein, vm->m_data[i].getContent()))
+			if (!isWherein(vm->m_data[i].getContent()))
 				continue;
 
 			vm->m_data[i] = n_ore;
@@ -79,6 +79,16 @@ class Ore : public ObjDef, public NodeResolver {
 
 protected:
 	void cloneTo(Ore *def) const;
+
+	// Whether c is one of c_wherein
+	inline bool isWherein(content_t c) const
+	{
+		return c < m_wherein_lookup.size() && m_wherein_lookup[c];
+	}
+
+private:
+	// c_wherein indexed by content id, so that it is not searched per node
+	std::vector<bool> m_wherein_lookup;
 };
 
 class OreScatter : public Ore {
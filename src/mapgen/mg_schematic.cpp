@@ -26,12 +26,15 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "map.h"
 #include "mapblock.h"
 #include "log.h"
+#include "util/hex.h"
 #include "util/numeric.h"
 #include "util/serialize.h"
 #include "serialization.h"
 #include "filesys.h"
 #include "voxelalgorithms.h"
 #include "porting.h"
+#include "settings.h"
+#include "threading/mutex_auto_lock.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -77,13 +80,35 @@ void SchematicManager::clear()
 
 
 Schematic::~Schematic()
+{
+	freeData();
+}
+
+
+Schematic::SharedData::~SharedData()
 {
 	delete []schemdata;
 	delete []slice_probs;
-	u32 nodecount = size.X * size.Y * size.Z;
 	porting::TrackFreedMemory(nodecount * sizeof(MapNode));
 }
 
+
+void Schematic::freeData()
+{
+	if (m_shared) {
+		// Freed along with the last clone
+		m_shared.reset();
+	} else {
+		delete []schemdata;
+		delete []slice_probs;
+		u32 nodecount = size.X * size.Y * size.Z;
+		porting::TrackFreedMemory(nodecount * sizeof(MapNode));
+	}
+	schemdata = nullptr;
+	slice_probs = nullptr;
+}
+
+
 ObjDef *Schematic::clone() const
 {
 	auto def = new Schematic();
@@ -94,11 +119,19 @@ ObjDef *Schematic::clone() const
 	def->flags = flags;
 	def->size = size;
 	FATAL_ERROR_IF(!schemdata, "Schematic can only be cloned after loading");
-	u32 nodecount = size.X * size.Y * size.Z;
-	def->schemdata = new MapNode[nodecount];
-	memcpy(def->schemdata, schemdata, sizeof(MapNode) * nodecount);
-	def->slice_probs = new u8[size.Y];
-	memcpy(def->slice_probs, slice_probs, sizeof(u8) * size.Y);
+
+	// Every emerge thread has its own clone, they all share the nodes and
+	// the rotated images instead of copying them
+	if (!m_shared) {
+		m_shared = std::make_shared<SharedData>();
+		m_shared->schemdata = schemdata;
+		m_shared->slice_probs = slice_probs;
+		m_shared->nodecount = size.X * size.Y * size.Z;
+	}
+	def->m_shared = m_shared;
+	def->schemdata = schemdata;
+	def->slice_probs = slice_probs;
+	def->m_blit_cache = m_blit_cache;
 
 	return def;
 }
@@ -106,6 +139,7 @@ ObjDef *Schematic::clone() const
 
 void Schematic::resolveNodeNames()
 {
+	clearBlitImages();
 	c_nodes.clear();
 	getIdsFromNrBacklog(&c_nodes, true, CONTENT_AIR);
 
@@ -123,10 +157,14 @@ void Schematic::resolveNodeNames()
 }
 
 
-void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+std::shared_ptr<const Schematic::BlitImage> Schematic::getBlitImage(Rotation rot)
 {
-	assert(schemdata && slice_probs);
-	sanity_check(m_ndef != NULL);
+	// Keep the cache alive, clearBlitImages() might replace it
+	std::shared_ptr<BlitImageCache> cache = m_blit_cache;
+	MutexAutoLock lock(cache->mutex);
+	std::shared_ptr<const BlitImage> &cached = cache->images[rot];
+	if (cached)
+		return cached;
 
 	int xstride = 1;
 	int ystride = size.X;
@@ -161,30 +199,87 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 			i_step_z = zstride;
 	}
 
-	s16 y_map = p.Y;
+	auto image = std::make_shared<BlitImage>();
+	image->size = v3s16(sx, sy, sz);
+	u32 nodecount = (u32)sx * sy * sz;
+	image->nodes.reserve(nodecount);
+	image->probs.reserve(nodecount);
+
+	for (s16 z = 0; z != sz; z++)
 	for (s16 y = 0; y != sy; y++) {
+		u32 i = z * i_step_z + y * ystride + i_start;
+		for (s16 x = 0; x != sx; x++, i += i_step_x) {
+			MapNode n = schemdata[i];
+			image->probs.push_back(n.getContent() == CONTENT_IGNORE ?
+				APRSCHEM_PROB_NEVER : n.param1);
+
+			n.param1 = 0;
+			if (rot)
+				n.rotateAlongYAxis(m_ndef, rot);
+			image->nodes.push_back(n);
+		}
+	}
+
+	cached = image;
+	return cached;
+}
+
+
+void Schematic::clearBlitImages()
+{
+	if (m_shared) {
+		// Copy on write
+		u32 nodecount = size.X * size.Y * size.Z;
+		MapNode *data = new MapNode[nodecount];
+		memcpy(data, schemdata, sizeof(MapNode) * nodecount);
+		u8 *probs = new u8[size.Y];
+		memcpy(probs, slice_probs, sizeof(u8) * size.Y);
+		m_shared.reset();
+		schemdata = data;
+		slice_probs = probs;
+	}
+
+	// The old cache may still be used by clones
+	m_blit_cache = std::make_shared<BlitImageCache>();
+}
+
+
+void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+{
+	assert(schemdata && slice_probs);
+	sanity_check(m_ndef != NULL);
+
+	std::shared_ptr<const BlitImage> image = getBlitImage(rot);
+	const v3s16 s = image->size;
+	const VoxelArea &area = vm->m_area;
+
+	// Part of each row inside the voxelmanip
+	s16 x_min = MYMAX(0, area.MinEdge.X - p.X);
+	s16 x_max = MYMIN(s.X - 1, area.MaxEdge.X - p.X);
+
+	s16 y_map = p.Y;
+	for (s16 y = 0; y != s.Y; y++, y_map++) {
 		if ((slice_probs[y] != APRSCHEM_PROB_ALWAYS) &&
 			(slice_probs[y] <= myrand_range(1, APRSCHEM_PROB_ALWAYS)))
 			continue;
 
-		for (s16 z = 0; z != sz; z++) {
-			u32 i = z * i_step_z + y * ystride + i_start;
-			for (s16 x = 0; x != sx; x++, i += i_step_x) {
-				v3s16 pos(p.X + x, y_map, p.Z + z);
-				if (!vm->m_area.contains(pos))
-					continue;
-
-				if (schemdata[i].getContent() == CONTENT_IGNORE)
-					continue;
+		if (x_min > x_max || y_map < area.MinEdge.Y || y_map > area.MaxEdge.Y)
+			continue;
 
-				u8 placement_prob     = schemdata[i].param1 & APRSCHEM_PROB_MASK;
-				bool force_place_node = schemdata[i].param1 & APRSCHEM_FORCE_PLACE;
+		for (s16 z = 0; z != s.Z; z++) {
+			s16 z_map = p.Z + z;
+			if (z_map < area.MinEdge.Z || z_map > area.MaxEdge.Z)
+				continue;
 
+			u32 i = ((u32)z * s.Y + y) * s.X + x_min;
+			u32 vi = area.index(p.X + x_min, y_map, z_map);
+			for (s16 x = x_min; x <= x_max; x++, i++, vi++) {
+				u8 param1 = image->probs[i];
+				u8 placement_prob = param1 & APRSCHEM_PROB_MASK;
 				if (placement_prob == APRSCHEM_PROB_NEVER)
 					continue;
 
-				u32 vi = vm->m_area.index(pos);
-				if (!force_place && !force_place_node) {
+				if (!force_place && !(param1 & APRSCHEM_FORCE_PLACE)) {
 					content_t c = vm->m_data[vi].getContent();
 					if (c != CONTENT_AIR && c != CONTENT_IGNORE)
 						continue;
@@ -194,14 +289,9 @@ void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_pla
 					(placement_prob <= myrand_range(1, APRSCHEM_PROB_ALWAYS)))
 					continue;
 
-				vm->m_data[vi] = schemdata[i];
-				vm->m_data[vi].param1 = 0;
-
-				if (rot)
-					vm->m_data[vi].rotateAlongYAxis(m_ndef, rot);
+				vm->m_data[vi] = image->nodes[i];
 			}
 		}
-		y_map++;
 	}
 }
 
@@ -283,6 +373,9 @@ void Schematic::placeOnMap(ServerMap *map, v3s16 p, u32 flags,
 
 bool Schematic::deserializeFromMts(std::istream *is)
 {
+	freeData();
+	clearBlitImages();
+
 	std::istream &ss = *is;
 	content_t cignore = CONTENT_IGNORE;
 	bool have_cignore = false;
@@ -307,7 +400,6 @@ bool Schematic::deserializeFromMts(std::istream *is)
 	size = readV3S16(ss);
 
 	//// Read Y-slice probability values
-	delete []slice_probs;
 	slice_probs = new u8[size.Y];
 	for (int y = 0; y != size.Y; y++)
 		slice_probs[y] = (version >= 3) ? readU8(ss) : APRSCHEM_PROB_ALWAYS_OLD;
@@ -336,7 +428,6 @@ bool Schematic::deserializeFromMts(std::istream *is)
 	//// Read node data
 	size_t nodecount = size.X * size.Y * size.Z;
 
-	delete []schemdata;
 	schemdata = new MapNode[nodecount];
 
 	std::stringstream d_ss(std::ios_base::binary | std::ios_base::in | std::ios_base::out);
@@ -394,6 +485,85 @@ bool Schematic::serializeToMts(std::ostream *os) const
 }
 
 
+bool Schematic::deserializeFromCache(std::istream *is, u64 file_hash,
+	u32 file_size)
+{
+	std::istream &ss = *is;
+
+	if (readU32(ss) != APRSCHEM_CACHE_SIGNATURE ||
+			readU16(ss) != APRSCHEM_CACHE_VER ||
+			readU64(ss) != file_hash || readU32(ss) != file_size)
+		return false;
+
+	v3s16 cached_size = readV3S16(ss);
+	if (cached_size.X <= 0 || cached_size.Y <= 0 || cached_size.Z <= 0)
+		return false;
+	size_t nodecount = (size_t)cached_size.X * cached_size.Y * cached_size.Z;
+
+	std::unique_ptr<u8[]> probs(new u8[cached_size.Y]);
+	ss.read((char *)probs.get(), cached_size.Y);
+
+	std::vector<std::string> nodenames;
+	try {
+		u16 nidmapcount = readU16(ss);
+		for (int i = 0; i != nidmapcount; i++)
+			nodenames.push_back(deSerializeString16(ss));
+	} catch (SerializationError &e) {
+		return false;
+	}
+
+	// Written on a machine with a different byte order
+	u32 byte_order = 0;
+	ss.read((char *)&byte_order, sizeof(byte_order));
+	if (byte_order != 0x01020304)
+		return false;
+
+	std::unique_ptr<MapNode[]> data(new MapNode[nodecount]);
+	ss.read((char *)data.get(), sizeof(MapNode) * nodecount);
+	if (!ss.good())
+		return false;
+
+	freeData();
+	clearBlitImages();
+	size = cached_size;
+	slice_probs = probs.release();
+	schemdata = data.release();
+
+	NodeResolver::reset();
+	m_nodenames = std::move(nodenames);
+	m_nnlistsizes.push_back(m_nodenames.size());
+
+	return true;
+}
+
+
+bool Schematic::serializeToCache(std::ostream *os, u64 file_hash,
+	u32 file_size) const
+{
+	// Like serializeToMts(), nodes must not be resolved
+	std::ostream &ss = *os;
+
+	writeU32(ss, APRSCHEM_CACHE_SIGNATURE);
+	writeU16(ss, APRSCHEM_CACHE_VER);
+	writeU64(ss, file_hash);
+	writeU32(ss, file_size);
+	writeV3S16(ss, size);
+
+	ss.write((const char *)slice_probs, size.Y);
+
+	writeU16(ss, m_nodenames.size());
+	for (const std::string &name : m_nodenames)
+		ss << serializeString16(name);
+
+	const u32 byte_order = 0x01020304;
+	ss.write((const char *)&byte_order, sizeof(byte_order));
+	ss.write((const char *)schemdata,
+		sizeof(MapNode) * size.X * size.Y * size.Z);
+
+	return ss.good();
+}
+
+
 bool Schematic::serializeToLua(std::ostream *os, bool use_comments,
 	u32 indent_spaces) const
 {
@@ -484,18 +654,55 @@ bool Schematic::serializeToLua(std::ostream *os, bool use_comments,
 }
 
 
+static std::string get_cache_path(u64 file_hash)
+{
+	if (!g_settings->getBool("schematic_cache"))
+		return "";
+
+	u8 name[8];
+	writeU64(name, file_hash);
+	return porting::path_cache + DIR_DELIM "schematics" DIR_DELIM +
+		hex_encode((const char *)name, sizeof(name)) + ".aprc";
+}
+
+
 bool Schematic::loadSchematicFromFile(const std::string &filename,
 	const NodeDefManager *ndef, StringMap *replace_names)
 {
-	auto is = open_ifstream(filename.c_str(), true);
-	if (!is.good())
+	std::string file;
+	if (!fs::ReadFile(filename, file, true))
 		return false;
 
 	if (!m_ndef)
 		m_ndef = ndef;
 
-	if (!deserializeFromMts(&is))
-		return false;
+	// Decoding the file is slow for large schematics, the cache is
+	// named after its contents so it can't get out of date
+	const u32 file_size = file.size();
+	const u64 file_hash = murmur_hash_64_ua(file.data(), file.size(), 0);
+	const std::string cache_path = get_cache_path(file_hash);
+
+	bool cached = false;
+	if (!cache_path.empty()) {
+		auto is = open_ifstream(cache_path.c_str(), false);
+		cached = is.good() && deserializeFromCache(&is, file_hash, file_size);
+	}
+
+	if (!cached) {
+		std::istringstream is(std::move(file), std::ios_base::binary);
+		if (!deserializeFromMts(&is))
+			return false;
+
+		if (!cache_path.empty()) {
+			std::ostringstream os(std::ios_base::binary);
+			if (!serializeToCache(&os, file_hash, file_size) ||
+					!fs::CreateAllDirs(fs::RemoveLastPathComponent(cache_path)) ||
+					!fs::safeWriteToFile(cache_path, os.str())) {
+				warningstream << "Failed to write schematic cache file "
+					<< cache_path << '\n';
+			}
+		}
+	}
 
 	name = filename;
 
@@ -547,6 +754,9 @@ bool Schematic::saveSchematicToFile(const std::string &filename,
 
 bool Schematic::getSchematicFromMap(Map *map, v3s16 p1, v3s16 p2)
 {
+	freeData();
+	clearBlitImages();
+
 	MMVManip *vm = new MMVManip(map);
 
 	v3s16 bp1 = getNodeBlockPos(p1);
@@ -584,6 +794,8 @@ void Schematic::applyProbabilities(v3s16 p0,
 	std::vector<std::pair<v3s16, u8> > *plist,
 	std::vector<std::pair<s16, u8> > *splist)
 {
+	clearBlitImages();
+
 	for (size_t i = 0; i != plist->size(); i++) {
 		v3s16 p = (*plist)[i].first - p0;
 		int index = p.Z * (size.Y * size.X) + p.Y * size.X + p.X;
@@ -610,6 +822,8 @@ void Schematic::condenseContentIds()
 	std::unordered_map<content_t, content_t> nodeidmap;
 	content_t numids = 0;
 
+	clearBlitImages();
+
 	// Reset node resolve fields
 	NodeResolver::reset();
 
@@ -21,6 +21,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include "mg_decoration.h"
 #include "util/string.h"
 
@@ -66,6 +68,33 @@ class Server;
 	4 - Compressed range of node occurrence prob., added per-node force placement bit
 */
 
+/*
+	AperosEngine Schematic Cache File Format
+
+	Written to the cache directory when a schematic file is loaded, named after
+	a hash of the file. Holds the same data as the file with the version fixes
+	applied, with the node data uncompressed so that it is read in one go.
+
+	Values in big-endian byte order, except for the node data.
+	[u32] signature: 'APRC'
+	[u16] version: 1
+	[u64] hash of the schematic file
+	[u32] size of the schematic file
+	[u16] size X
+	[u16] size Y
+	[u16] size Z
+	For each Y:
+		[u8] slice probability value
+	[Name-ID table] Name ID Mapping Table
+		[u16] name-id count
+		For each name-id mapping:
+			[u16] name length
+			[u8[]] name
+	[u32] 0x01020304 in host byte order
+	For each node in schematic:  (for z, y, x)
+		[MapNode] content, param1 and param2 as stored in memory
+*/
+
 //// Schematic constants
 #define APRSCHEM_FILE_SIGNATURE 0x4d54534d // 'APRSM'
 #define APRSCHEM_FILE_VER_HIGHEST_READ  4
@@ -80,6 +109,9 @@ class Server;
 
 #define APRSCHEM_FORCE_PLACE     0x80
 
+#define APRSCHEM_CACHE_SIGNATURE 0x41505243 // 'APRC'
+#define APRSCHEM_CACHE_VER       1
+
 enum SchematicType
 {
 	SCHEMATIC_NORMAL,
@@ -108,6 +140,9 @@ class Schematic : public ObjDef, public NodeResolver {
 
 	bool deserializeFromMts(std::istream *is);
 	bool serializeToMts(std::ostream *os) const;
+	// The cache file of a schematic file with the given hash and size
+	bool deserializeFromCache(std::istream *is, u64 file_hash, u32 file_size);
+	bool serializeToCache(std::ostream *os, u64 file_hash, u32 file_size) const;
 	bool serializeToLua(std::ostream *os, bool use_comments, u32 indent_spaces) const;
 
 	void blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place);
@@ -121,12 +156,51 @@ class Schematic : public ObjDef, public NodeResolver {
 	std::vector<content_t> c_nodes;
 	u32 flags = 0;
 	v3s16 size;
+	// Read-only once the schematic has been cloned
 	MapNode *schemdata = nullptr;
 	u8 *slice_probs = nullptr;
 
 private:
+	// schemdata prepared for blitToVManip() with one rotation
+	struct BlitImage {
+		// Extent of the rotated schematic
+		v3s16 size;
+		// Rotated nodes in placement order (Z, Y, X), param1 cleared
+		std::vector<MapNode> nodes;
+		// Original param1: placement probability and force placement bit,
+		// APRSCHEM_PROB_NEVER for CONTENT_IGNORE
+		std::vector<u8> probs;
+	};
+
+	struct BlitImageCache {
+		std::mutex mutex;
+		// Built on first use, by rotation
+		std::shared_ptr<const BlitImage> images[4];
+	};
+
+	// schemdata and slice_probs of a schematic and its clones
+	struct SharedData {
+		MapNode *schemdata;
+		u8 *slice_probs;
+		u32 nodecount;
+
+		~SharedData();
+	};
+
 	// Counterpart to the node resolver: Condense content_t to a sequential "m_nodenames" list
 	void condenseContentIds();
+
+	std::shared_ptr<const BlitImage> getBlitImage(Rotation rot);
+	// Must be called whenever schemdata changes, gives this schematic its
+	// own copy of schemdata if it is shared
+	void clearBlitImages();
+	// Frees or releases schemdata and slice_probs
+	void freeData();
+
+	// Set once schemdata is shared with clones, owns it from then on
+	mutable std::shared_ptr<SharedData> m_shared;
+	mutable std::shared_ptr<BlitImageCache> m_blit_cache =
+		std::make_shared<BlitImageCache>();
 };
 
 class SchematicManager : public ObjDefManager {
@@ -0,0 +1,78 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "mg_stage_profiler.h"
+#include "porting.h"
+#include "profiler.h"
+
+static_assert(ARRLEN(mapgenStageStrs) == MGSTAGE_COUNT, "enum size mismatches");
+
+// Upper bounds in seconds, mapchunks usually take some milliseconds per stage
+static const std::vector<double> stage_buckets = {
+	0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+	0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5,
+};
+
+MapgenStageProfiler::MapgenStageProfiler(MetricsBackend *mb)
+{
+	for (int i = 0; i < MGSTAGE_COUNT; i++) {
+		m_profiler_names[i] = std::string("Mapgen: stage ") +
+			mapgenStageStrs[i] + " [ms]";
+		if (!mb)
+			continue;
+		std::string help_str("Time taken by the mapgen stage ");
+		help_str.append(mapgenStageStrs[i]).append(" per mapchunk");
+		m_histograms[i] = mb->addHistogram(
+			"minetest_mapgen_stage_seconds", help_str, stage_buckets,
+			{{"stage", mapgenStageStrs[i]}}
+		);
+	}
+}
+
+void MapgenStageProfiler::record(MapgenStage stage, u64 time_us)
+{
+	g_profiler->avg(m_profiler_names[stage], time_us / 1000.0f);
+	if (m_histograms[stage])
+		m_histograms[stage]->observe(time_us / 1000000.0);
+}
+
+bool MapgenStageProfiler::getStats(MapgenStage stage, u64 *count,
+	double *seconds) const
+{
+	if (!m_histograms[stage])
+		return false;
+	*count = m_histograms[stage]->getCount();
+	*seconds = m_histograms[stage]->getSum();
+	return true;
+}
+
+MapgenStageTimer::~MapgenStageTimer()
+{
+	stop();
+	if (!m_profiler)
+		return;
+	for (int i = 0; i < MGSTAGE_COUNT; i++) {
+		if (m_entered[i])
+			m_profiler->record((MapgenStage)i, m_time_us[i]);
+	}
+}
+
+void MapgenStageTimer::start(MapgenStage stage)
+{
+	if (!m_profiler)
+		return;
+	u64 now = porting::getTimeUs();
+	if (m_stage != MGSTAGE_COUNT)
+		m_time_us[m_stage] += now - m_start_us;
+	m_stage = stage;
+	m_entered[stage] = true;
+	m_start_us = now;
+}
+
+void MapgenStageTimer::stop()
+{
+	if (m_stage == MGSTAGE_COUNT)
+		return;
+	m_time_us[m_stage] += porting::getTimeUs() - m_start_us;
+	m_stage = MGSTAGE_COUNT;
+}
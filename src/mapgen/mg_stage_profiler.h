@@ -0,0 +1,91 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include <string>
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+#include "util/metricsbackend.h"
+
+// Stages of generating a mapchunk, in the usual order
+enum MapgenStage {
+	MGSTAGE_NOISE,
+	MGSTAGE_TERRAIN,
+	MGSTAGE_BIOMES,
+	MGSTAGE_CAVES,
+	MGSTAGE_DUNGEONS,
+	MGSTAGE_ORES,
+	MGSTAGE_DECORATIONS,
+	MGSTAGE_LIQUID,
+	MGSTAGE_LIGHTING,
+	// Lua callbacks in the mapgen environment
+	MGSTAGE_LUA_MAPGEN,
+	// Lua callbacks in the server environment
+	MGSTAGE_LUA_SERVER,
+	MGSTAGE_COUNT,
+};
+
+constexpr const char *mapgenStageStrs[] = {
+	"noise",
+	"terrain",
+	"biomes",
+	"caves",
+	"dungeons",
+	"ores",
+	"decorations",
+	"liquid",
+	"lighting",
+	"lua_mapgen_env",
+	"lua_on_generated",
+};
+
+/**
+ * Collects the time spent in each stage of generating a mapchunk.
+ *
+ * Each stage is a histogram of the metric minetest_mapgen_stage_seconds
+ * and an average in the profiler. Shared by all emerge threads, thread-safe.
+ */
+class MapgenStageProfiler
+{
+public:
+	/// @param mb registers the histograms if not null
+	MapgenStageProfiler(MetricsBackend *mb);
+
+	DISABLE_CLASS_COPY(MapgenStageProfiler)
+
+	// Adds the time a stage took for one mapchunk
+	void record(MapgenStage stage, u64 time_us);
+
+	// Number of mapchunks and total time of a stage, if histograms exist
+	bool getStats(MapgenStage stage, u64 *count, double *seconds) const;
+
+private:
+	MetricHistogramPtr m_histograms[MGSTAGE_COUNT];
+	std::string m_profiler_names[MGSTAGE_COUNT];
+};
+
+/**
+ * Times the stages of one mapchunk. Starting a stage ends the previous one,
+ * a stage can be entered more than once. Each stage is recorded once when
+ * the timer is destroyed, time outside of stages is not recorded.
+ */
+class MapgenStageTimer
+{
+public:
+	/// @param profiler does nothing if null
+	MapgenStageTimer(MapgenStageProfiler *profiler) : m_profiler(profiler) {}
+	~MapgenStageTimer();
+
+	DISABLE_CLASS_COPY(MapgenStageTimer)
+
+	void start(MapgenStage stage);
+	void stop();
+
+private:
+	MapgenStageProfiler *m_profiler;
+	MapgenStage m_stage = MGSTAGE_COUNT;
+	u64 m_start_us = 0;
+	u64 m_time_us[MGSTAGE_COUNT] = {};
+	bool m_entered[MGSTAGE_COUNT] = {};
+};
@@ -19,7 +19,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
-#include <stack>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "treegen.h"
 #include "irr_v3d.h"
 #include "util/pointer.h"
@@ -28,6 +31,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapblock.h"
 #include "noise.h"
 #include "voxelalgorithms.h"
+#include "threading/mutex_auto_lock.h"
 
 namespace treegen
 {
@@ -168,129 +172,189 @@ treegen::error spawn_ltree(ServerMap *map, v3s16 p0,
 }
 
 
-treegen::error make_ltree(MMVManip &vmanip, v3s16 p0,
-	const TreeDef &tree_definition)
+/*
+	The axiom of an L-system tree, expanded and turned into turtle steps.
+	Only the positions are left to the turtle: they add up from the
+	position of the tree in floats, so they can't be precomputed without
+	changing the trees.
+*/
+struct TurtleOp {
+	enum Type : u8 {
+		MOVE,           // Move the turtle by dir
+		TRUNK,          // Trunk node at the turtle
+		TRUNK_DOUBLE,   // The 3 other trunk nodes of a double trunk
+		TRUNK_CROSSED,  // The 4 other trunk nodes of a crossed trunk
+		LEAVES_AROUND,  // Leaves around a branch
+		LEAVES,         // Single leaves node
+		FRUIT,
+		PUSH,           // Save the position
+		POP,            // Restore the position
+	};
+
+	Type type;
+	v3f dir;
+};
+
+struct TurtleProgram {
+	std::vector<TurtleOp> ops;
+	// Stops the tree after the ops
+	treegen::error error = SUCCESS;
+};
+
+// Everything a TurtleProgram depends on apart from random rules
+struct TurtleKey {
+	std::string initial_axiom;
+	std::string rules_a;
+	std::string rules_b;
+	std::string rules_c;
+	std::string rules_d;
+	std::string trunk_type;
+	int angle;
+	bool thin_branches;
+	s16 iterations;
+	s16 angle_offset;
+
+	bool operator==(const TurtleKey &other) const
+	{
+		return initial_axiom == other.initial_axiom &&
+			rules_a == other.rules_a && rules_b == other.rules_b &&
+			rules_c == other.rules_c && rules_d == other.rules_d &&
+			trunk_type == other.trunk_type && angle == other.angle &&
+			thin_branches == other.thin_branches &&
+			iterations == other.iterations &&
+			angle_offset == other.angle_offset;
+	}
+};
+
+struct TurtleKeyHash {
+	size_t operator()(const TurtleKey &key) const
+	{
+		std::hash<std::string> hs;
+		size_t h = hs(key.initial_axiom);
+		for (const std::string *str : {&key.rules_a, &key.rules_b,
+				&key.rules_c, &key.rules_d, &key.trunk_type})
+			h = h * 31 + hs(*str);
+		h = h * 31 + key.angle;
+		h = h * 31 + key.thin_branches;
+		h = h * 31 + key.iterations;
+		h = h * 31 + key.angle_offset;
+		return h;
+	}
+};
+
+/*
+	Trees without random rules always expand to the same axiom, their
+	programs are shared by all trees, decorations and emerge threads
+*/
+class TurtleCache {
+public:
+	std::shared_ptr<const TurtleProgram> get(const TurtleKey &key)
+	{
+		MutexAutoLock lock(m_mutex);
+		auto it = m_programs.find(key);
+		return it == m_programs.end() ? nullptr : it->second;
+	}
+
+	void put(const TurtleKey &key, std::shared_ptr<const TurtleProgram> program)
+	{
+		MutexAutoLock lock(m_mutex);
+		// Mods don't have that many trees, start over if they do
+		if (m_ops + program->ops.size() > MAX_OPS) {
+			m_programs.clear();
+			m_ops = 0;
+		}
+		m_ops += program->ops.size();
+		m_programs[key] = std::move(program);
+	}
+
+private:
+	static constexpr size_t MAX_OPS = 1 << 20;
+
+	std::mutex m_mutex;
+	std::unordered_map<TurtleKey, std::shared_ptr<const TurtleProgram>,
+		TurtleKeyHash> m_programs;
+	size_t m_ops = 0;
+};
+
+
+// The loops over the axiom used s16 indexes, this keeps the trees of
+// axioms longer than that
+static size_t axiom_length(const std::string &axiom)
 {
-	s32 seed;
-	if (tree_definition.explicit_seed)
-		seed = tree_definition.seed + 14002;
-	else
-		seed = p0.X * 2 + p0.Y * 4 + p0.Z;  // use the tree position to seed PRNG
-	PseudoRandom ps(seed);
+	return MYMAX((s16)axiom.size(), 0);
+}
 
+
+static bool has_random_rules(const TreeDef &def)
+{
+	for (const std::string *str : {&def.initial_axiom, &def.rules_a,
+			&def.rules_b, &def.rules_c, &def.rules_d}) {
+		if (str->find_first_of("abcd") != std::string::npos)
+			return true;
+	}
+	return false;
+}
+
+
+static std::string expand_axiom(const TreeDef &def, s16 iterations,
+	PseudoRandom &ps)
+{
 	// chance of inserting abcd rules
 	constexpr float prop_a = 9;
 	constexpr float prop_b = 8;
 	constexpr float prop_c = 7;
 	constexpr float prop_d = 6;
 
-	//randomize tree growth level, minimum=2
-	s16 iterations = tree_definition.iterations;
-	if (tree_definition.iterations_random_level > 0)
-		iterations -= ps.range(0, tree_definition.iterations_random_level);
-	if (iterations < 2)
-		iterations = 2;
-
-	constexpr s16 MAX_ANGLE_OFFSET = 5;
-	float angle_in_radians = tree_definition.angle * M_PI / 180;
-	float angleOffset_in_radians = (s16)(ps.range(0, 1) % MAX_ANGLE_OFFSET) * M_PI / 180;
-
-	//initialize rotation matrix, position and stacks for branches
-	core::matrix4 rotation;
-	setRotationAxisRadians(rotation, M_PI / 2, v3f(0, 0, 1));
-	v3f position;
-	position.X = p0.X;
-	position.Y = p0.Y;
-	position.Z = p0.Z;
-	std::stack <core::matrix4> stack_orientation;
-	std::stack <v3f> stack_position;
-
-	//generate axiom
-	std::string axiom = tree_definition.initial_axiom;
+	std::string axiom = def.initial_axiom;
+	std::string temp;
 	for (s16 i = 0; i < iterations; i++) {
-		std::string temp;
-		for (s16 j = 0; j < (s16)axiom.size(); j++) {
-			char axiom_char = axiom.at(j);
+		temp.clear();
+		size_t length = axiom_length(axiom);
+		for (size_t j = 0; j < length; j++) {
+			char axiom_char = axiom[j];
 			switch (axiom_char) {
 			case 'A':
-				temp += tree_definition.rules_a;
+				temp += def.rules_a;
 				break;
 			case 'B':
-				temp += tree_definition.rules_b;
+				temp += def.rules_b;
 				break;
 			case 'C':
-				temp += tree_definition.rules_c;
+				temp += def.rules_c;
 				break;
 			case 'D':
-				temp += tree_definition.rules_d;
+				temp += def.rules_d;
 				break;
 			case 'a':
 				if (prop_a >= ps.range(1, 10))
-					temp += tree_definition.rules_a;
+					temp += def.rules_a;
 				break;
 			case 'b':
 				if (prop_b >= ps.range(1, 10))
-					temp += tree_definition.rules_b;
+					temp += def.rules_b;
 				break;
 			case 'c':
 				if (prop_c >= ps.range(1, 10))
-					temp += tree_definition.rules_c;
+					temp += def.rules_c;
 				break;
 			case 'd':
 				if (prop_d >= ps.range(1, 10))
-					temp += tree_definition.rules_d;
+					temp += def.rules_d;
 				break;
 			default:
 				temp += axiom_char;
 				break;
 			}
 		}
-		axiom = temp;
+		axiom.swap(temp);
 	}
+	return axiom;
+}
 
-	// Add trunk nodes below a wide trunk to avoid gaps when tree is on sloping ground
-	if (tree_definition.trunk_type == "double") {
-		tree_trunk_placement(
-			vmanip,
-			v3f(position.X + 1, position.Y - 1, position.Z),
-			tree_definition
-		);
-		tree_trunk_placement(
-			vmanip,
-			v3f(position.X, position.Y - 1, position.Z + 1),
-			tree_definition
-		);
-		tree_trunk_placement(
-			vmanip,
-			v3f(position.X + 1, position.Y - 1, position.Z + 1),
-			tree_definition
-		);
-	} else if (tree_definition.trunk_type == "crossed") {
-		tree_trunk_placement(
-			vmanip,
-			v3f(position.X + 1, position.Y - 1, position.Z),
-			tree_definition
-		);
-		tree_trunk_placement(
-			vmanip,
-			v3f(position.X - 1, position.Y - 1, position.Z),
-			tree_definition
-		);
-		tree_trunk_placement(
-			vmanip,
-			v3f(position.X, position.Y - 1, position.Z + 1),
-			tree_definition
-		);
-		tree_trunk_placement(
-			vmanip,
-			v3f(position.X, position.Y - 1, position.Z - 1),
-			tree_definition
-		);
-	}
 
-	/* build tree out of generated axiom
+/* build tree out of generated axiom
 
-	Key for Special L-System Symbols used in Axioms
+Key for Special L-System Symbols used in Axioms
 
     G  - move forward one unit with the pen up
     F  - move forward one unit with the pen down drawing trunks and branches
@@ -314,240 +378,254 @@ treegen::error make_ltree(MMVManip &vmanip, v3s16 p0,
     [  - save in stack current state info
     ]  - recover from stack state info
 
-    */
-
-	s16 x,y,z;
-	for (s16 i = 0; i < (s16)axiom.size(); i++) {
-		char axiom_char = axiom.at(i);
-		core::matrix4 temp_rotation;
-		temp_rotation.makeIdentity();
-		v3f dir;
-		switch (axiom_char) {
+*/
+static std::shared_ptr<TurtleProgram> compile_turtle(const TreeDef &def,
+	const std::string &axiom, s16 angle_offset)
+{
+	auto program = std::make_shared<TurtleProgram>();
+	std::vector<TurtleOp> &ops = program->ops;
+
+	float angle_in_radians = def.angle * M_PI / 180;
+	float angleOffset_in_radians = angle_offset * M_PI / 180;
+
+	// The same for every turn
+	core::matrix4 yaw_right, yaw_left, pitch_down, pitch_up, roll_right, roll_left;
+	setRotationAxisRadians(yaw_right,
+			angle_in_radians + angleOffset_in_radians, v3f(0, 0, 1));
+	setRotationAxisRadians(yaw_left,
+			angle_in_radians + angleOffset_in_radians, v3f(0, 0, -1));
+	setRotationAxisRadians(pitch_down,
+			angle_in_radians + angleOffset_in_radians, v3f(0, 1, 0));
+	setRotationAxisRadians(pitch_up,
+			angle_in_radians + angleOffset_in_radians, v3f(0, -1, 0));
+	setRotationAxisRadians(roll_left, angle_in_radians, v3f(1, 0, 0));
+	setRotationAxisRadians(roll_right, angle_in_radians, v3f(-1, 0, 0));
+
+	const bool is_double = def.trunk_type == "double";
+	const bool is_crossed = def.trunk_type == "crossed";
+
+	auto add_op = [&ops] (TurtleOp::Type type) {
+		ops.push_back(TurtleOp{type, v3f()});
+	};
+	auto add_wide_trunk = [&] (bool is_branch) {
+		if (is_branch && def.thin_branches)
+			return;
+		if (is_double)
+			add_op(TurtleOp::TRUNK_DOUBLE);
+		else if (is_crossed)
+			add_op(TurtleOp::TRUNK_CROSSED);
+	};
+
+	//initialize rotation matrix and stack for branches
+	core::matrix4 rotation;
+	setRotationAxisRadians(rotation, M_PI / 2, v3f(0, 0, 1));
+	std::vector<core::matrix4> stack_orientation;
+	auto add_move = [&] () {
+		ops.push_back(TurtleOp{TurtleOp::MOVE,
+			transposeMatrix(rotation, v3f(1, 0, 0))});
+	};
+
+	size_t length = axiom_length(axiom);
+	for (size_t i = 0; i < length; i++) {
+		switch (axiom[i]) {
 		case 'G':
-			dir = v3f(1, 0, 0);
-			dir = transposeMatrix(rotation, dir);
-			position += dir;
+			add_move();
 			break;
 		case 'T':
-			tree_trunk_placement(
-				vmanip,
-				v3f(position.X, position.Y, position.Z),
-				tree_definition
-			);
-			if (tree_definition.trunk_type == "double" &&
-					!tree_definition.thin_branches) {
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X + 1, position.Y, position.Z),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X, position.Y, position.Z + 1),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X + 1, position.Y, position.Z + 1),
-					tree_definition
-				);
-			} else if (tree_definition.trunk_type == "crossed" &&
-					!tree_definition.thin_branches) {
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X + 1, position.Y, position.Z),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X - 1, position.Y, position.Z),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X, position.Y, position.Z + 1),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X, position.Y, position.Z - 1),
-					tree_definition
-				);
-			}
-			dir = v3f(1, 0, 0);
-			dir = transposeMatrix(rotation, dir);
-			position += dir;
+			add_op(TurtleOp::TRUNK);
+			add_wide_trunk(true);
+			add_move();
 			break;
 		case 'F':
-			tree_trunk_placement(
-				vmanip,
-				v3f(position.X, position.Y, position.Z),
-				tree_definition
-			);
-			if ((stack_orientation.empty() &&
-					tree_definition.trunk_type == "double") ||
-					(!stack_orientation.empty() &&
-					tree_definition.trunk_type == "double" &&
-					!tree_definition.thin_branches)) {
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X + 1, position.Y, position.Z),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X, position.Y, position.Z + 1),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X + 1, position.Y, position.Z + 1),
-					tree_definition
-				);
-			} else if ((stack_orientation.empty() &&
-					tree_definition.trunk_type == "crossed") ||
-					(!stack_orientation.empty() &&
-					tree_definition.trunk_type == "crossed" &&
-					!tree_definition.thin_branches)) {
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X + 1, position.Y, position.Z),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X - 1, position.Y, position.Z),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X, position.Y, position.Z + 1),
-					tree_definition
-				);
-				tree_trunk_placement(
-					vmanip,
-					v3f(position.X, position.Y, position.Z - 1),
-					tree_definition
-				);
-			}
-			if (!stack_orientation.empty()) {
-				s16 size = 1;
-				for (x = -size; x <= size; x++)
-				for (y = -size; y <= size; y++)
-				for (z = -size; z <= size; z++) {
-					if (abs(x) == size &&
-							abs(y) == size &&
-							abs(z) == size) {
-						tree_leaves_placement(
-							vmanip,
-							v3f(position.X + x + 1, position.Y + y,
-									position.Z + z),
-							ps.next(),
-							tree_definition
-						);
-						tree_leaves_placement(
-							vmanip,
-							v3f(position.X + x - 1, position.Y + y,
-									position.Z + z),
-							ps.next(),
-							tree_definition
-						);
-						tree_leaves_placement(
-							vmanip,v3f(position.X + x, position.Y + y,
-									position.Z + z + 1),
-							ps.next(),
-							tree_definition
-						);
-						tree_leaves_placement(
-							vmanip,v3f(position.X + x, position.Y + y,
-									position.Z + z - 1),
-							ps.next(),
-							tree_definition
-						);
-					}
-				}
-			}
-			dir = v3f(1, 0, 0);
-			dir = transposeMatrix(rotation, dir);
-			position += dir;
+			add_op(TurtleOp::TRUNK);
+			add_wide_trunk(!stack_orientation.empty());
+			if (!stack_orientation.empty())
+				add_op(TurtleOp::LEAVES_AROUND);
+			add_move();
 			break;
 		case 'f':
-			tree_single_leaves_placement(
-				vmanip,
-				v3f(position.X, position.Y, position.Z),
-				ps.next(),
-				tree_definition
-			);
-			dir = v3f(1, 0, 0);
-			dir = transposeMatrix(rotation, dir);
-			position += dir;
+			add_op(TurtleOp::LEAVES);
+			add_move();
 			break;
 		case 'R':
-			tree_fruit_placement(
-				vmanip,
-				v3f(position.X, position.Y, position.Z),
-				tree_definition
-			);
-			dir = v3f(1, 0, 0);
-			dir = transposeMatrix(rotation, dir);
-			position += dir;
+			add_op(TurtleOp::FRUIT);
+			add_move();
 			break;
 
 		// turtle orientation commands
 		case '[':
-			stack_orientation.push(rotation);
-			stack_position.push(position);
+			stack_orientation.push_back(rotation);
+			add_op(TurtleOp::PUSH);
 			break;
 		case ']':
-			if (stack_orientation.empty())
-				return UNBALANCED_BRACKETS;
-			rotation = stack_orientation.top();
-			stack_orientation.pop();
-			position = stack_position.top();
-			stack_position.pop();
+			if (stack_orientation.empty()) {
+				program->error = UNBALANCED_BRACKETS;
+				return program;
+			}
+			rotation = stack_orientation.back();
+			stack_orientation.pop_back();
+			add_op(TurtleOp::POP);
 			break;
 		case '+':
-			temp_rotation.makeIdentity();
-			setRotationAxisRadians(temp_rotation,
-					angle_in_radians + angleOffset_in_radians, v3f(0, 0, 1));
-			rotation *= temp_rotation;
+			rotation *= yaw_right;
 			break;
 		case '-':
-			temp_rotation.makeIdentity();
-			setRotationAxisRadians(temp_rotation,
-					angle_in_radians + angleOffset_in_radians, v3f(0, 0, -1));
-			rotation *= temp_rotation;
+			rotation *= yaw_left;
 			break;
 		case '&':
-			temp_rotation.makeIdentity();
-			setRotationAxisRadians(temp_rotation,
-					angle_in_radians + angleOffset_in_radians, v3f(0, 1, 0));
-			rotation *= temp_rotation;
+			rotation *= pitch_down;
 			break;
 		case '^':
-			temp_rotation.makeIdentity();
-			setRotationAxisRadians(temp_rotation,
-					angle_in_radians + angleOffset_in_radians, v3f(0, -1, 0));
-			rotation *= temp_rotation;
+			rotation *= pitch_up;
 			break;
 		case '*':
-			temp_rotation.makeIdentity();
-			setRotationAxisRadians(temp_rotation,
-					angle_in_radians, v3f(1, 0, 0));
-			rotation *= temp_rotation;
+			rotation *= roll_left;
 			break;
 		case '/':
-			temp_rotation.makeIdentity();
-			setRotationAxisRadians(temp_rotation,
-					angle_in_radians, v3f(-1, 0, 0));
-			rotation *= temp_rotation;
+			rotation *= roll_right;
 			break;
 		default:
 			break;
 		}
 	}
 
-	return SUCCESS;
+	ops.shrink_to_fit();
+	return program;
+}
+
+
+// The other trunk nodes of a double or crossed trunk at p
+static void tree_wide_trunk_placement(MMVManip &vmanip, v3f p,
+	TurtleOp::Type type, const TreeDef &tree_definition)
+{
+	if (type == TurtleOp::TRUNK_DOUBLE) {
+		tree_trunk_placement(vmanip, v3f(p.X + 1, p.Y, p.Z), tree_definition);
+		tree_trunk_placement(vmanip, v3f(p.X, p.Y, p.Z + 1), tree_definition);
+		tree_trunk_placement(vmanip, v3f(p.X + 1, p.Y, p.Z + 1), tree_definition);
+	} else {
+		tree_trunk_placement(vmanip, v3f(p.X + 1, p.Y, p.Z), tree_definition);
+		tree_trunk_placement(vmanip, v3f(p.X - 1, p.Y, p.Z), tree_definition);
+		tree_trunk_placement(vmanip, v3f(p.X, p.Y, p.Z + 1), tree_definition);
+		tree_trunk_placement(vmanip, v3f(p.X, p.Y, p.Z - 1), tree_definition);
+	}
+}
+
+
+static treegen::error run_turtle(MMVManip &vmanip, v3s16 p0,
+	const TurtleProgram &program, PseudoRandom &ps,
+	const TreeDef &tree_definition)
+{
+	v3f position;
+	position.X = p0.X;
+	position.Y = p0.Y;
+	position.Z = p0.Z;
+	std::vector<v3f> stack_position;
+
+	for (const TurtleOp &op : program.ops) {
+		switch (op.type) {
+		case TurtleOp::MOVE:
+			position += op.dir;
+			break;
+		case TurtleOp::TRUNK:
+			tree_trunk_placement(vmanip, position, tree_definition);
+			break;
+		case TurtleOp::TRUNK_DOUBLE:
+		case TurtleOp::TRUNK_CROSSED:
+			tree_wide_trunk_placement(vmanip, position, op.type, tree_definition);
+			break;
+		case TurtleOp::LEAVES_AROUND: {
+			s16 size = 1;
+			for (s16 x = -size; x <= size; x++)
+			for (s16 y = -size; y <= size; y++)
+			for (s16 z = -size; z <= size; z++) {
+				if (abs(x) == size && abs(y) == size && abs(z) == size) {
+					tree_leaves_placement(vmanip,
+						v3f(position.X + x + 1, position.Y + y, position.Z + z),
+						ps.next(), tree_definition);
+					tree_leaves_placement(vmanip,
+						v3f(position.X + x - 1, position.Y + y, position.Z + z),
+						ps.next(), tree_definition);
+					tree_leaves_placement(vmanip,
+						v3f(position.X + x, position.Y + y, position.Z + z + 1),
+						ps.next(), tree_definition);
+					tree_leaves_placement(vmanip,
+						v3f(position.X + x, position.Y + y, position.Z + z - 1),
+						ps.next(), tree_definition);
+				}
+			}
+			break;
+		}
+		case TurtleOp::LEAVES:
+			tree_single_leaves_placement(vmanip, position, ps.next(),
+				tree_definition);
+			break;
+		case TurtleOp::FRUIT:
+			tree_fruit_placement(vmanip, position, tree_definition);
+			break;
+		case TurtleOp::PUSH:
+			stack_position.push_back(position);
+			break;
+		case TurtleOp::POP:
+			position = stack_position.back();
+			stack_position.pop_back();
+			break;
+		}
+	}
+
+	return program.error;
+}
+
+
+treegen::error make_ltree(MMVManip &vmanip, v3s16 p0,
+	const TreeDef &tree_definition)
+{
+	s32 seed;
+	if (tree_definition.explicit_seed)
+		seed = tree_definition.seed + 14002;
+	else
+		seed = p0.X * 2 + p0.Y * 4 + p0.Z;  // use the tree position to seed PRNG
+	PseudoRandom ps(seed);
+
+	//randomize tree growth level, minimum=2
+	s16 iterations = tree_definition.iterations;
+	if (tree_definition.iterations_random_level > 0)
+		iterations -= ps.range(0, tree_definition.iterations_random_level);
+	if (iterations < 2)
+		iterations = 2;
+
+	constexpr s16 MAX_ANGLE_OFFSET = 5;
+	s16 angle_offset = (s16)(ps.range(0, 1) % MAX_ANGLE_OFFSET);
+
+	//generate axiom and turn it into turtle steps
+	std::shared_ptr<const TurtleProgram> program;
+	if (has_random_rules(tree_definition)) {
+		std::string axiom = expand_axiom(tree_definition, iterations, ps);
+		program = compile_turtle(tree_definition, axiom, angle_offset);
+	} else {
+		static TurtleCache cache;
+		TurtleKey key{tree_definition.initial_axiom, tree_definition.rules_a,
+			tree_definition.rules_b, tree_definition.rules_c,
+			tree_definition.rules_d, tree_definition.trunk_type,
+			tree_definition.angle, tree_definition.thin_branches, iterations,
+			angle_offset};
+		program = cache.get(key);
+		if (!program) {
+			std::string axiom = expand_axiom(tree_definition, iterations, ps);
+			program = compile_turtle(tree_definition, axiom, angle_offset);
+			cache.put(key, program);
+		}
+	}
+
+	// Add trunk nodes below a wide trunk to avoid gaps when tree is on sloping ground
+	if (tree_definition.trunk_type == "double") {
+		tree_wide_trunk_placement(vmanip, v3f(p0.X, p0.Y - 1, p0.Z),
+			TurtleOp::TRUNK_DOUBLE, tree_definition);
+	} else if (tree_definition.trunk_type == "crossed") {
+		tree_wide_trunk_placement(vmanip, v3f(p0.X, p0.Y - 1, p0.Z),
+			TurtleOp::TRUNK_CROSSED, tree_definition);
+	}
+
+	return run_turtle(vmanip, p0, *program, ps, tree_definition);
 }
 
 
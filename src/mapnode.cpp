@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/numeric.h"
 #include <string>
 #include <sstream>
+#include <vector>
 
 static const Rotation wallmounted_to_rot[] = {
 	ROTATE_0, ROTATE_180, ROTATE_90, ROTATE_270
@@ -692,7 +693,8 @@ void MapNode::deSerialize(u8 *source, u8 version)
 
 Buffer<u8> MapNode::serializeBulk(int version,
 		const MapNode *nodes, u32 nodecount,
-		u8 content_width, u8 params_width)
+		u8 content_width, u8 params_width,
+		const content_t *content_map)
 {
 	if (!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapNode format not supported");
@@ -708,10 +710,16 @@ Buffer<u8> MapNode::serializeBulk(int version,
 
 	Buffer<u8> databuf(nodecount * (content_width + params_width));
 
-	// Writing to the buffer linearly is faster
+	// Writing to the buffer linearly is faster.
+	// Keep the loops branch-free so that they can be vectorized.
 	u8 *p = &databuf[0];
-	for (u32 i = 0; i < nodecount; i++, p += 2)
-		writeU16(p, nodes[i].param0);
+	if (content_map) {
+		for (u32 i = 0; i < nodecount; i++, p += 2)
+			writeU16(p, content_map[nodes[i].param0]);
+	} else {
+		for (u32 i = 0; i < nodecount; i++, p += 2)
+			writeU16(p, nodes[i].param0);
+	}
 
 	for (u32 i = 0; i < nodecount; i++, p++)
 		writeU8(p, nodes[i].param1);
@@ -737,8 +745,9 @@ void MapNode::deSerializeBulk(std::istream &is, int version,
 
 	// read data
 	const u32 len = nodecount * (content_width + params_width);
-	Buffer<u8> databuf(len);
-	is.read(reinterpret_cast<char*>(*databuf), len);
+	thread_local std::vector<u8> databuf;
+	databuf.resize(len);
+	is.read(reinterpret_cast<char*>(databuf.data()), len);
 
 	// Deserialize content
 	if(content_width == 1)
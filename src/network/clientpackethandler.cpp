@@ -33,6 +33,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "nodedef.h"
 #include "serialization.h"
 #include "util/strfnd.h"
+#include "util/stream.h"
 #include "client/clientevent.h"
 #include "client/sound.h"
 #include "client/localplayer.h"
@@ -278,9 +279,10 @@ void Client::handleCommand_NodemetaChanged(NetworkPacket *pkt)
 	if (pkt->getSize() < 1)
 		return;
 
-	std::istringstream is(pkt->readLongString(), std::ios::binary);
-	std::stringstream sstr(std::ios::binary | std::ios::in | std::ios::out);
-	decompressZlib(is, sstr);
+	std::string raw;
+	decompressZlib(pkt->readLongString(), raw);
+	StringViewStreamBuffer raw_sb(raw);
+	std::istream sstr(&raw_sb);
 
 	NodeMetadataList meta_updates_list(false);
 	meta_updates_list.deSerialize(sstr, m_itemdef, true);
@@ -654,6 +656,21 @@ void Client::handleCommand_MovePlayerRel(NetworkPacket *pkt)
 	player->addPosition(added_pos);
 }
 
+void Client::handleCommand_MapDictionary(NetworkPacket *pkt)
+{
+	std::string data = pkt->readLongString();
+
+	try {
+		// decompressZstd() looks it up by the id in the block data
+		auto dict = std::make_shared<ZstdDictionary>(data);
+		registerZstdDictionary(dict);
+		infostream << "Client: Received map dictionary " << dict->getId()
+			<< " (" << data.size() << " bytes)" << '\n';
+	} catch (SerializationError &e) {
+		errorstream << "Client: Invalid map dictionary: " << e.what() << '\n';
+	}
+}
+
 void Client::handleCommand_DeathScreenLegacy(NetworkPacket* pkt)
 {
 	ClientEvent *event = new ClientEvent();
@@ -784,9 +801,10 @@ void Client::handleCommand_NodeDef(NetworkPacket* pkt)
 	sanity_check(!m_mesh_update_manager->isRunning());
 
 	// Decompress node definitions
-	std::istringstream tmp_is(pkt->readLongString(), std::ios::binary);
-	std::stringstream tmp_os(std::ios::binary | std::ios::in | std::ios::out);
-	decompressZlib(tmp_is, tmp_os);
+	std::string raw;
+	decompressZlib(pkt->readLongString(), raw);
+	StringViewStreamBuffer raw_sb(raw);
+	std::istream tmp_os(&raw_sb);
 
 	// Deserialize node definitions
 	m_nodedef->deSerialize(tmp_os, m_proto_ver);
@@ -803,9 +821,10 @@ void Client::handleCommand_ItemDef(NetworkPacket* pkt)
 	sanity_check(!m_mesh_update_manager->isRunning());
 
 	// Decompress item definitions
-	std::istringstream tmp_is(pkt->readLongString(), std::ios::binary);
-	std::stringstream tmp_os(std::ios::binary | std::ios::in | std::ios::out);
-	decompressZlib(tmp_is, tmp_os);
+	std::string raw;
+	decompressZlib(pkt->readLongString(), raw);
+	StringViewStreamBuffer raw_sb(raw);
+	std::istream tmp_os(&raw_sb);
 
 	// Deserialize node definitions
 	m_itemdef->deSerialize(tmp_os, m_proto_ver);
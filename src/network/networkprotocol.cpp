@@ -59,9 +59,12 @@
 		Rename TOSERVER_RESPAWN to TOSERVER_RESPAWN_LEGACY
 		Support float animation frame numbers in TOCLIENT_LOCAL_PLAYER_ANIMATIONS
 		[scheduled bump for 5.10.0]
+	PROTOCOL VERSION 47:
+		Add TOCLIENT_MAP_DICTIONARY, mapblocks in TOCLIENT_BLOCKDATA may be
+		compressed with the zstd dictionary sent in it
 */
 
-const u16 LATEST_PROTOCOL_VERSION = 46;
+const u16 LATEST_PROTOCOL_VERSION = 47;
 
 // See also formspec [Version History] in doc/lua_api.md
 const u16 FORMSPEC_API_VERSION = 8;
@@ -649,6 +649,15 @@ enum ToClientCommand : u16
 		v3f added_pos
 	*/
 
+	TOCLIENT_MAP_DICTIONARY = 0x5e,
+	/*
+		u32 len
+		u8[len] trained zstd dictionary
+
+		Sent during init (before any TOCLIENT_BLOCKDATA) if the world has a
+		dictionary. The zstd frames of following mapblocks may refer to it.
+	*/
+
 	TOCLIENT_SRP_BYTES_S_B = 0x60,
 	/*
 		Belonging to AUTH_MECHANISM_SRP.
@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "remoteplayer.h"
 #include "rollback_interface.h"
 #include "scripting_server.h"
+#include "servermap.h"
 #include "settings.h"
 #include "tool.h"
 #include "version.h"
@@ -313,6 +314,12 @@ void Server::handleCommand_Init2(NetworkPacket* pkt)
 	// Send node definitions
 	SendNodeDef(peer_id, m_nodedef, protocol_version);
 
+	// Send the dictionary mapblocks will be compressed with
+	if (protocol_version >= 47) {
+		if (const ZstdDictionary *dict = m_env->getServerMap().getMapDictionary())
+			SendMapDictionary(peer_id, dict);
+	}
+
 	m_clients.event(peer_id, CSE_SetDefinitionsSent);
 
 	// Send media announcement
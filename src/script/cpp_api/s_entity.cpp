@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "common/c_converter.h"
 #include "common/c_content.h"
 #include "server.h"
+#include "server/luaentity_sao.h"
 
 bool ScriptApiEntity::luaentity_Add(u16 id, const char *name)
 {
@@ -222,6 +223,23 @@ void ScriptApiEntity::luaentity_GetProperties(u16 id,
 	lua_pop(L, 1);
 }
 
+void ScriptApiEntity::luaentity_GetNativeStep(u16 id,
+		EntityNativeStep *native_step)
+{
+	SCRIPTAPI_PRECHECKHEADER
+
+	// Get core.luaentities[id]
+	luaentity_get(L, id);
+
+	lua_getfield(L, -1, "native_step");
+	if (lua_istable(L, -1)) {
+		getfloatfield(L, -1, "on_step_interval", native_step->on_step_interval);
+		getfloatfield(L, -1, "timeout", native_step->timeout);
+		getfloatfield(L, -1, "idle_timeout", native_step->idle_timeout);
+	}
+	lua_pop(L, 2); // Pop native_step and entity
+}
+
 void ScriptApiEntity::luaentity_Step(u16 id, float dtime,
 	const collisionMoveResult *moveresult)
 {
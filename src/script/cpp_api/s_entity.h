@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 struct ObjectProperties;
 struct ToolCapabilities;
 struct collisionMoveResult;
+struct EntityNativeStep;
 
 class ScriptApiEntity
 		: virtual public ScriptApiBase
@@ -39,6 +40,7 @@ class ScriptApiEntity
 	std::string luaentity_GetStaticdata(u16 id);
 	void luaentity_GetProperties(u16 id,
 			ServerActiveObject *self, ObjectProperties *prop, const std::string &entity_name);
+	void luaentity_GetNativeStep(u16 id, EntityNativeStep *native_step);
 	void luaentity_Step(u16 id, float dtime,
 		const collisionMoveResult *moveresult);
 	bool luaentity_Punch(u16 id,
@@ -41,6 +41,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "remoteplayer.h"
 #include "server/luaentity_sao.h"
 #include "server/player_sao.h"
+#include "server/world_pregen.h"
 #include "util/string.h"
 #include "translation.h"
 #ifndef SERVER
@@ -206,6 +207,9 @@ int ModApiEnv::l_bulk_set_node(lua_State *L)
 
 	MapNode n = readnode(L, 2);
 
+	// Relight the changed blocks later in one go, if enabled
+	DeferLightingScope defer_lighting(&env->getServerMap());
+
 	// Do it
 	bool succeeded = true;
 	for (s32 i = 1; i <= len; i++) {
@@ -1232,6 +1236,46 @@ int ModApiEnv::l_emerge_area(lua_State *L)
 	return 0;
 }
 
+// pregen_area(p1, p2)
+int ModApiEnv::l_pregen_area(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	v3s16 minp = read_v3s16(L, 1);
+	v3s16 maxp = read_v3s16(L, 2);
+
+	WorldPregen *pregen = getServer(L)->getWorldPregen();
+	lua_pushboolean(L, pregen->start(minp, maxp));
+	return 1;
+}
+
+// get_pregen_status()
+int ModApiEnv::l_get_pregen_status(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	WorldPregen *pregen = getServer(L)->getWorldPregen();
+	if (!pregen->isRunning())
+		return 0;
+
+	WorldPregen::Status status = pregen->getStatus();
+	lua_createtable(L, 0, 4);
+	setintfield(L, -1, "total", status.total);
+	setintfield(L, -1, "done", status.done);
+	setintfield(L, -1, "failed", status.failed);
+	setfloatfield(L, -1, "chunks_per_second", status.chunks_per_second);
+	return 1;
+}
+
+// cancel_pregen()
+int ModApiEnv::l_cancel_pregen(lua_State *L)
+{
+	GET_ENV_PTR;
+
+	getServer(L)->getWorldPregen()->cancel();
+	return 0;
+}
+
 // delete_area(p1, p2)
 // delete mapblocks in area p1..p2
 int ModApiEnv::l_delete_area(lua_State *L)
@@ -1435,6 +1479,9 @@ void ModApiEnv::Initialize(lua_State *L, int top)
 	API_FCT(load_area);
 	API_FCT(emerge_area);
 	API_FCT(delete_area);
+	API_FCT(pregen_area);
+	API_FCT(get_pregen_status);
+	API_FCT(cancel_pregen);
 	API_FCT(get_perlin);
 	API_FCT(get_perlin_map);
 	API_FCT(get_voxel_manip);
@@ -194,6 +194,15 @@ class ModApiEnv : public ModApiEnvBase {
 	// delete_area(p1, p2) -> true/false
 	static int l_delete_area(lua_State *L);
 
+	// pregen_area(p1, p2) -> true/false
+	static int l_pregen_area(lua_State *L);
+
+	// get_pregen_status() -> table or nil
+	static int l_get_pregen_status(lua_State *L);
+
+	// cancel_pregen()
+	static int l_cancel_pregen(lua_State *L);
+
 	// get_perlin(seeddiff, octaves, persistence, scale)
 	// returns world-specific PerlinNoise
 	static int l_get_perlin(lua_State *L);
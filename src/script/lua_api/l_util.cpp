@@ -326,24 +326,22 @@ int ModApiUtil::l_compress(lua_State *L)
 
 	LuaCompressMethod method = get_compress_method(L, 2);
 
-	std::ostringstream os(std::ios_base::binary);
+	std::string out;
 
 	if (method == LUA_COMPRESS_METHOD_DEFLATE) {
 		int level = -1;
 		if (!lua_isnoneornil(L, 3))
 			level = readParam<int>(L, 3);
 
-		compressZlib(data, os, level);
+		compressZlib(data, out, level);
 	} else if (method == LUA_COMPRESS_METHOD_ZSTD) {
 		int level = ZSTD_CLEVEL_DEFAULT;
 		if (!lua_isnoneornil(L, 3))
 			level = readParam<int>(L, 3);
 
-		compressZstd(data, os, level);
+		compressZstd(data, out, level);
 	}
 
-	std::string out = os.str();
-
 	lua_pushlstring(L, out.data(), out.size());
 	return 1;
 }
@@ -357,18 +355,14 @@ int ModApiUtil::l_decompress(lua_State *L)
 
 	LuaCompressMethod method = get_compress_method(L, 2);
 
-	// FIXME: zero copy possible in c++26 or with custom rdbuf
-	std::istringstream is(std::string(data), std::ios_base::binary);
-	std::ostringstream os(std::ios_base::binary);
+	std::string out;
 
 	if (method == LUA_COMPRESS_METHOD_DEFLATE) {
-		decompressZlib(is, os);
+		decompressZlib(data, out);
 	} else if (method == LUA_COMPRESS_METHOD_ZSTD) {
-		decompressZstd(is, os);
+		decompressZstd(data, out);
 	}
 
-	std::string out = os.str();
-
 	lua_pushlstring(L, out.data(), out.size());
 	return 1;
 }
@@ -130,6 +130,12 @@ int LuaVoxelManip::l_write_to_map(lua_State *L)
 	std::map<v3s16, MapBlock*> modified_blocks;
 	if (o->is_mapgen_vm || !update_light) {
 		o->vm->blitBackAll(&modified_blocks);
+	} else if (map->isLightingDeferralEnabled()) {
+		// Relit by the server step before the blocks are sent
+		o->vm->blitBackAll(&modified_blocks);
+		VoxelArea &area = o->vm->m_area;
+		map->deferLighting(VoxelArea(getNodeBlockPos(area.MinEdge),
+				getNodeBlockPos(area.MaxEdge)));
 	} else {
 		voxalgo::blit_back_with_light(map, o->vm, &modified_blocks);
 	}
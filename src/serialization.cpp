@@ -23,7 +23,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <zlib.h>
 #include <zstd.h>
+#include <zdict.h>
+#include <algorithm>
 #include <memory>
+#include <sstream>
+#include <shared_mutex>
 
 /* report a zlib or i/o error */
 static void zerr(int ret)
@@ -53,34 +57,141 @@ static void zerr(int ret)
 	}
 }
 
-// Make sure that z is deleted in case of exception
-template <int (*F)(z_stream*)>
-class ZlibAutoDeleter {
+/*
+	Reusable (de)compression state
+
+	Setting up a compression context allocates quite a bit of memory, so
+	every thread keeps one of each kind around. They are destroyed when the
+	thread ends.
+*/
+
+class ZlibDeflater {
 public:
-	ZlibAutoDeleter(z_stream *ptr) : ptr_(ptr) {}
-	~ZlibAutoDeleter() { F(ptr_); }
+	~ZlibDeflater()
+	{
+		if (m_initialized)
+			deflateEnd(&m_z);
+	}
+
+	// Returns the stream ready to compress new data at the given level
+	z_stream *get(int level)
+	{
+		if (m_initialized && level == m_level) {
+			deflateReset(&m_z);
+			return &m_z;
+		}
+		if (m_initialized)
+			deflateEnd(&m_z);
+		m_initialized = false;
+
+		m_z = z_stream();
+		m_z.zalloc = Z_NULL;
+		m_z.zfree = Z_NULL;
+		m_z.opaque = Z_NULL;
+		if (deflateInit(&m_z, level) != Z_OK)
+			throw SerializationError("compressZlib: deflateInit failed");
+		m_initialized = true;
+		m_level = level;
+		return &m_z;
+	}
 
 private:
-	z_stream *ptr_;
+	z_stream m_z;
+	bool m_initialized = false;
+	int m_level = 0;
 };
 
+class ZlibInflater {
+public:
+	~ZlibInflater()
+	{
+		if (m_initialized)
+			inflateEnd(&m_z);
+	}
+
+	z_stream *get()
+	{
+		if (m_initialized) {
+			inflateReset(&m_z);
+			return &m_z;
+		}
+
+		m_z = z_stream();
+		m_z.zalloc = Z_NULL;
+		m_z.zfree = Z_NULL;
+		m_z.opaque = Z_NULL;
+		if (inflateInit(&m_z) != Z_OK)
+			throw SerializationError("decompressZlib: inflateInit failed");
+		m_initialized = true;
+		return &m_z;
+	}
+
+private:
+	z_stream m_z;
+	bool m_initialized = false;
+};
+
+struct ZSTD_Deleter {
+	void operator() (ZSTD_CCtx* cctx) {
+		ZSTD_freeCCtx(cctx);
+	}
+
+	void operator() (ZSTD_DCtx* dctx) {
+		ZSTD_freeDCtx(dctx);
+	}
+};
+
+static z_stream *getZlibDeflater(int level)
+{
+	thread_local ZlibDeflater deflater;
+	return deflater.get(level);
+}
+
+static z_stream *getZlibInflater()
+{
+	thread_local ZlibInflater inflater;
+	return inflater.get();
+}
+
+// (ZSTD_CStream and ZSTD_DStream are the same types as these)
+static ZSTD_CCtx *getZstdCCtx()
+{
+	thread_local std::unique_ptr<ZSTD_CCtx, ZSTD_Deleter> cctx(ZSTD_createCCtx());
+	return cctx.get();
+}
+
+static ZSTD_DCtx *getZstdDCtx()
+{
+	thread_local std::unique_ptr<ZSTD_DCtx, ZSTD_Deleter> dctx(ZSTD_createDCtx());
+	return dctx.get();
+}
+
+// Looks at the frame header and makes dctx use the dictionary it needs.
+// Returns the dictionary, which must be kept alive while decompressing.
+static std::shared_ptr<ZstdDictionary> refZstdFrameDictionary(ZSTD_DCtx *dctx,
+		const void *src, size_t src_size)
+{
+	u32 dict_id = ZSTD_getDictID_fromFrame(src, src_size);
+	if (dict_id == 0)
+		return nullptr;
+
+	auto dict = getZstdDictionary(dict_id);
+	if (!dict)
+		throw SerializationError("decompressZstd: unknown dictionary");
+	ZSTD_DCtx_refDDict(dctx, dict->getDDict());
+	return dict;
+}
+
+/*
+	zlib
+*/
+
 void compressZlib(const u8 *data, size_t data_size, std::ostream &os, int level)
 {
-	z_stream z;
+	z_stream &z = *getZlibDeflater(level);
 	const s32 bufsize = 16384;
 	char output_buffer[bufsize];
 	int status = 0;
-	int ret;
-
-	z.zalloc = Z_NULL;
-	z.zfree = Z_NULL;
-	z.opaque = Z_NULL;
-
-	ret = deflateInit(&z, level);
-	if(ret != Z_OK)
-		throw SerializationError("compressZlib: deflateInit failed");
-
-	ZlibAutoDeleter<deflateEnd> deleter(&z);
 
 	// Point zlib to our input buffer
 	z.next_in = (Bytef*)&data[0];
@@ -109,25 +220,14 @@ void compressZlib(const u8 *data, size_t data_size, std::ostream &os, int level)
 
 void decompressZlib(std::istream &is, std::ostream &os, size_t limit)
 {
-	z_stream z;
 	const s32 bufsize = 16384;
 	char input_buffer[bufsize];
 	char output_buffer[bufsize];
 	int status = 0;
-	int ret;
 	int bytes_written = 0;
 	int input_buffer_len = 0;
 
-	z.zalloc = Z_NULL;
-	z.zfree = Z_NULL;
-	z.opaque = Z_NULL;
-
-	ret = inflateInit(&z);
-	if(ret != Z_OK)
-		throw SerializationError("dcompressZlib: inflateInit failed");
-
-	ZlibAutoDeleter<inflateEnd> deleter(&z);
-
+	z_stream &z = *getZlibInflater();
 	z.avail_in = 0;
 
 	for(;;)
@@ -191,23 +291,164 @@ void decompressZlib(std::istream &is, std::ostream &os, size_t limit)
 	}
 }
 
-struct ZSTD_Deleter {
-	void operator() (ZSTD_CStream* cstream) {
-		ZSTD_freeCStream(cstream);
+void compressZlib(std::string_view data, std::string &out, int level)
+{
+	z_stream &z = *getZlibDeflater(level);
+
+	// The bound makes a single deflate call with Z_FINISH sufficient
+	const size_t start = out.size();
+	const uLong bound = deflateBound(&z, data.size());
+	out.resize(start + bound);
+
+	z.next_in = (Bytef*)data.data();
+	z.avail_in = data.size();
+	z.next_out = (Bytef*)&out[start];
+	z.avail_out = bound;
+
+	int status = deflate(&z, Z_FINISH);
+	if (status != Z_STREAM_END) {
+		out.resize(start);
+		zerr(status);
+		throw SerializationError("compressZlib: deflate failed");
 	}
+	out.resize(start + z.total_out);
+}
+
+size_t decompressZlib(std::string_view data, std::string &out, size_t limit)
+{
+	z_stream &z = *getZlibInflater();
+
+	z.next_in = (Bytef*)data.data();
+	z.avail_in = data.size();
+
+	const size_t start = out.size();
+	// Compressed data usually expands a few times, start with a guess
+	size_t capacity = std::max<size_t>(data.size() * 4, 1024);
+	if (limit)
+		capacity = std::min(capacity, limit);
+
+	for (;;) {
+		out.resize(start + capacity);
+		size_t written = z.total_out;
+		z.next_out = (Bytef*)&out[start + written];
+		z.avail_out = capacity - written;
+
+		int status = inflate(&z, Z_NO_FLUSH);
+		if (status == Z_STREAM_END)
+			break;
+
+		if (status != Z_OK && status != Z_BUF_ERROR) {
+			out.resize(start);
+			zerr(status);
+			throw SerializationError("decompressZlib: inflate failed");
+		}
 
-	void operator() (ZSTD_DStream* dstream) {
-		ZSTD_freeDStream(dstream);
+		if (z.avail_out != 0) {
+			// Not out of output space, so we ran out of input
+			out.resize(start);
+			throw SerializationError("decompressZlib: data ended too early");
+		}
+
+		if (limit && capacity >= limit)
+			break;
+		capacity *= 2;
+		if (limit)
+			capacity = std::min(capacity, limit);
 	}
-};
 
-void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level)
+	out.resize(start + z.total_out);
+	return z.total_in;
+}
+
+/*
+	Zstd dictionaries
+*/
+
+ZstdDictionary::ZstdDictionary(const std::string &data) :
+	m_data(data)
 {
-	// reusing the context is recommended for performance
-	// it will be destroyed when the thread ends
-	thread_local std::unique_ptr<ZSTD_CStream, ZSTD_Deleter> stream(ZSTD_createCStream());
+	// Raw content dictionaries have no id and could not be told apart when
+	// decompressing, so only accept trained ones.
+	m_id = ZSTD_getDictID_fromDict(m_data.data(), m_data.size());
+	if (m_id == 0)
+		throw SerializationError("ZstdDictionary: not a trained dictionary");
+
+	m_ddict = ZSTD_createDDict(m_data.data(), m_data.size());
+	if (!m_ddict)
+		throw SerializationError("ZstdDictionary: invalid dictionary");
+}
+
+ZstdDictionary::~ZstdDictionary()
+{
+	for (auto &it : m_cdicts)
+		ZSTD_freeCDict(it.second);
+	ZSTD_freeDDict(m_ddict);
+}
 
-	ZSTD_initCStream(stream.get(), level);
+const ZSTD_CDict *ZstdDictionary::getCDict(int level) const
+{
+	std::lock_guard<std::mutex> lock(m_cdicts_mutex);
+	auto it = m_cdicts.find(level);
+	if (it != m_cdicts.end())
+		return it->second;
+
+	ZSTD_CDict *cdict = ZSTD_createCDict(m_data.data(), m_data.size(), level);
+	if (!cdict)
+		throw SerializationError("ZstdDictionary: failed to create CDict");
+	m_cdicts[level] = cdict;
+	return cdict;
+}
+
+std::string trainZstdDictionary(const std::vector<std::string> &samples,
+		size_t max_size)
+{
+	std::string buffer;
+	std::vector<size_t> sizes;
+	sizes.reserve(samples.size());
+	for (const auto &sample : samples) {
+		buffer.append(sample);
+		sizes.push_back(sample.size());
+	}
+
+	std::string dict(max_size, '\0');
+	size_t ret = ZDICT_trainFromBuffer(&dict[0], dict.size(),
+			buffer.data(), sizes.data(), sizes.size());
+	if (ZDICT_isError(ret)) {
+		throw SerializationError(std::string("trainZstdDictionary: ") +
+				ZDICT_getErrorName(ret));
+	}
+	dict.resize(ret);
+	return dict;
+}
+
+static std::shared_mutex g_zstd_dicts_mutex;
+static std::unordered_map<u32, std::shared_ptr<ZstdDictionary>> g_zstd_dicts;
+
+void registerZstdDictionary(const std::shared_ptr<ZstdDictionary> &dict)
+{
+	std::unique_lock lock(g_zstd_dicts_mutex);
+	g_zstd_dicts[dict->getId()] = dict;
+}
+
+std::shared_ptr<ZstdDictionary> getZstdDictionary(u32 id)
+{
+	std::shared_lock lock(g_zstd_dicts_mutex);
+	auto it = g_zstd_dicts.find(id);
+	return it == g_zstd_dicts.end() ? nullptr : it->second;
+}
+
+void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level,
+		const ZstdDictionary *dict)
+{
+	ZSTD_CStream *stream = getZstdCCtx();
+
+	if (dict) {
+		// the compression parameters come from the digested dictionary
+		ZSTD_CCtx_reset(stream, ZSTD_reset_session_only);
+		ZSTD_CCtx_refCDict(stream, dict->getCDict(level));
+	} else {
+		ZSTD_initCStream(stream, level);
+	}
 
 	const size_t bufsize = 16384;
 	char output_buffer[bufsize];
@@ -216,7 +457,7 @@ void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level)
 	ZSTD_outBuffer output = { output_buffer, bufsize, 0 };
 
 	while (input.pos < input.size) {
-		size_t ret = ZSTD_compressStream(stream.get(), &output, &input);
+		size_t ret = ZSTD_compressStream(stream, &output, &input);
 		if (ZSTD_isError(ret)) {
 			dstream << ZSTD_getErrorName(ret) << '\n';
 			throw SerializationError("compressZstd: failed");
@@ -229,7 +470,7 @@ void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level)
 
 	size_t ret;
 	do {
-		ret = ZSTD_endStream(stream.get(), &output);
+		ret = ZSTD_endStream(stream, &output);
 		if (ZSTD_isError(ret)) {
 			dstream << ZSTD_getErrorName(ret) << '\n';
 			throw SerializationError("compressZstd: failed");
@@ -242,13 +483,84 @@ void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level)
 
 }
 
+void compressZstd(std::string_view data, std::string &out, int level,
+		const ZstdDictionary *dict)
+{
+	ZSTD_CCtx *cctx = getZstdCCtx();
+
+	ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+	if (dict) {
+		// the compression parameters come from the digested dictionary
+		ZSTD_CCtx_refCDict(cctx, dict->getCDict(level));
+	} else {
+		ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+	}
+
+	// Compressing into a buffer of the bound size is done in one go
+	const size_t start = out.size();
+	out.resize(start + ZSTD_compressBound(data.size()));
+	size_t ret = ZSTD_compress2(cctx, &out[start], out.size() - start,
+			data.data(), data.size());
+	if (ZSTD_isError(ret)) {
+		out.resize(start);
+		dstream << ZSTD_getErrorName(ret) << '\n';
+		throw SerializationError("compressZstd: failed");
+	}
+	out.resize(start + ret);
+}
+
+size_t decompressZstd(std::string_view data, std::string &out)
+{
+	ZSTD_DCtx *dctx = getZstdDCtx();
+
+	ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
+	// keeps the dictionary alive while it's referenced by the context
+	std::shared_ptr<ZstdDictionary> dict =
+		refZstdFrameDictionary(dctx, data.data(), data.size());
+
+	const size_t start = out.size();
+	// The frame header usually knows the size, so one allocation is enough.
+	// Don't trust it blindly though, it comes from the data.
+	size_t capacity = 16384;
+	unsigned long long content_size = ZSTD_getFrameContentSize(data.data(), data.size());
+	if (content_size != ZSTD_CONTENTSIZE_UNKNOWN && content_size != ZSTD_CONTENTSIZE_ERROR)
+		capacity = std::min<unsigned long long>(content_size, 4 * 1024 * 1024) + 1;
+
+	ZSTD_inBuffer input = { data.data(), data.size(), 0 };
+	size_t written = 0;
+	for (;;) {
+		if (written == capacity)
+			capacity *= 2;
+		out.resize(start + capacity);
+		ZSTD_outBuffer output = { &out[start], capacity, written };
+
+		size_t ret = ZSTD_decompressStream(dctx, &output, &input);
+		if (ZSTD_isError(ret)) {
+			out.resize(start);
+			dstream << ZSTD_getErrorName(ret) << '\n';
+			throw SerializationError("decompressZstd: failed");
+		}
+		written = output.pos;
+		if (ret == 0)
+			break;
+
+		// The frame isn't done, yet there is room for more output:
+		// all input was consumed.
+		if (output.pos < output.size) {
+			out.resize(start);
+			throw SerializationError("decompressZstd: data ended too early");
+		}
+	}
+
+	out.resize(start + written);
+	return input.pos;
+}
+
 void decompressZstd(std::istream &is, std::ostream &os)
 {
-	// reusing the context is recommended for performance
-	// it will be destroyed when the thread ends
-	thread_local std::unique_ptr<ZSTD_DStream, ZSTD_Deleter> stream(ZSTD_createDStream());
+	ZSTD_DStream *stream = getZstdDCtx();
 
-	ZSTD_initDStream(stream.get());
+	ZSTD_initDStream(stream);
 
 	const size_t bufsize = 16384;
 	char output_buffer[bufsize];
@@ -256,6 +568,9 @@ void decompressZstd(std::istream &is, std::ostream &os)
 
 	ZSTD_outBuffer output = { output_buffer, bufsize, 0 };
 	ZSTD_inBuffer input = { input_buffer, 0, 0 };
+	// keeps the dictionary alive while it's referenced by the stream
+	std::shared_ptr<ZstdDictionary> dict;
+	bool first_read = true;
 	size_t ret;
 	do
 	{
@@ -267,7 +582,13 @@ void decompressZstd(std::istream &is, std::ostream &os)
 				throw SerializationError("decompressZstd: data ended too early");
 		}
 
-		ret = ZSTD_decompressStream(stream.get(), &output, &input);
+		if (first_read) {
+			first_read = false;
+			// Look at the frame header to see if it needs a dictionary
+			dict = refZstdFrameDictionary(stream, input.src, input.size);
+		}
+
+		ret = ZSTD_decompressStream(stream, &output, &input);
 		if (ZSTD_isError(ret)) {
 			dstream << ZSTD_getErrorName(ret) << '\n';
 			throw SerializationError("decompressZstd: failed");
@@ -287,12 +608,13 @@ void decompressZstd(std::istream &is, std::ostream &os)
 	}
 }
 
-void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level)
+void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level,
+		const ZstdDictionary *dict)
 {
 	if(version >= 29)
 	{
 		// map the zlib levels [0,9] to [1,10]. -1 becomes 0 which indicates the default (currently 3)
-		compressZstd(data, size, os, level + 1);
+		compressZstd(data, size, os, level + 1, dict);
 		return;
 	}
 
@@ -337,6 +659,39 @@ void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level)
 	os.write((char*)&current_byte, 1);
 }
 
+void compress(std::string_view data, std::string &out, u8 version, int level,
+		const ZstdDictionary *dict)
+{
+	if (version >= 29) {
+		compressZstd(data, out, level + 1, dict);
+		return;
+	}
+
+	if (version >= 11) {
+		compressZlib(data, out, level);
+		return;
+	}
+
+	std::ostringstream os(std::ios_base::binary);
+	compress(data, os, version, level);
+	out.append(os.str());
+}
+
+size_t decompress(std::string_view data, std::string &out, u8 version)
+{
+	if (version >= 29)
+		return decompressZstd(data, out);
+
+	if (version >= 11)
+		return decompressZlib(data, out);
+
+	std::istringstream is(std::string(data), std::ios_base::binary);
+	std::ostringstream os(std::ios_base::binary);
+	decompress(is, os, version);
+	out.append(os.str());
+	return is.eof() ? data.size() : (size_t)is.tellg();
+}
+
 void decompress(std::istream &is, std::ostream &os, u8 version)
 {
 	if(version >= 29)
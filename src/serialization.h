@@ -21,8 +21,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "irrlichttypes.h"
 #include "exceptions.h"
+#include "util/basic_macros.h"
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 /*
 	Map format serialization version
@@ -82,6 +88,51 @@ inline bool ser_ver_supported(s32 v) {
 	return v >= SER_FMT_VER_LOWEST_READ && v <= SER_FMT_VER_HIGHEST_READ;
 }
 
+/*
+	Zstd dictionaries
+*/
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+// A trained zstd dictionary.
+// Frames compressed with a dictionary carry its id, decompression picks the
+// dictionary up by that id from the ones passed to registerZstdDictionary().
+class ZstdDictionary
+{
+public:
+	// @throws SerializationError if data is not a trained dictionary
+	ZstdDictionary(const std::string &data);
+	~ZstdDictionary();
+
+	DISABLE_CLASS_COPY(ZstdDictionary);
+
+	u32 getId() const { return m_id; }
+	const std::string &getData() const { return m_data; }
+
+	// Digested dictionary for the given (zstd) compression level,
+	// created on first use
+	const ZSTD_CDict_s *getCDict(int level) const;
+	const ZSTD_DDict_s *getDDict() const { return m_ddict; }
+
+private:
+	std::string m_data;
+	u32 m_id = 0;
+	ZSTD_DDict_s *m_ddict = nullptr;
+
+	mutable std::mutex m_cdicts_mutex;
+	mutable std::unordered_map<int, ZSTD_CDict_s*> m_cdicts;
+};
+
+// Trains a dictionary of at most max_size bytes from the given samples.
+// @throws SerializationError if training failed (e.g. too few samples)
+std::string trainZstdDictionary(const std::vector<std::string> &samples,
+		size_t max_size);
+
+// Makes the dictionary available to decompressZstd()
+void registerZstdDictionary(const std::shared_ptr<ZstdDictionary> &dict);
+std::shared_ptr<ZstdDictionary> getZstdDictionary(u32 id);
+
 /*
 	Compression functions
 */
@@ -93,17 +144,46 @@ inline void compressZlib(std::string_view data, std::ostream &os, int level = -1
 }
 void decompressZlib(std::istream &is, std::ostream &os, size_t limit = 0);
 
-void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level = 0);
-inline void compressZstd(std::string_view data, std::ostream &os, int level = 0)
+void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level = 0,
+		const ZstdDictionary *dict = nullptr);
+inline void compressZstd(std::string_view data, std::ostream &os, int level = 0,
+		const ZstdDictionary *dict = nullptr)
 {
-	compressZstd(reinterpret_cast<const u8*>(data.data()), data.size(), os, level);
+	compressZstd(reinterpret_cast<const u8*>(data.data()), data.size(), os, level, dict);
 }
+// Frames that were compressed with a dictionary need it to be registered
 void decompressZstd(std::istream &is, std::ostream &os);
 
+/*
+	Buffer variants
+
+	These use the same per-thread contexts as the stream functions, but work
+	on memory directly instead of going through 16 KiB chunks of iostreams.
+	The output is appended to `out`, whose capacity is reused by the caller.
+	Decompression returns the number of input bytes that made up the
+	compressed data; anything after it is not touched.
+
+	@throws SerializationError on invalid or truncated data
+*/
+
+void compressZlib(std::string_view data, std::string &out, int level = -1);
+// Stops once `limit` bytes have been output if limit is nonzero
+size_t decompressZlib(std::string_view data, std::string &out, size_t limit = 0);
+
+void compressZstd(std::string_view data, std::string &out, int level = 0,
+		const ZstdDictionary *dict = nullptr);
+size_t decompressZstd(std::string_view data, std::string &out);
+
 // These choose between zstd, zlib and a self-made one according to version
-void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level = -1);
-inline void compress(std::string_view data, std::ostream &os, u8 version, int level = -1)
+// The dictionary is only used for zstd (version >= 29)
+void compress(const u8 *data, u32 size, std::ostream &os, u8 version, int level = -1,
+		const ZstdDictionary *dict = nullptr);
+inline void compress(std::string_view data, std::ostream &os, u8 version, int level = -1,
+		const ZstdDictionary *dict = nullptr)
 {
-	compress(reinterpret_cast<const u8*>(data.data()), data.size(), os, version, level);
+	compress(reinterpret_cast<const u8*>(data.data()), data.size(), os, version, level, dict);
 }
 void decompress(std::istream &is, std::ostream &os, u8 version);
+void compress(std::string_view data, std::string &out, u8 version, int level = -1,
+		const ZstdDictionary *dict = nullptr);
+size_t decompress(std::string_view data, std::string &out, u8 version);
@@ -28,6 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "server/ban.h"
 #include "environment.h"
 #include "servermap.h"
+#include "serialization.h"
 #include "threading/mutex_auto_lock.h"
 #include "constants.h"
 #include "voxel.h"
@@ -66,6 +67,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "remoteplayer.h"
 #include "server/player_sao.h"
 #include "server/serverinventorymgr.h"
+#include "server/world_pregen.h"
 #include "translation.h"
 #include "database/database-sqlite3.h"
 #if USE_POSTGRESQL
@@ -366,6 +368,9 @@ Server::~Server()
 	if (m_emerge)
 		m_emerge->stopThreads();
 
+	// Checkpoints an unfinished pregeneration
+	m_pregen.reset();
+
 	if (m_env) {
 		EnvAutoLock envlock(this);
 
@@ -464,6 +469,7 @@ void Server::init()
 
 	// Create emerge manager
 	m_emerge = std::make_unique<EmergeManager>(this, m_metrics_backend.get());
+	m_pregen = std::make_unique<WorldPregen>(this, m_path_world);
 
 	// Create ban manager
 	std::string ban_path = m_path_world + DIR_DELIM "ipban.txt";
@@ -563,6 +569,7 @@ void Server::init()
 	// Those settings can be overwritten in world.apr, they are
 	// intended to be cached after environment loading.
 	m_liquid_transform_every = g_settings->getFloat("liquid_update");
+	m_deferred_lighting_time_budget = g_settings->getFloat("deferred_lighting_time_budget");
 	m_max_chatmessage_length = g_settings->getU16("chat_message_max_size");
 	m_csm_restriction_flags = g_settings->getU64("csm_restriction_flags");
 	m_csm_restriction_noderange = g_settings->getU32("csm_restriction_noderange");
@@ -760,6 +767,31 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 			m_env->getMap().dispatchEvent(event);
 		}
 	}
+
+	/* Relight areas queued by deferred lighting */
+	if (m_env->getServerMap().getDeferredLightingCount() > 0) {
+		EnvAutoLock lock(this);
+
+		ScopeProfiler sp(g_profiler, "Server: deferred lighting");
+
+		u32 max_time_ms = getStepSettings().steplen * 1000 *
+				m_deferred_lighting_time_budget;
+		std::map<v3s16, MapBlock*> modified_blocks;
+		m_env->getServerMap().processDeferredLighting(max_time_ms, modified_blocks);
+
+		if (!modified_blocks.empty()) {
+			MapEditEvent event;
+			event.type = MEET_OTHER;
+			event.setModifiedBlocks(modified_blocks);
+			m_env->getMap().dispatchEvent(event);
+		}
+	}
+
+	/* Pregenerate the world */
+	if (m_pregen->isRunning()) {
+		ScopeProfiler sp(g_profiler, "Server: world pregen");
+		m_pregen->step(dtime);
+	}
 	m_clients.step(dtime);
 
 	// increase/decrease lag gauge gradually
@@ -855,97 +887,39 @@ void Server::AsyncRunStep(float dtime, bool initial_step)
 		EnvAutoLock envlock(this);
 		ScopeProfiler sp(g_profiler, "Server: send SAO messages");
 
-		// Key = object id
-		// Value = data sent by object
-		std::unordered_map<u16, std::vector<ActiveObjectMessage>*> buffered_messages;
+		ClientInterface::AutoLock clientlock(m_clients);
+		m_aom_router.reset();
+		for (const auto &client_it : m_clients.getClientList()) {
+			RemoteClient *client = client_it.second;
+			PlayerSAO *player = getPlayerSAO(client->peer_id);
+			m_aom_router.addRecipient(client, player ? player->getId() : 0);
+		}
 
-		// Get active object messages from environment
+		// Get active object messages from environment and route them to
+		// the clients that know the objects
 		ActiveObjectMessage aom(0);
 		u32 count_reliable = 0, count_unreliable = 0;
-		for(;;) {
-			if (!m_env->getActiveObjectMessage(&aom))
-				break;
+		while (m_env->getActiveObjectMessage(&aom)) {
 			if (aom.reliable)
 				count_reliable++;
 			else
 				count_unreliable++;
 
-			std::vector<ActiveObjectMessage>* message_list = nullptr;
-			auto n = buffered_messages.find(aom.id);
-			if (n == buffered_messages.end()) {
-				message_list = new std::vector<ActiveObjectMessage>;
-				buffered_messages[aom.id] = message_list;
-			} else {
-				message_list = n->second;
-			}
-			message_list->push_back(std::move(aom));
+			// If object does not exist, skip it
+			ServerActiveObject *sao = m_env->getActiveObject(aom.id);
+			if (sao)
+				m_aom_router.route(aom, sao);
 		}
 
 		m_aom_buffer_counter[0]->increment(count_reliable);
 		m_aom_buffer_counter[1]->increment(count_unreliable);
 
-		{
-			ClientInterface::AutoLock clientlock(m_clients);
-			const RemoteClientMap &clients = m_clients.getClientList();
-			// Route data to every client
-			std::string reliable_data, unreliable_data;
-			for (const auto &client_it : clients) {
-				reliable_data.clear();
-				unreliable_data.clear();
-				RemoteClient *client = client_it.second;
-				PlayerSAO *player = getPlayerSAO(client->peer_id);
-				// Go through all objects in message buffer
-				for (const auto &buffered_message : buffered_messages) {
-					// If object does not exist or is not known by client, skip it
-					u16 id = buffered_message.first;
-					ServerActiveObject *sao = m_env->getActiveObject(id);
-					if (!sao || client->m_known_objects.find(id) == client->m_known_objects.end())
-						continue;
-
-					// Get message list of object
-					std::vector<ActiveObjectMessage>* list = buffered_message.second;
-					// Go through every message
-					for (const ActiveObjectMessage &aom : *list) {
-						// Send position updates to players who do not see the attachment
-						if (aom.datastring[0] == AO_CMD_UPDATE_POSITION) {
-							if (sao->getId() == player->getId())
-								continue;
-
-							// Do not send position updates for attached players
-							// as long the parent is known to the client
-							ServerActiveObject *parent = sao->getParent();
-							if (parent && client->m_known_objects.find(parent->getId()) !=
-									client->m_known_objects.end())
-								continue;
-						}
-
-						// Add full new data to appropriate buffer
-						std::string &buffer = aom.reliable ? reliable_data : unreliable_data;
-						char idbuf[2];
-						writeU16((u8*) idbuf, aom.id);
-						// u16 id
-						// std::string data
-						buffer.append(idbuf, sizeof(idbuf));
-						buffer.append(serializeString16(aom.datastring));
-					}
-				}
-				/*
-					reliable_data and unreliable_data are now ready.
-					Send them.
-				*/
-				if (!reliable_data.empty()) {
-					SendActiveObjectMessages(client->peer_id, reliable_data);
-				}
-
-				if (!unreliable_data.empty()) {
-					SendActiveObjectMessages(client->peer_id, unreliable_data, false);
-				}
-			}
-		}
-
-		// Clear buffered_messages
-		for (auto &buffered_message : buffered_messages) {
-			delete buffered_message.second;
+		for (const auto &recipient : m_aom_router) {
+			session_t peer_id = recipient.client->peer_id;
+			if (!recipient.reliable.empty())
+				SendActiveObjectMessages(peer_id, recipient.reliable);
+			if (!recipient.unreliable.empty())
+				SendActiveObjectMessages(peer_id, recipient.unreliable, false);
 		}
 	}
 
@@ -1480,9 +1454,9 @@ void Server::SendItemDef(session_t peer_id,
 	*/
 	std::ostringstream tmp_os(std::ios::binary);
 	itemdef->serialize(tmp_os, protocol_version);
-	std::ostringstream tmp_os2(std::ios::binary);
-	compressZlib(tmp_os.str(), tmp_os2);
-	pkt.putLongString(tmp_os2.str());
+	std::string compressed;
+	compressZlib(tmp_os.str(), compressed);
+	pkt.putLongString(compressed);
 
 	// Make data buffer
 	verbosestream << "Server: Sending item definitions to id(" << peer_id
@@ -1491,6 +1465,17 @@ void Server::SendItemDef(session_t peer_id,
 	Send(&pkt);
 }
 
+void Server::SendMapDictionary(session_t peer_id, const ZstdDictionary *dict)
+{
+	NetworkPacket pkt(TOCLIENT_MAP_DICTIONARY, 4 + dict->getData().size(), peer_id);
+	pkt.putLongString(dict->getData());
+
+	verbosestream << "Server: Sending map dictionary to id(" << peer_id
+			<< "): size=" << pkt.getSize() << '\n';
+
+	Send(&pkt);
+}
+
 void Server::SendNodeDef(session_t peer_id,
 	const NodeDefManager *nodedef, u16 protocol_version)
 {
@@ -1503,10 +1488,10 @@ void Server::SendNodeDef(session_t peer_id,
 	*/
 	std::ostringstream tmp_os(std::ios::binary);
 	nodedef->serialize(tmp_os, protocol_version);
-	std::ostringstream tmp_os2(std::ios::binary);
-	compressZlib(tmp_os.str(), tmp_os2);
+	std::string compressed;
+	compressZlib(tmp_os.str(), compressed);
 
-	pkt.putLongString(tmp_os2.str());
+	pkt.putLongString(compressed);
 
 	// Make data buffer
 	verbosestream << "Server: Sending node definitions to id(" << peer_id
@@ -2109,8 +2094,8 @@ void Server::SendActiveObjectRemoveAdd(RemoteClient *client, PlayerSAO *playersa
 
 		// Remove from known objects
 		client->m_known_objects.erase(id);
-		if (obj && obj->m_known_by_count > 0)
-			obj->m_known_by_count--;
+		if (obj)
+			obj->removeKnownBy(client->peer_id);
 	}
 
 	// Note: Do yet NOT stop or remove object-attached sounds where the object goes out
@@ -2136,7 +2121,7 @@ void Server::SendActiveObjectRemoveAdd(RemoteClient *client, PlayerSAO *playersa
 
 		// Add to known objects
 		client->m_known_objects.insert(id);
-		obj->m_known_by_count++;
+		obj->addKnownBy(client->peer_id);
 	}
 
 	Send(&pkt);
@@ -2357,6 +2342,7 @@ void Server::sendMetadataChanged(const std::unordered_set<v3s16> &positions, flo
 {
 	NodeMetadataList meta_updates_list(false);
 	std::ostringstream os(std::ios::binary);
+	std::string compressed;
 
 	std::vector<session_t> clients = m_clients.getClientIDs();
 	ClientInterface::AutoLock clientlock(m_clients);
@@ -2393,12 +2379,11 @@ void Server::sendMetadataChanged(const std::unordered_set<v3s16> &positions, flo
 		// Send the meta changes
 		os.str("");
 		meta_updates_list.serialize(os, client->serialization_version, false, true, true);
-		std::string raw = os.str();
-		os.str("");
-		compressZlib(raw, os);
+		compressed.clear();
+		compressZlib(os.str(), compressed);
 
 		NetworkPacket pkt(TOCLIENT_NODEMETA_CHANGED, 0, i);
-		pkt.putLongString(os.str());
+		pkt.putLongString(compressed);
 		Send(&pkt);
 
 		meta_updates_list.clear();
@@ -2411,8 +2396,14 @@ void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 	thread_local const int net_compression_level = rangelim(g_settings->getS16("map_compression_level_net"), -1, 9);
 	std::string s, *sptr = nullptr;
 
+	// The client got the dictionary during init if it supports it
+	const ZstdDictionary *dict = net_proto_version >= 47 ?
+		m_env->getServerMap().getMapDictionary() : nullptr;
+	// Cache key: serialization version, and whether the dictionary is used
+	const u16 cache_ver = ver | (dict ? 0x100 : 0);
+
 	if (cache) {
-		auto it = cache->find({block->getPos(), ver});
+		auto it = cache->find({block->getPos(), cache_ver});
 		if (it != cache->end())
 			sptr = &it->second;
 	}
@@ -2420,7 +2411,7 @@ void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 	// Serialize the block in the right format
 	if (!sptr) {
 		std::ostringstream os(std::ios_base::binary);
-		block->serialize(os, ver, false, net_compression_level);
+		block->serialize(os, ver, false, net_compression_level, dict);
 		block->serializeNetworkSpecific(os);
 		s = os.str();
 		sptr = &s;
@@ -2433,7 +2424,7 @@ void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 
 	// Store away in cache
 	if (cache && sptr == &s)
-		(*cache)[{block->getPos(), ver}] = std::move(s);
+		(*cache)[{block->getPos(), cache_ver}] = std::move(s);
 }
 
 void Server::SendBlocks(float dtime)
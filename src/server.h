@@ -35,6 +35,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/metricsbackend.h"
 #include "serverenvironment.h"
 #include "server/clientiface.h"
+#include "server/ao_message_router.h"
 #include "threading/ordered_mutex.h"
 #include "chatmessage.h"
 #include "sound.h"
@@ -65,6 +66,7 @@ struct PlayerHPChangeReason;
 class IRollbackManager;
 struct RollbackAction;
 class EmergeManager;
+class WorldPregen;
 class ServerScripting;
 class ServerEnvironment;
 struct SoundSpec;
@@ -73,6 +75,7 @@ struct SkyboxParams;
 struct SunParams;
 struct MoonParams;
 struct StarParams;
+class ZstdDictionary;
 struct Lighting;
 class ServerThread;
 class ServerModManager;
@@ -329,6 +332,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	virtual u16 allocateUnknownNodeId(const std::string &name);
 	IRollbackManager *getRollbackManager() { return m_rollback; }
 	virtual EmergeManager *getEmergeManager() { return m_emerge.get(); }
+	WorldPregen *getWorldPregen() { return m_pregen.get(); }
 	virtual ModStorageDatabase *getModStorageDatabase() { return m_mod_storage_database; }
 
 	IWritableItemDefManager* getWritableItemDefManager();
@@ -532,6 +536,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void SendItemDef(session_t peer_id, IItemDefManager *itemdef, u16 protocol_version);
 	void SendNodeDef(session_t peer_id, const NodeDefManager *nodedef,
 		u16 protocol_version);
+	void SendMapDictionary(session_t peer_id, const ZstdDictionary *dict);
 
 
 	virtual void SendChatMessage(session_t peer_id, const ChatMessage &message);
@@ -670,6 +675,8 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	float m_time_of_day_send_timer = 0.0f;
 	float m_liquid_transform_timer = 0.0f;
 	float m_liquid_transform_every = 1.0f;
+	// Fraction of a server step spent on deferred lighting
+	float m_deferred_lighting_time_budget = 0.2f;
 	float m_masterserver_timer = 0.0f;
 	float m_emergethread_trigger_timer = 0.0f;
 	float m_savemap_timer = 0.0f;
@@ -690,6 +697,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 
 	// Emerge manager
 	std::unique_ptr<EmergeManager> m_emerge;
+	std::unique_ptr<WorldPregen> m_pregen;
 
 	// Item definition manager
 	IWritableItemDefManager *m_itemdef;
@@ -718,6 +726,9 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	*/
 	ClientInterface m_clients;
 
+	// Active object message buffers of the clients, reused every step
+	server::AOMessageRouter m_aom_router;
+
 	std::unordered_map<session_t, std::string> m_formspec_state_data;
 
 	/*
@@ -61,6 +61,14 @@ void ActiveObjectMgr::step(
 	g_profiler->avg("ActiveObjectMgr: SAO count [#]", count);
 }
 
+void ActiveObjectMgr::forEach(const std::function<void(ServerActiveObject *)> &f)
+{
+	for (auto &ao_it : m_active_objects.iter()) {
+		if (ao_it.second)
+			f(ao_it.second.get());
+	}
+}
+
 bool ActiveObjectMgr::registerObject(std::unique_ptr<ServerActiveObject> obj)
 {
 	assert(obj); // Pre-condition
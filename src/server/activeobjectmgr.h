@@ -38,6 +38,9 @@ class ActiveObjectMgr final : public ::ActiveObjectMgr<ServerActiveObject>
 	bool registerObject(std::unique_ptr<ServerActiveObject> obj) override;
 	void removeObject(u16 id) override;
 
+	// Calls f for every object, in the order of their ids
+	void forEach(const std::function<void(ServerActiveObject *)> &f);
+
 	void invalidateActiveObjectObserverCaches();
 
 	void getObjectsInsideRadius(const v3f &pos, float radius,
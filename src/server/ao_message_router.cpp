@@ -0,0 +1,76 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "ao_message_router.h"
+#include "activeobject.h"
+#include "clientiface.h"
+#include "serveractiveobject.h"
+#include "exceptions.h"
+#include "util/serialize.h"
+
+namespace server
+{
+
+void AOMessageRouter::reset()
+{
+	m_count = 0;
+	m_index.clear();
+}
+
+void AOMessageRouter::addRecipient(RemoteClient *client, u16 player_id)
+{
+	if (m_count == m_recipients.size())
+		m_recipients.emplace_back();
+	Recipient &recipient = m_recipients[m_count];
+	recipient.client = client;
+	recipient.player_id = player_id;
+	recipient.reliable.clear();
+	recipient.unreliable.clear();
+	m_index[client->peer_id] = m_count++;
+}
+
+void AOMessageRouter::route(const ActiveObjectMessage &aom,
+	const ServerActiveObject *sao)
+{
+	const std::vector<session_t> &known_by = sao->getKnownBy();
+	if (known_by.empty())
+		return;
+
+	if (aom.datastring.size() > STRING_MAX_LEN)
+		throw SerializationError("String too long for serializeString16");
+
+	// u16 id
+	// std::string data
+	char header[4];
+	writeU16((u8 *)&header[0], aom.id);
+	writeU16((u8 *)&header[2], aom.datastring.size());
+
+	const bool is_position = !aom.datastring.empty() &&
+		aom.datastring[0] == AO_CMD_UPDATE_POSITION;
+	const ServerActiveObject *parent = is_position ? sao->getParent() : nullptr;
+
+	for (session_t peer_id : known_by) {
+		auto it = m_index.find(peer_id);
+		if (it == m_index.end())
+			continue;
+		Recipient &recipient = m_recipients[it->second];
+
+		// Send position updates to players who do not see the attachment
+		if (is_position) {
+			if (sao->getId() == recipient.player_id)
+				continue;
+
+			// Do not send position updates for attached players
+			// as long the parent is known to the client
+			const std::set<u16> &known = recipient.client->m_known_objects;
+			if (parent && known.find(parent->getId()) != known.end())
+				continue;
+		}
+
+		std::string &buffer = aom.reliable ? recipient.reliable : recipient.unreliable;
+		buffer.append(header, sizeof(header));
+		buffer.append(aom.datastring);
+	}
+}
+
+}
@@ -0,0 +1,62 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+
+class RemoteClient;
+class ServerActiveObject;
+struct ActiveObjectMessage;
+typedef u16 session_t;
+
+namespace server
+{
+
+/**
+ * Routes the active object messages of a server step to the clients.
+ *
+ * Each message goes straight to the buffers of the clients that know its
+ * object (ServerActiveObject::getKnownBy()), instead of checking every
+ * object against every client. The buffers are kept between steps so
+ * that they don't have to be allocated again.
+ */
+class AOMessageRouter
+{
+public:
+	struct Recipient {
+		RemoteClient *client = nullptr;
+		// Id of the client's player object, 0 if it has none
+		u16 player_id = 0;
+		// Messages to send, each one is u16 id and std::string data
+		std::string reliable;
+		std::string unreliable;
+	};
+
+	AOMessageRouter() = default;
+	DISABLE_CLASS_COPY(AOMessageRouter)
+
+	/// Starts a new step without any recipients
+	void reset();
+	void addRecipient(RemoteClient *client, u16 player_id);
+
+	/// Adds the message to the buffers of the recipients that know the
+	/// object it is from
+	void route(const ActiveObjectMessage &aom, const ServerActiveObject *sao);
+
+	/// The recipients, valid until the next reset()
+	const Recipient *begin() const { return m_recipients.data(); }
+	const Recipient *end() const { return m_recipients.data() + m_count; }
+
+private:
+	// Only the first m_count are in use
+	std::vector<Recipient> m_recipients;
+	size_t m_count = 0;
+	std::unordered_map<session_t, size_t> m_index;
+};
+
+}
@@ -382,6 +382,15 @@ void RemoteClient::GetNextBlocks (
 				continue;
 			}
 
+			/*
+				Wait until the deferred light update of the block is done.
+			*/
+			if (env->getServerMap().isLightingPending(p)) {
+				if (nearest_emerged_d == -1)
+					nearest_emerged_d = d;
+				continue;
+			}
+
 			if (nearest_sent_d == -1)
 				nearest_sent_d = d;
 
@@ -872,8 +881,8 @@ void ClientInterface::DeleteClient(session_t peer_id)
 		// Get object
 		ServerActiveObject* obj = m_env->getActiveObject(id);
 
-		if(obj && obj->m_known_by_count > 0)
-			obj->m_known_by_count--;
+		if (obj)
+			obj->removeKnownBy(peer_id);
 	}
 
 	// Delete client
@@ -110,6 +110,9 @@ void LuaEntitySAO::addedToEnvironment(u32 dtime_s)
 			luaentity_GetProperties(m_id, this, &m_prop, m_init_name);
 		// Initialize HP from properties
 		m_hp = m_prop.hp_max;
+		m_env->getScriptIface()->
+			luaentity_GetNativeStep(m_id, &m_native_step);
+		m_idle_position = m_base_position;
 		// Activate entity, supplying serialized state
 		m_env->getScriptIface()->
 			luaentity_Activate(m_id, m_init_state, dtime_s);
@@ -132,6 +135,14 @@ void LuaEntitySAO::dispatchScriptDeactivate(bool removal)
 		m_env->getScriptIface()->luaentity_Deactivate(m_id, removal);
 }
 
+// Whether a done move is still the one that the entity would do
+static bool is_same_move(const CollisionMoveJob &a, const CollisionMoveJob &b)
+{
+	return a.box == b.box && a.stepheight == b.stepheight &&
+		a.dtime == b.dtime && a.pos == b.pos && a.speed == b.speed &&
+		a.accel == b.accel && a.collide_with_objects == b.collide_with_objects;
+}
+
 void LuaEntitySAO::step(float dtime, bool send_recommended)
 {
 	if (!m_properties_sent) {
@@ -157,6 +168,9 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 
 	m_last_sent_position_timer += dtime;
 
+	std::optional<CollisionMoveJob> done_move;
+	done_move.swap(m_done_move);
+
 	collisionMoveResult moveresult, *moveresult_p = nullptr;
 
 	// Each frame, parent position is copied if the object is attached, otherwise it's calculated normally
@@ -167,23 +181,23 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 		m_acceleration = v3f(0,0,0);
 	} else {
 		if(m_prop.physical){
-			aabb3f box = m_prop.collisionbox;
-			box.MinEdge *= BS;
-			box.MaxEdge *= BS;
-			f32 pos_max_d = BS*0.25; // Distance per iteration
-			v3f p_pos = m_base_position;
-			v3f p_velocity = m_velocity;
-			v3f p_acceleration = m_acceleration;
-			moveresult = collisionMoveSimple(m_env, m_env->getGameDef(),
-					pos_max_d, box, m_prop.stepheight, dtime,
-					&p_pos, &p_velocity, p_acceleration,
-					this, m_prop.collideWithObjects);
+			CollisionMoveJob move;
+			getCollisionMove(dtime, move);
+			if (done_move && is_same_move(*done_move, move)) {
+				move = std::move(*done_move);
+			} else {
+				f32 pos_max_d = BS*0.25; // Distance per iteration
+				move.result = collisionMoveSimple(m_env, m_env->getGameDef(),
+						pos_max_d, move.box, move.stepheight, dtime,
+						&move.new_pos, &move.new_speed, move.accel,
+						this, move.collide_with_objects);
+			}
+			moveresult = std::move(move.result);
 			moveresult_p = &moveresult;
 
 			// Apply results
-			m_base_position = p_pos;
-			m_velocity = p_velocity;
-			m_acceleration = p_acceleration;
+			m_base_position = move.new_pos;
+			m_velocity = move.new_speed;
 		} else {
 			m_base_position += (m_velocity + m_acceleration * 0.5f * dtime) * dtime;
 			m_velocity += dtime * m_acceleration;
@@ -212,8 +226,16 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 				m_prop.automatic_rotate);
 	}
 
-	if(m_registered) {
-		m_env->getScriptIface()->luaentity_Step(m_id, dtime, moveresult_p);
+	if (m_registered) {
+		if (!stepNative(dtime))
+			return;
+
+		m_on_step_dtime += dtime;
+		if (isOnStepDue(moveresult_p)) {
+			float on_step_dtime = m_on_step_dtime;
+			m_on_step_dtime = 0.0f;
+			m_env->getScriptIface()->luaentity_Step(m_id, on_step_dtime, moveresult_p);
+		}
 	}
 
 	if (!send_recommended)
@@ -243,6 +265,51 @@ void LuaEntitySAO::step(float dtime, bool send_recommended)
 	sendOutdatedData();
 }
 
+bool LuaEntitySAO::stepNative(float dtime)
+{
+	if (m_native_step.timeout > 0.0f) {
+		m_active_time += dtime;
+		if (m_active_time > m_native_step.timeout) {
+			markForRemoval();
+			return false;
+		}
+	}
+
+	if (m_native_step.idle_timeout > 0.0f) {
+		// Idle until it moves a tenth of a node away. Attached entities
+		// move with their parent, they are never idle.
+		if (isAttached() ||
+				m_base_position.getDistanceFromSQ(m_idle_position) > 0.01f * BS * BS) {
+			m_idle_position = m_base_position;
+			m_idle_time = 0.0f;
+		} else {
+			m_idle_time += dtime;
+			if (m_idle_time > m_native_step.idle_timeout) {
+				markForRemoval();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool LuaEntitySAO::isOnStepDue(const collisionMoveResult *moveresult)
+{
+	const float interval = m_native_step.on_step_interval;
+	if (interval == 0.0f)
+		return true;
+
+	// Landing on something or starting to fall is handled right away
+	bool collided = false;
+	if (moveresult) {
+		collided = (moveresult->collides && !m_last_collides) ||
+			moveresult->touching_ground != m_last_touching_ground;
+		m_last_collides = moveresult->collides;
+		m_last_touching_ground = moveresult->touching_ground;
+	}
+	return collided || (interval > 0.0f && m_on_step_dtime >= interval);
+}
+
 std::string LuaEntitySAO::getClientInitializationData(u16 protocol_version)
 {
 	std::ostringstream os(std::ios::binary);
@@ -575,3 +642,28 @@ bool LuaEntitySAO::collideWithObjects() const
 {
 	return m_prop.collideWithObjects;
 }
+
+bool LuaEntitySAO::getCollisionMove(float dtime, CollisionMoveJob &move) const
+{
+	if (!m_prop.physical || getParent())
+		return false;
+
+	move.box = m_prop.collisionbox;
+	move.box.MinEdge *= BS;
+	move.box.MaxEdge *= BS;
+	move.stepheight = m_prop.stepheight;
+	move.dtime = dtime;
+	move.pos = m_base_position;
+	move.speed = m_velocity;
+	move.accel = m_acceleration;
+	move.self = const_cast<LuaEntitySAO *>(this);
+	move.collide_with_objects = m_prop.collideWithObjects;
+	move.new_pos = move.pos;
+	move.new_speed = move.speed;
+	return true;
+}
+
+void LuaEntitySAO::setCollisionMoveDone(CollisionMoveJob &&move)
+{
+	m_done_move = std::move(move);
+}
@@ -21,6 +21,24 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include "unit_sao.h"
+#include "collision.h"
+#include <optional>
+
+/*
+	Engine side behaviour of an entity, read from the `native_step` field of
+	its definition. Lets simple entities (dropped items, projectiles) skip
+	most of their Lua on_step calls.
+*/
+struct EntityNativeStep
+{
+	// Least time between on_step calls, with the dtime summed up in between.
+	// 0 calls it every server step, a negative value only on collisions.
+	float on_step_interval = 0.0f;
+	// Remove the entity this many seconds after its activation, 0 = never
+	float timeout = 0.0f;
+	// Remove the entity after it hasn't moved for this many seconds, 0 = never
+	float idle_timeout = 0.0f;
+};
 
 class LuaEntitySAO : public UnitSAO
 {
@@ -79,6 +97,12 @@ class LuaEntitySAO : public UnitSAO
 	bool getSelectionBox(aabb3f *toset) const;
 	bool collideWithObjects() const;
 
+	// Fills in the physics move of the next step(), returns false if there is none
+	bool getCollisionMove(float dtime, CollisionMoveJob &move) const;
+	// Done move from getCollisionMove(), used by the next step() if the entity
+	// hasn't changed in between
+	void setCollisionMoveDone(CollisionMoveJob &&move);
+
 protected:
 	void dispatchScriptDeactivate(bool removal);
 	virtual void onMarkedForDeactivation() {
@@ -92,6 +116,9 @@ class LuaEntitySAO : public UnitSAO
 
 private:
 	std::string getPropertyPacket();
+	// Returns false if the entity timed out and was removed
+	bool stepNative(float dtime);
+	bool isOnStepDue(const collisionMoveResult *moveresult);
 	void sendPosition(bool do_interpolate, bool is_movement_end);
 	std::string generateSetTextureModCommand() const;
 	static std::string generateSetSpriteCommand(v2s16 p, u16 num_frames,
@@ -112,4 +139,16 @@ class LuaEntitySAO : public UnitSAO
 
 	std::string m_texture_modifier;
 	bool m_texture_modifier_sent = false;
+
+	EntityNativeStep m_native_step;
+	// dtime since the last on_step call
+	float m_on_step_dtime = 0.0f;
+	bool m_last_collides = false;
+	bool m_last_touching_ground = false;
+	float m_active_time = 0.0f;
+	float m_idle_time = 0.0f;
+	v3f m_idle_position;
+
+	// Move done by ServerEnvironment ahead of the step
+	std::optional<CollisionMoveJob> m_done_move;
 };
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "inventory.h"
 #include "inventorymanager.h"
 #include "constants.h" // BS
+#include <algorithm>
 
 ServerActiveObject::ServerActiveObject(ServerEnvironment *env, v3f pos):
 	ActiveObject(0),
@@ -73,6 +74,23 @@ void ServerActiveObject::dumpAOMessagesToQueue(std::queue<ActiveObjectMessage> &
 	}
 }
 
+void ServerActiveObject::addKnownBy(session_t peer_id)
+{
+	m_known_by.push_back(peer_id);
+	m_known_by_count++;
+}
+
+void ServerActiveObject::removeKnownBy(session_t peer_id)
+{
+	auto it = std::find(m_known_by.begin(), m_known_by.end(), peer_id);
+	if (it != m_known_by.end()) {
+		*it = m_known_by.back();
+		m_known_by.pop_back();
+	}
+	if (m_known_by_count > 0)
+		m_known_by_count--;
+}
+
 void ServerActiveObject::markForRemoval()
 {
 	if (!m_pending_removal) {
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <cassert>
 #include <unordered_set>
+#include <vector>
 #include <optional>
 #include "irrlichttypes_bloated.h"
 #include "activeobject.h"
@@ -51,6 +52,7 @@ struct ObjectProperties;
 struct PlayerHPChangeReason;
 class Inventory;
 struct InventoryLocation;
+typedef u16 session_t;
 
 class ServerActiveObject : public ActiveObject
 {
@@ -213,6 +215,16 @@ class ServerActiveObject : public ActiveObject
 	*/
 	u16 m_known_by_count = 0;
 
+	/*
+		Peers of the clients which know about this object, the other side
+		of RemoteClient::m_known_objects. Active object messages are only
+		routed to these. Keeps m_known_by_count up to date.
+	*/
+	void addKnownBy(session_t peer_id);
+	void removeKnownBy(session_t peer_id);
+	const std::vector<session_t> &getKnownBy() const
+	{ return m_known_by; }
+
 	/*
 		A getter that unifies the above to answer the question:
 		"Can the environment still interact with this object?"
@@ -263,6 +275,9 @@ class ServerActiveObject : public ActiveObject
 	v3f m_base_position;
 	std::unordered_set<u32> m_attached_particle_spawners;
 
+	// Few enough that a vector beats a set
+	std::vector<session_t> m_known_by;
+
 	/*
 		Same purpose as m_pending_removal but for deactivation.
 		deactvation = save static data in block, remove active object
@@ -0,0 +1,285 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "world_pregen.h"
+#include <algorithm>
+#include <sstream>
+#include <vector>
+#include "filesys.h"
+#include "log.h"
+#include "map.h"
+#include "porting.h"
+#include "server.h"
+#include "serverenvironment.h"
+#include "servermap.h"
+#include "settings.h"
+#include "threading/mutex_auto_lock.h"
+#include "util/numeric.h"
+
+// Chunks queued per emerge thread, one being generated and one waiting
+constexpr size_t PREGEN_CHUNKS_PER_THREAD = 2;
+// Interval of unloading generated blocks (seconds)
+constexpr float PREGEN_UNLOAD_INTERVAL = 1.0f;
+// Interval of saving the map, the checkpoint and reporting the progress
+constexpr float PREGEN_CHECKPOINT_INTERVAL = 10.0f;
+// Blocks kept loaded per queued chunk, beyond that the oldest are unloaded
+constexpr s32 PREGEN_LOADED_BLOCKS_PER_CHUNK = 1024;
+
+WorldPregen::WorldPregen(Server *server, const std::string &world_path) :
+	m_server(server),
+	m_emerge(server->getEmergeManager()),
+	m_checkpoint_path(world_path + DIR_DELIM + "pregen.txt")
+{
+}
+
+WorldPregen::~WorldPregen()
+{
+	// The map is saved on shutdown, allow resuming from here
+	if (m_running)
+		writeCheckpoint();
+}
+
+bool WorldPregen::start(v3s16 minp, v3s16 maxp, bool shutdown_when_done)
+{
+	if (m_running)
+		return false;
+
+	m_shutdown_when_done = shutdown_when_done;
+
+	sortBoxVerticies(minp, maxp);
+	m_minp = minp;
+	m_maxp = maxp;
+
+	m_chunksize = m_emerge->mgparams->chunksize;
+	const v3s16 chunk_offset = v3s16(1, 1, 1) * (-m_chunksize / 2);
+	m_chunk_min = getContainerPos(getNodeBlockPos(minp) - chunk_offset, m_chunksize);
+	m_chunk_max = getContainerPos(getNodeBlockPos(maxp) - chunk_offset, m_chunksize);
+
+	const v3s16 extent = m_chunk_max - m_chunk_min + v3s16(1, 1, 1);
+	m_total = (u32)extent.X * extent.Y * extent.Z;
+	m_curve_side = 1;
+	while (m_curve_side < (u32)std::max(extent.X, extent.Z))
+		m_curve_side *= 2;
+	m_positions = m_curve_side * m_curve_side * extent.Y;
+
+	m_next = 0;
+	m_done_before = 0;
+	if (readCheckpoint()) {
+		for (u32 n = 0; n < m_next; n++) {
+			if (getChunkBlock(n, nullptr))
+				m_done_before++;
+		}
+		actionstream << "WorldPregen: Resuming at " << m_done_before << "/"
+			<< m_total << " chunks" << '\n';
+	}
+
+	{
+		MutexAutoLock lock(m_mutex);
+		m_queued.clear();
+		m_done = 0;
+		m_failed = 0;
+	}
+	m_start_time = porting::getTimeMs();
+	m_unload_timer = 0.0f;
+	m_checkpoint_timer = 0.0f;
+	m_running = true;
+
+	actionstream << "WorldPregen: Generating " << m_total << " chunks from "
+		<< minp << " to " << maxp << '\n';
+	return true;
+}
+
+void WorldPregen::cancel()
+{
+	if (!m_running)
+		return;
+	m_running = false;
+	{
+		// Chunks that are still queued finish without being counted
+		MutexAutoLock lock(m_mutex);
+		m_queued.clear();
+	}
+	if (fs::PathExists(m_checkpoint_path))
+		fs::DeleteSingleFileOrEmptyDirectory(m_checkpoint_path);
+	actionstream << "WorldPregen: Cancelled" << '\n';
+}
+
+WorldPregen::Status WorldPregen::getStatus()
+{
+	Status status;
+	status.running = m_running;
+	status.total = m_total;
+	MutexAutoLock lock(m_mutex);
+	status.done = m_done_before + m_done;
+	status.failed = m_failed;
+	u64 elapsed_ms = porting::getTimeMs() - m_start_time;
+	if (elapsed_ms > 0)
+		status.chunks_per_second = (m_done + m_failed) * 1000.0f / elapsed_ms;
+	return status;
+}
+
+void WorldPregen::step(float dtime)
+{
+	if (!m_running)
+		return;
+
+	// Keep every emerge thread busy
+	const size_t window = std::max<size_t>(m_emerge->getThreadCount(), 1) *
+		PREGEN_CHUNKS_PER_THREAD;
+	std::vector<v3s16> to_queue;
+	bool finished;
+	{
+		MutexAutoLock lock(m_mutex);
+		while (m_queued.size() < window && m_next < m_positions) {
+			u32 n = m_next++;
+			v3s16 blockpos;
+			if (!getChunkBlock(n, &blockpos))
+				continue;
+			// Before queueing, the callback can run right away
+			m_queued[blockpos] = n;
+			to_queue.push_back(blockpos);
+		}
+		finished = m_queued.empty() && m_next >= m_positions;
+	}
+
+	// Not locked, completion callbacks may run with the emerge queue locked
+	const u16 flags = BLOCK_EMERGE_ALLOW_GEN | BLOCK_EMERGE_FORCE_QUEUE;
+	for (v3s16 blockpos : to_queue) {
+		if (!m_emerge->enqueueBlockEmergeEx(blockpos, PEER_ID_INEXISTENT,
+				flags, onChunkEmerged, this)) {
+			MutexAutoLock lock(m_mutex);
+			m_queued.erase(blockpos);
+			m_failed++;
+		}
+	}
+
+	ServerMap &map = m_server->getEnv().getServerMap();
+
+	// Unload the oldest blocks, saving them in one go
+	m_unload_timer += dtime;
+	if (m_unload_timer >= PREGEN_UNLOAD_INTERVAL || finished) {
+		Server::EnvAutoLock lock(m_server);
+		s32 max_loaded_blocks = std::max<s32>(m_emerge->getThreadCount(), 1) *
+			PREGEN_CHUNKS_PER_THREAD * PREGEN_LOADED_BLOCKS_PER_CHUNK;
+		map.timerUpdate(m_unload_timer,
+			std::max(g_settings->getFloat("server_unload_unused_data_timeout"), 0.0f),
+			max_loaded_blocks);
+		m_unload_timer = 0.0f;
+	}
+
+	m_checkpoint_timer += dtime;
+	if (m_checkpoint_timer >= PREGEN_CHECKPOINT_INTERVAL && !finished) {
+		m_checkpoint_timer = 0.0f;
+		{
+			// Everything before the checkpoint must be on disk
+			Server::EnvAutoLock lock(m_server);
+			map.save(MOD_STATE_WRITE_NEEDED);
+		}
+		writeCheckpoint();
+
+		Status status = getStatus();
+		actionstream << "WorldPregen: " << status.done << "/" << status.total
+			<< " chunks (" << (status.done * 100 / std::max<u32>(status.total, 1))
+			<< "%), " << status.chunks_per_second << " chunks/s" << '\n';
+	}
+
+	if (finished)
+		finish();
+}
+
+void WorldPregen::finish()
+{
+	{
+		Server::EnvAutoLock lock(m_server);
+		m_server->getEnv().getServerMap().save(MOD_STATE_WRITE_NEEDED);
+	}
+	if (fs::PathExists(m_checkpoint_path))
+		fs::DeleteSingleFileOrEmptyDirectory(m_checkpoint_path);
+	m_running = false;
+
+	Status status = getStatus();
+	actionstream << "WorldPregen: Done, " << status.done << " chunks, "
+		<< status.failed << " failed, "
+		<< (porting::getTimeMs() - m_start_time) / 1000.0f << " s ("
+		<< status.chunks_per_second << " chunks/s)" << '\n';
+
+	if (m_shutdown_when_done)
+		m_server->requestShutdown("World pregeneration finished", false);
+}
+
+void WorldPregen::onChunkEmerged(v3s16 blockpos, EmergeAction action, void *param)
+{
+	WorldPregen *pregen = reinterpret_cast<WorldPregen *>(param);
+
+	MutexAutoLock lock(pregen->m_mutex);
+	// Not queued anymore if cancelled
+	if (!pregen->m_queued.erase(blockpos))
+		return;
+	if (action == EMERGE_CANCELLED || action == EMERGE_ERRORED)
+		pregen->m_failed++;
+	else
+		pregen->m_done++;
+}
+
+bool WorldPregen::getChunkBlock(u32 n, v3s16 *blockpos) const
+{
+	const u32 height = m_chunk_max.Y - m_chunk_min.Y + 1;
+	// Columns are done top to bottom, so that sunlight comes from above
+	v2u32 column = hilbert_curve_pos(m_curve_side, n / height);
+	v3s16 chunk(m_chunk_min.X + column.X, m_chunk_max.Y - n % height,
+		m_chunk_min.Z + column.Y);
+	if (chunk.X > m_chunk_max.X || chunk.Z > m_chunk_max.Z)
+		return false;
+
+	if (blockpos) {
+		const v3s16 chunk_offset = v3s16(1, 1, 1) * (-m_chunksize / 2);
+		*blockpos = chunk * m_chunksize + chunk_offset;
+	}
+	return true;
+}
+
+u32 WorldPregen::getResumePosition()
+{
+	MutexAutoLock lock(m_mutex);
+	u32 pos = m_next;
+	for (const auto &it : m_queued)
+		pos = std::min(pos, it.second);
+	return pos;
+}
+
+bool WorldPregen::readCheckpoint()
+{
+	Settings conf;
+	if (!fs::PathExists(m_checkpoint_path) ||
+			!conf.readConfigFile(m_checkpoint_path.c_str()))
+		return false;
+
+	v3f minp, maxp;
+	s32 chunksize;
+	u32 next;
+	if (!conf.getV3FNoEx("minp", minp) || !conf.getV3FNoEx("maxp", maxp) ||
+			!conf.getS32NoEx("chunksize", chunksize) ||
+			!conf.getU32NoEx("next", next))
+		return false;
+	// Only resume the same area
+	if (floatToInt(minp, 1.0f) != m_minp || floatToInt(maxp, 1.0f) != m_maxp ||
+			chunksize != m_chunksize)
+		return false;
+
+	m_next = std::min(next, m_positions);
+	return true;
+}
+
+void WorldPregen::writeCheckpoint()
+{
+	Settings conf;
+	conf.setV3F("minp", intToFloat(m_minp, 1.0f));
+	conf.setV3F("maxp", intToFloat(m_maxp, 1.0f));
+	conf.setS32("chunksize", m_chunksize);
+	conf.setU64("next", getResumePosition());
+
+	std::ostringstream os(std::ios_base::binary);
+	conf.writeLines(os);
+	if (!fs::safeWriteToFile(m_checkpoint_path, os.str()))
+		errorstream << "WorldPregen: Failed to write " << m_checkpoint_path << '\n';
+}
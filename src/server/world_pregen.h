@@ -0,0 +1,103 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include "irr_v3d.h"
+#include "emerge.h"
+#include "util/basic_macros.h"
+
+class Server;
+
+/**
+ * Generates a large area of the map as fast as possible, for
+ * pre-generating a world before it is opened to players.
+ *
+ * Unlike emerge_area, only one block per mapchunk is queued and the chunks
+ * are visited along a Hilbert curve so that the neighbours a mapgen reads
+ * are usually still loaded. A small window of chunks is kept queued to
+ * keep the emerge threads busy, generated blocks are saved in batches and
+ * the progress is written to a checkpoint file to resume from.
+ *
+ * Driven by the server step.
+ */
+class WorldPregen
+{
+public:
+	struct Status {
+		bool running = false;
+		u32 total = 0;
+		u32 done = 0;
+		u32 failed = 0;
+		// Average since the start (or resume)
+		float chunks_per_second = 0.0f;
+	};
+
+	WorldPregen(Server *server, const std::string &world_path);
+	~WorldPregen();
+
+	DISABLE_CLASS_COPY(WorldPregen)
+
+	/// Starts generating the area between the given node positions.
+	/// Resumes from the checkpoint if it covers the same area.
+	/// @param shutdown_when_done shut the server down afterwards (headless mode)
+	/// @return false if a pregeneration is running already
+	bool start(v3s16 minp, v3s16 maxp, bool shutdown_when_done = false);
+	/// Stops and forgets the progress
+	void cancel();
+
+	bool isRunning() const { return m_running; }
+	Status getStatus();
+
+	/// Called by the server step
+	void step(float dtime);
+
+private:
+	static void onChunkEmerged(v3s16 blockpos, EmergeAction action, void *param);
+
+	// Block to emerge for the n-th position, returns false if n is not
+	// a chunk of the area
+	bool getChunkBlock(u32 n, v3s16 *blockpos) const;
+	// Lowest position that is not done yet
+	u32 getResumePosition();
+
+	bool readCheckpoint();
+	void writeCheckpoint();
+	void finish();
+
+	Server *m_server;
+	EmergeManager *m_emerge;
+	const std::string m_checkpoint_path;
+
+	std::atomic<bool> m_running {false};
+	bool m_shutdown_when_done = false;
+	v3s16 m_minp, m_maxp;
+
+	// Area in mapchunk coordinates
+	v3s16 m_chunk_min, m_chunk_max;
+	s16 m_chunksize = 0;
+	// Side of the square covered by the Hilbert curve
+	u32 m_curve_side = 0;
+	// Number of positions (chunks and gaps outside of the area)
+	u32 m_positions = 0;
+	// Next position to queue
+	u32 m_next = 0;
+
+	u32 m_total = 0;
+	u32 m_done_before = 0;
+	u64 m_start_time = 0;
+
+	float m_unload_timer = 0.0f;
+	float m_checkpoint_timer = 0.0f;
+
+	// Accessed by the emerge threads, protected by m_mutex
+	std::mutex m_mutex;
+	// Queued block -> position
+	std::map<v3s16, u32> m_queued;
+	u32 m_done = 0;
+	u32 m_failed = 0;
+};
@@ -38,6 +38,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/basic_macros.h"
 #include "util/pointedthing.h"
 #include "threading/mutex_auto_lock.h"
+#include "threading/task_pool.h"
+#include "collision.h"
 #include "filesys.h"
 #include "gameparams.h"
 #include "database/database-dummy.h"
@@ -1618,6 +1620,7 @@ void ServerEnvironment::step(float dtime)
 	/*
 		Step active objects
 	*/
+	moveEntities(dtime);
 	{
 		ScopeProfiler sp(g_profiler, "ServerEnv: Run SAO::step()", SPT_AVG);
 
@@ -2011,6 +2014,31 @@ u16 ServerEnvironment::addActiveObjectRaw(std::unique_ptr<ServerActiveObject> ob
 	return object->getId();
 }
 
+void ServerEnvironment::moveEntities(float dtime)
+{
+	ScopeProfiler sp(g_profiler, "ServerEnv: move entities", SPT_AVG);
+
+	std::vector<LuaEntitySAO *> entities;
+	std::vector<CollisionMoveJob> moves;
+	m_ao_manager.forEach([&] (ServerActiveObject *obj) {
+		if (obj->isGone() || obj->getType() != ACTIVEOBJECT_TYPE_LUAENTITY)
+			return;
+		auto *entity = static_cast<LuaEntitySAO *>(obj);
+		moves.emplace_back();
+		if (entity->getCollisionMove(dtime, moves.back()))
+			entities.push_back(entity);
+		else
+			moves.pop_back();
+	});
+	if (moves.empty())
+		return;
+
+	collisionMoveBatch(this, m_server, moves, &TaskPool::getShared());
+
+	for (size_t i = 0; i < moves.size(); i++)
+		entities[i]->setCollisionMoveDone(std::move(moves[i]));
+}
+
 /*
 	Remove objects that satisfy (isGone() && m_known_by_count==0)
 */
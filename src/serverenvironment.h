@@ -439,6 +439,12 @@ class ServerEnvironment final : public Environment
 	*/
 	void removeRemovedObjects();
 
+	/*
+		Do the collision moves of all physical entities for their next
+		step(), at once
+	*/
+	void moveEntities(float dtime);
+
 	/*
 		Convert stored objects from block to active
 	*/
@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "profiler.h"
 #include "gamedef.h"
 #include "util/directiontables.h"
+#include "util/stream.h"
 #include "rollback_interface.h"
 #include "reflowscan.h"
 #include "emerge.h"
@@ -114,6 +115,13 @@ ServerMap::ServerMap(const std::string &savedir, IGameDef *gamedef,
 
 	m_map_compression_level = rangelim(g_settings->getS16("map_compression_level_disk"), -1, 9);
 
+	m_lighting_deferral_enabled = g_settings->getBool("deferred_lighting");
+
+	// Always load the dictionary (if any), blocks may already use it
+	m_map_dictionary = loadMapDictionary(savedir);
+	m_map_dictionary_enabled = m_map_dictionary &&
+		g_settings->getBool("map_compression_dictionary");
+
 	try {
 		// If directory exists, check contents and load if possible
 		if (fs::PathExists(m_savedir)) {
@@ -160,6 +168,12 @@ ServerMap::~ServerMap()
 
 	try
 	{
+		// Do not save blocks with outdated light
+		if (!m_lighting_queue.empty()) {
+			std::map<v3s16, MapBlock*> modified_blocks;
+			processDeferredLighting(U32_MAX, modified_blocks);
+		}
+
 		if (m_map_saving_enabled) {
 			// Save only changed parts
 			save(MOD_STATE_WRITE_AT_UNLOAD);
@@ -260,6 +274,8 @@ bool ServerMap::initBlockMake(v3s16 blockpos, BlockMakeData *data)
 				bool ug = m_emerge->isBlockUnderground(p);
 				block->setIsUnderground(ug);
 			}
+			// In use until finishBlockMake(), don't unload it before
+			block->refGrab();
 		}
 	}
 
@@ -337,6 +353,15 @@ void ServerMap::finishBlockMake(BlockMakeData *data,
 	*/
 	//save(MOD_STATE_WRITE_AT_UNLOAD);
 	m_chunks_in_progress.erase(bpmin);
+
+	// Release the blocks grabbed by initBlockMake()
+	for (s16 x = bpmin.X - 1; x <= bpmax.X + 1; x++)
+	for (s16 z = bpmin.Z - 1; z <= bpmax.Z + 1; z++)
+	for (s16 y = bpmin.Y - 1; y <= bpmax.Y + 1; y++) {
+		MapBlock *block = getBlockNoCreateNoEx(v3s16(x, y, z));
+		if (block)
+			block->refDrop();
+	}
 }
 
 MapSector *ServerMap::createSector(v2s16 p2d)
@@ -631,10 +656,11 @@ bool ServerMap::saveBlock(MapBlock *block)
 {
 	// FIXME: serialization happens under mutex
 	MutexAutoLock dblock(m_db.mutex);
-	return saveBlock(block, m_db.dbase, m_map_compression_level);
+	return saveBlock(block, m_db.dbase, m_map_compression_level, getMapDictionary());
 }
 
-bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_level)
+bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_level,
+		const ZstdDictionary *dict)
 {
 	v3s16 p3d = block->getPos();
 
@@ -645,12 +671,14 @@ bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_leve
 		[0] u8 serialization version
 		[1] data
 	*/
-	std::ostringstream o(std::ios_base::binary);
+	thread_local std::string blob;
+	blob.clear();
+	StringAppendStreamBuffer sb(blob);
+	std::ostream o(&sb);
 	o.write((char*) &version, 1);
-	block->serialize(o, version, true, compression_level);
+	block->serialize(o, version, true, compression_level, dict);
 
-	// FIXME: zero copy possible in c++20 or with custom rdbuf
-	bool ret = db->saveBlock(p3d, o.str());
+	bool ret = db->saveBlock(p3d, blob);
 	if (ret) {
 		// We just wrote it to the disk so clear modified flag
 		block->resetModified();
@@ -658,6 +686,31 @@ bool ServerMap::saveBlock(MapBlock *block, MapDatabase *db, int compression_leve
 	return ret;
 }
 
+std::string ServerMap::getMapDictionaryPath(const std::string &savedir)
+{
+	return savedir + DIR_DELIM + "map_dictionary.bin";
+}
+
+std::shared_ptr<ZstdDictionary> ServerMap::loadMapDictionary(const std::string &savedir)
+{
+	std::string data;
+	const std::string path = getMapDictionaryPath(savedir);
+	if (!fs::PathExists(path) || !fs::ReadFile(path, data))
+		return nullptr;
+
+	try {
+		auto dict = std::make_shared<ZstdDictionary>(data);
+		registerZstdDictionary(dict);
+		infostream << "ServerMap: Loaded map dictionary " << dict->getId()
+			<< " (" << data.size() << " bytes)" << '\n';
+		return dict;
+	} catch (SerializationError &e) {
+		errorstream << "ServerMap: Failed to load " << path << ": "
+			<< e.what() << '\n';
+		return nullptr;
+	}
+}
+
 void ServerMap::deSerializeBlock(MapBlock *block, std::istream &is)
 {
 	ScopeProfiler sp(g_profiler, "ServerMap: deSer block", SPT_AVG, PRECISION_MICRO);
@@ -687,7 +740,8 @@ MapBlock *ServerMap::loadBlock(const std::string &blob, v3s16 p3d, bool save_aft
 		}
 
 		{
-			std::istringstream iss(blob, std::ios_base::binary);
+			StringViewStreamBuffer sb(blob);
+			std::istream iss(&sb);
 			deSerializeBlock(block, iss);
 		}
 
@@ -759,6 +813,8 @@ bool ServerMap::deleteBlock(v3s16 blockpos)
 		return false;
 
 	MapBlock *block = getBlockNoCreateNoEx(blockpos);
+	if (block && m_lighting_pending.erase(blockpos))
+		block->refDrop();
 	if (block) {
 		v2s16 p2d(blockpos.X, blockpos.Z);
 		MapSector *sector = getSectorNoGenerate(p2d);
@@ -804,6 +860,106 @@ bool ServerMap::repairBlockLight(v3s16 blockpos,
 	return true;
 }
 
+/*
+	Deferred lighting
+*/
+
+// Edge length of the largest area relit at once, in blocks
+constexpr s16 DEFERRED_LIGHTING_MAX_SIZE = 4;
+// Queued areas are only merged if the result is not larger than this
+constexpr s32 DEFERRED_LIGHTING_MAX_VOLUME = 64;
+// Number of recently queued areas that are considered for merging
+constexpr size_t DEFERRED_LIGHTING_MERGE_LOOKBACK = 8;
+
+void ServerMap::deferLighting(const VoxelArea &blocks)
+{
+	if (blocks.hasEmptyExtent())
+		return;
+
+	// Split large areas so that relighting one takes a bounded amount of time
+	const s16 size = DEFERRED_LIGHTING_MAX_SIZE;
+	v3s16 p;
+	for (p.Z = blocks.MinEdge.Z; p.Z <= blocks.MaxEdge.Z; p.Z += size)
+	for (p.Y = blocks.MinEdge.Y; p.Y <= blocks.MaxEdge.Y; p.Y += size)
+	for (p.X = blocks.MinEdge.X; p.X <= blocks.MaxEdge.X; p.X += size) {
+		v3s16 last = componentwise_min(p + (size - 1), blocks.MaxEdge);
+		queueLightingArea(VoxelArea(p, last));
+	}
+}
+
+void ServerMap::queueLightingArea(const VoxelArea &area)
+{
+	bool added = false;
+	v3s16 p;
+	for (p.Z = area.MinEdge.Z; p.Z <= area.MaxEdge.Z; p.Z++)
+	for (p.Y = area.MinEdge.Y; p.Y <= area.MaxEdge.Y; p.Y++)
+	for (p.X = area.MinEdge.X; p.X <= area.MaxEdge.X; p.X++) {
+		MapBlock *block = getBlockNoCreateNoEx(p);
+		if (!block || !m_lighting_pending.insert(p).second)
+			continue;
+		// Keep the block loaded until it was relit
+		block->refGrab();
+		added = true;
+	}
+	// Everything is queued already (or not loaded)
+	if (!added)
+		return;
+
+	// Coalesce with a recently queued area nearby, as long as it stays small
+	size_t lookback = std::min(m_lighting_queue.size(),
+			DEFERRED_LIGHTING_MERGE_LOOKBACK);
+	for (auto it = m_lighting_queue.rbegin(); lookback-- > 0; ++it) {
+		VoxelArea padded = *it;
+		padded.pad(v3s16(1, 1, 1));
+		if (padded.intersect(area).hasEmptyExtent())
+			continue;
+		VoxelArea merged = *it;
+		merged.addArea(area);
+		if (merged.getVolume() > DEFERRED_LIGHTING_MAX_VOLUME)
+			continue;
+		*it = merged;
+		return;
+	}
+	m_lighting_queue.push_back(area);
+}
+
+void ServerMap::processDeferredLighting(u32 max_time_ms,
+		std::map<v3s16, MapBlock*> &modified_blocks)
+{
+	const u64 start_time = porting::getTimeMs();
+	while (!m_lighting_queue.empty()) {
+		VoxelArea area = m_lighting_queue.front();
+		m_lighting_queue.pop_front();
+
+		voxalgo::repair_area_light(this, area.MinEdge, area.MaxEdge,
+				&modified_blocks);
+
+		v3s16 p;
+		for (p.Z = area.MinEdge.Z; p.Z <= area.MaxEdge.Z; p.Z++)
+		for (p.Y = area.MinEdge.Y; p.Y <= area.MaxEdge.Y; p.Y++)
+		for (p.X = area.MinEdge.X; p.X <= area.MaxEdge.X; p.X++) {
+			if (!m_lighting_pending.erase(p))
+				continue;
+			MapBlock *block = getBlockNoCreateNoEx(p);
+			if (block)
+				block->refDrop();
+		}
+
+		if (porting::getTimeMs() - start_time >= max_time_ms)
+			break;
+	}
+}
+
+bool ServerMap::deferLightingUpdate(v3s16 blockpos)
+{
+	if (m_defer_lighting) {
+		deferLighting(VoxelArea(blockpos, blockpos));
+		return true;
+	}
+	// The block is relit anyway
+	return isLightingPending(blockpos);
+}
+
 /*
 	Liquids
 */
@@ -19,10 +19,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #pragma once
 
+#include <deque>
 #include <vector>
 #include <memory>
+#include <unordered_set>
 
 #include "map.h"
+#include "voxel.h"
+#include "util/basic_macros.h"
 #include "util/container.h"
 #include "util/metricsbackend.h"
 #include "map_settings_manager.h"
@@ -34,6 +38,7 @@ class EmergeManager;
 class ServerEnvironment;
 struct BlockMakeData;
 class MetricsBackend;
+class ZstdDictionary;
 
 // TODO: this could wrap all calls to MapDatabase, including locking
 struct MapDatabaseAccessor {
@@ -126,7 +131,20 @@ class ServerMap : public Map
 	MapgenParams *getMapgenParams();
 
 	bool saveBlock(MapBlock *block) override;
-	static bool saveBlock(MapBlock *block, MapDatabase *db, int compression_level = -1);
+	static bool saveBlock(MapBlock *block, MapDatabase *db, int compression_level = -1,
+			const ZstdDictionary *dict = nullptr);
+
+	/*
+		Trained zstd dictionary of the world (see --train-map-dictionary)
+	*/
+	static std::string getMapDictionaryPath(const std::string &savedir);
+	// Loads and registers the dictionary, returns nullptr if there is none
+	static std::shared_ptr<ZstdDictionary> loadMapDictionary(const std::string &savedir);
+	// Dictionary to compress blocks with, nullptr if unavailable or disabled
+	const ZstdDictionary *getMapDictionary() const
+	{
+		return m_map_dictionary_enabled ? m_map_dictionary.get() : nullptr;
+	}
 
 	// Load block in a synchronous fashion
 	MapBlock *loadBlock(v3s16 p);
@@ -166,6 +184,31 @@ class ServerMap : public Map
 	bool repairBlockLight(v3s16 blockpos,
 		std::map<v3s16, MapBlock *> *modified_blocks);
 
+	/*
+		Deferred lighting (see the deferred_lighting setting)
+
+		Queued areas keep their blocks loaded and are not sent to
+		clients until they were relit.
+	*/
+	bool isLightingDeferralEnabled() const { return m_lighting_deferral_enabled; }
+	// While set, light updates of changed nodes are queued.
+	// Returns the previous value.
+	bool setDeferLighting(bool defer)
+	{
+		std::swap(m_defer_lighting, defer);
+		return defer;
+	}
+	// Queues the light update of an area in block coordinates
+	void deferLighting(const VoxelArea &blocks);
+	bool isLightingPending(v3s16 blockpos) const
+	{
+		return m_lighting_pending.count(blockpos) != 0;
+	}
+	size_t getDeferredLightingCount() const { return m_lighting_queue.size(); }
+	// Relights queued areas until max_time_ms has passed (at least one area)
+	void processDeferredLighting(u32 max_time_ms,
+			std::map<v3s16, MapBlock*> &modified_blocks);
+
 	void transformLiquids(std::map<v3s16, MapBlock*> & modified_blocks,
 			ServerEnvironment *env);
 
@@ -177,6 +220,8 @@ class ServerMap : public Map
 
 	void reportMetrics(u64 save_time_us, u32 saved_blocks, u32 all_blocks) override;
 
+	bool deferLightingUpdate(v3s16 blockpos) override;
+
 private:
 	friend class ModApiMapgen; // for m_transforming_liquid
 
@@ -187,6 +232,8 @@ class ServerMap : public Map
 	bool m_map_saving_enabled;
 
 	int m_map_compression_level;
+	std::shared_ptr<ZstdDictionary> m_map_dictionary;
+	bool m_map_dictionary_enabled = false;
 
 	std::set<v3s16> m_chunks_in_progress;
 
@@ -200,6 +247,15 @@ class ServerMap : public Map
 	u64 m_inc_trending_up_start_time = 0; // milliseconds
 	bool m_queue_size_timer_started = false;
 
+	// Queued light updates, areas in block coordinates
+	std::deque<VoxelArea> m_lighting_queue;
+	// Blocks waiting in m_lighting_queue, these hold a reference
+	std::unordered_set<v3s16> m_lighting_pending;
+	bool m_lighting_deferral_enabled = false;
+	bool m_defer_lighting = false;
+
+	void queueLightingArea(const VoxelArea &area);
+
 	/*
 		Metadata is re-written on disk only if this is true.
 		This is reset to false when written on disk.
@@ -213,3 +269,23 @@ class ServerMap : public Map
 	MetricCounterPtr m_save_time_counter;
 	MetricCounterPtr m_save_count_counter;
 };
+
+/*
+	Queues the light updates of node changes made while in scope,
+	if deferred lighting is enabled.
+*/
+class DeferLightingScope
+{
+public:
+	DeferLightingScope(ServerMap *map) : m_map(map)
+	{
+		m_prev = m_map->setDeferLighting(m_map->isLightingDeferralEnabled());
+	}
+	~DeferLightingScope() { m_map->setDeferLighting(m_prev); }
+
+	DISABLE_CLASS_COPY(DeferLightingScope)
+
+private:
+	ServerMap *m_map;
+	bool m_prev;
+};
@@ -0,0 +1,109 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "threading/task_pool.h"
+#include "threading/thread.h"
+#include <algorithm>
+
+class TaskPoolThread : public Thread
+{
+public:
+	TaskPoolThread(TaskPool *pool) : Thread("TaskPool"), m_pool(pool) {}
+
+protected:
+	void *run()
+	{
+		std::unique_lock<std::mutex> lock(m_pool->m_mutex);
+		for (;;) {
+			m_pool->m_work_cv.wait(lock, [this] {
+				return m_pool->m_stop || !m_pool->m_queue.empty();
+			});
+			if (m_pool->m_stop)
+				break;
+			m_pool->runOne(lock);
+		}
+		return nullptr;
+	}
+
+private:
+	TaskPool *m_pool;
+};
+
+TaskPool::TaskPool(unsigned int num_workers)
+{
+	for (unsigned int i = 0; i < num_workers; i++) {
+		m_workers.emplace_back(new TaskPoolThread(this));
+		m_workers.back()->start();
+	}
+}
+
+TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_work_cv.notify_all();
+	for (auto &worker : m_workers)
+		worker->wait();
+}
+
+TaskPool &TaskPool::getShared()
+{
+	// Leave one core for the calling thread, more than a few workers don't
+	// pay off for the short jobs this is meant for.
+	static TaskPool pool(std::clamp(Thread::getNumberOfProcessors(), 1U, 5U) - 1);
+	return pool;
+}
+
+void TaskPool::runOne(std::unique_lock<std::mutex> &lock)
+{
+	Batch *batch = m_queue.front();
+	size_t i = batch->next++;
+	if (batch->next == batch->tasks->size())
+		m_queue.pop_front();
+
+	lock.unlock();
+	std::exception_ptr error;
+	try {
+		(*batch->tasks)[i]();
+	} catch (...) {
+		error = std::current_exception();
+	}
+	lock.lock();
+
+	batch->errors[i] = error;
+	if (++batch->done == batch->tasks->size())
+		m_done_cv.notify_all();
+}
+
+void TaskPool::run(const std::vector<std::function<void()>> &tasks)
+{
+	if (tasks.empty())
+		return;
+
+	if (m_workers.empty() || tasks.size() == 1) {
+		for (auto &task : tasks)
+			task();
+		return;
+	}
+
+	Batch batch;
+	batch.tasks = &tasks;
+	batch.errors.resize(tasks.size());
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_queue.push_back(&batch);
+	m_work_cv.notify_all();
+
+	// Help out until all tasks of this batch have been picked up
+	while (batch.next < tasks.size())
+		runOne(lock);
+	m_done_cv.wait(lock, [&] { return batch.done == tasks.size(); });
+	lock.unlock();
+
+	for (auto &error : batch.errors) {
+		if (error)
+			std::rethrow_exception(error);
+	}
+}
@@ -0,0 +1,64 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "util/basic_macros.h"
+
+class TaskPoolThread;
+
+/**
+ * A set of worker threads for splitting up work that a caller waits for,
+ * e.g. a large map operation within a server step.
+ *
+ * Tasks must not depend on each other finishing, the calling thread takes
+ * part in running them and nothing is guaranteed to run concurrently.
+ */
+class TaskPool
+{
+	friend class TaskPoolThread;
+public:
+	TaskPool(unsigned int num_workers);
+	~TaskPool();
+
+	DISABLE_CLASS_COPY(TaskPool)
+
+	/// Pool shared by the engine, workers are started on first use.
+	/// It has no workers on single core machines.
+	static TaskPool &getShared();
+
+	unsigned int getWorkerCount() const { return m_workers.size(); }
+
+	/**
+	 * Runs all tasks and returns once they are finished.
+	 * If tasks throw, the first exception (in task order) is rethrown after
+	 * all tasks have ended.
+	 */
+	void run(const std::vector<std::function<void()>> &tasks);
+
+private:
+	struct Batch {
+		const std::vector<std::function<void()>> *tasks;
+		std::vector<std::exception_ptr> errors;
+		size_t next = 0;
+		size_t done = 0;
+	};
+
+	// Runs one task of the front batch, lock must be held
+	void runOne(std::unique_lock<std::mutex> &lock);
+
+	std::mutex m_mutex;
+	std::condition_variable m_work_cv;
+	std::condition_variable m_done_cv;
+	std::deque<Batch *> m_queue;
+	bool m_stop = false;
+
+	std::vector<std::unique_ptr<TaskPoolThread>> m_workers;
+};
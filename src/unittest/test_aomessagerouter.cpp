@@ -0,0 +1,132 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+#include "mock_serveractiveobject.h"
+
+#include "server/ao_message_router.h"
+#include "server/clientiface.h"
+#include "util/serialize.h"
+
+class TestAOMessageRouter : public TestBase
+{
+public:
+	TestAOMessageRouter() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestAOMessageRouter"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testKnownBy();
+	void testRoute();
+};
+
+static TestAOMessageRouter g_test_instance;
+
+void TestAOMessageRouter::runTests(IGameDef *gamedef)
+{
+	TEST(testKnownBy);
+	TEST(testRoute);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+class AttachedObject : public MockServerActiveObject
+{
+public:
+	ServerActiveObject *parent = nullptr;
+
+	ServerActiveObject *getParent() const override { return parent; }
+};
+
+std::string encode(u16 id, const std::string &data)
+{
+	char buf[2];
+	writeU16((u8 *)buf, id);
+	return std::string(buf, 2) + serializeString16(data);
+}
+
+}
+
+void TestAOMessageRouter::testKnownBy()
+{
+	MockServerActiveObject obj;
+	obj.addKnownBy(3);
+	obj.addKnownBy(5);
+	obj.addKnownBy(7);
+	UASSERTEQ(u16, obj.m_known_by_count, 3);
+
+	obj.removeKnownBy(5);
+	UASSERTEQ(u16, obj.m_known_by_count, 2);
+	UASSERTEQ(size_t, obj.getKnownBy().size(), 2);
+	UASSERT(std::find(obj.getKnownBy().begin(), obj.getKnownBy().end(), 5) ==
+		obj.getKnownBy().end());
+
+	obj.removeKnownBy(3);
+	obj.removeKnownBy(7);
+	UASSERTEQ(u16, obj.m_known_by_count, 0);
+	UASSERT(obj.getKnownBy().empty());
+}
+
+void TestAOMessageRouter::testRoute()
+{
+	RemoteClient clients[3];
+	for (int i = 0; i < 3; i++)
+		clients[i].peer_id = 10 + i;
+
+	// The player of client 0 rides on the object of client 1
+	MockServerActiveObject boat;
+	AttachedObject player0, player1;
+	boat.setId(1);
+	player0.setId(2);
+	player1.setId(3);
+	player0.parent = &boat;
+
+	// Client 0 knows everything, client 1 only the players, client 2 nothing
+	for (ServerActiveObject *obj : {(ServerActiveObject *)&boat,
+			(ServerActiveObject *)&player0, (ServerActiveObject *)&player1}) {
+		clients[0].m_known_objects.insert(obj->getId());
+		obj->addKnownBy(clients[0].peer_id);
+	}
+	for (ServerActiveObject *obj : {(ServerActiveObject *)&player0,
+			(ServerActiveObject *)&player1}) {
+		clients[1].m_known_objects.insert(obj->getId());
+		obj->addKnownBy(clients[1].peer_id);
+	}
+
+	const std::string pos(1, (char)AO_CMD_UPDATE_POSITION);
+	const std::string anim(1, (char)AO_CMD_SET_ANIMATION);
+
+	server::AOMessageRouter router;
+	for (int step = 0; step < 2; step++) {
+		router.reset();
+		router.addRecipient(&clients[0], player0.getId());
+		router.addRecipient(&clients[1], player1.getId());
+		router.addRecipient(&clients[2], 0);
+
+		router.route(ActiveObjectMessage(boat.getId(), false, pos + "b"), &boat);
+		router.route(ActiveObjectMessage(player0.getId(), false, pos + "0"), &player0);
+		router.route(ActiveObjectMessage(player1.getId(), false, pos + "1"), &player1);
+		router.route(ActiveObjectMessage(player0.getId(), true, anim + "0"), &player0);
+
+		std::vector<const server::AOMessageRouter::Recipient *> recipients;
+		for (const auto &recipient : router)
+			recipients.push_back(&recipient);
+		UASSERTEQ(size_t, recipients.size(), 3);
+
+		// Not its own position, not the one of a player attached to a known
+		// object
+		UASSERT(recipients[0]->client == &clients[0]);
+		UASSERT(recipients[0]->unreliable == encode(boat.getId(), pos + "b") +
+			encode(player1.getId(), pos + "1"));
+		UASSERT(recipients[0]->reliable == encode(player0.getId(), anim + "0"));
+
+		// The boat is unknown, so the position of the attached player is sent
+		UASSERT(recipients[1]->unreliable == encode(player0.getId(), pos + "0"));
+		UASSERT(recipients[1]->reliable == encode(player0.getId(), anim + "0"));
+
+		UASSERT(recipients[2]->unreliable.empty());
+		UASSERT(recipients[2]->reliable.empty());
+	}
+}
@@ -0,0 +1,121 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "mapgen/mg_biome.h"
+#include "pcg_random.h"
+
+class TestBiome : public TestBase
+{
+public:
+	TestBiome() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestBiome"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testLookupEmpty();
+	void testLookupMatchesScan();
+};
+
+static TestBiome g_test_instance;
+
+void TestBiome::runTests(IGameDef *gamedef)
+{
+	TEST(testLookupEmpty);
+	TEST(testLookupMatchesScan);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// What BiomeGenOriginal::calcBiomeFromNoise() did before BiomeLookup
+static BiomeLookup::Result find_by_scan(const std::vector<const Biome *> &biomes,
+	float heat, float humidity, v3s16 pos)
+{
+	BiomeLookup::Result result;
+	for (size_t i = 1; i < biomes.size(); i++) {
+		const Biome *b = biomes[i];
+		if (!b ||
+				pos.Y < b->min_pos.Y || pos.Y > b->max_pos.Y + b->vertical_blend ||
+				pos.X < b->min_pos.X || pos.X > b->max_pos.X ||
+				pos.Z < b->min_pos.Z || pos.Z > b->max_pos.Z)
+			continue;
+
+		float d_heat = heat - b->heat_point;
+		float d_humidity = humidity - b->humidity_point;
+		float dist = (d_heat * d_heat) + (d_humidity * d_humidity);
+
+		if (pos.Y <= b->max_pos.Y) {
+			if (dist < result.dist) {
+				result.dist = dist;
+				result.closest = i;
+			}
+		} else if (dist < result.dist_blend) {
+			result.dist_blend = dist;
+			result.closest_blend = i;
+		}
+	}
+	return result;
+}
+
+void TestBiome::testLookupEmpty()
+{
+	std::vector<const Biome *> biomes{nullptr};
+	BiomeLookup lookup(biomes);
+	BiomeLookup::Result result = lookup.find(50.0f, 50.0f, v3s16(0, 0, 0));
+	UASSERTEQ(biome_t, result.closest, BIOME_NONE);
+	UASSERTEQ(biome_t, result.closest_blend, BIOME_NONE);
+}
+
+void TestBiome::testLookupMatchesScan()
+{
+	PcgRandom pr(42);
+	const s16 limits_y[] = {-MAX_MAP_GENERATION_LIMIT, -256, -64, -1, 0, 31, 128,
+		MAX_MAP_GENERATION_LIMIT};
+
+	std::vector<std::unique_ptr<Biome>> owned;
+	std::vector<const Biome *> biomes{nullptr};
+	for (int i = 0; i < 150; i++) {
+		Biome *b = new Biome;
+		owned.emplace_back(b);
+		// Some share a point to test ties
+		if (i % 10 == 0) {
+			b->heat_point = pr.range(0, 4) * 25;
+			b->humidity_point = pr.range(0, 4) * 25;
+		} else {
+			b->heat_point = pr.range(0, 10000) / 100.0f;
+			b->humidity_point = pr.range(0, 10000) / 100.0f;
+		}
+		s16 y1 = limits_y[pr.range(0, 7)], y2 = limits_y[pr.range(0, 7)];
+		b->min_pos = v3s16(-MAX_MAP_GENERATION_LIMIT, std::min(y1, y2),
+			-MAX_MAP_GENERATION_LIMIT);
+		b->max_pos = v3s16(MAX_MAP_GENERATION_LIMIT, std::max(y1, y2),
+			MAX_MAP_GENERATION_LIMIT);
+		if (i % 7 == 0) {
+			b->min_pos.X = pr.range(-500, 0);
+			b->max_pos.Z = pr.range(0, 500);
+		}
+		b->vertical_blend = i % 3 == 0 ? pr.range(1, 16) : 0;
+		// Removed biome
+		biomes.push_back(i == 75 ? nullptr : b);
+	}
+
+	BiomeLookup lookup(biomes);
+	for (int i = 0; i < 50000; i++) {
+		float heat = pr.range(-6000, 16000) / 100.0f;
+		float humidity = pr.range(-6000, 16000) / 100.0f;
+		if (i % 5 == 0) {
+			// Exactly between the shared points
+			heat = pr.range(0, 8) * 12.5f;
+			humidity = pr.range(0, 8) * 12.5f;
+		}
+		v3s16 pos(pr.range(-1000, 1000), pr.range(-300, 300), pr.range(-1000, 1000));
+
+		BiomeLookup::Result expected = find_by_scan(biomes, heat, humidity, pos);
+		BiomeLookup::Result actual = lookup.find(heat, humidity, pos);
+		UASSERTEQ(biome_t, actual.closest, expected.closest);
+		UASSERTEQ(float, actual.dist, expected.dist);
+		UASSERTEQ(biome_t, actual.closest_blend, expected.closest_blend);
+		UASSERTEQ(float, actual.dist_blend, expected.dist_blend);
+	}
+}
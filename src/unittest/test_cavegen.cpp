@@ -0,0 +1,165 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include <cmath>
+#include <memory>
+#include "dummymap.h"
+#include "mock_server.h"
+#include "noise.h"
+#include "mapgen/mg_biome.h"
+#include "mapgen/cavegen.h"
+#include "nodedef.h"
+#include "util/numeric.h"
+
+class TestCaveGen : public TestBase
+{
+public:
+	TestCaveGen() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestCaveGen"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testCaves(IGameDef *gamedef);
+};
+
+static TestCaveGen g_test_instance;
+
+void TestCaveGen::runTests(IGameDef *gamedef)
+{
+	TEST(testCaves, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const s16 water_level = 1;
+
+// Hilly terrain with a few open shafts down to the bottom of the mapchunk
+static s16 terrain_height(s16 x, s16 z)
+{
+	return 10 + 14 * std::sin(x * 0.07f) * std::cos(z * 0.05f);
+}
+
+static void fill_terrain(MMVManip *vm)
+{
+	const VoxelArea &area = vm->m_area;
+	for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+	for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++) {
+		s16 height = terrain_height(x, z);
+		bool shaft = (x + z) % 23 == 0;
+		for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++) {
+			content_t c = CONTENT_AIR;
+			if (y <= height - 3 && !shaft)
+				c = t_CONTENT_STONE;
+			else if (y <= height && !shaft)
+				c = t_CONTENT_GRASS;
+			else if (y <= water_level)
+				c = t_CONTENT_WATER;
+			vm->m_data[area.index(x, y, z)] = MapNode(c);
+			vm->m_flags[area.index(x, y, z)] = 0;
+		}
+	}
+}
+
+static void set_biome_nodes(Biome *b, content_t c_top, content_t c_filler,
+	content_t c_cave_liquid)
+{
+	b->flags = 0;
+	b->c_top = c_top;
+	b->c_filler = c_filler;
+	b->c_stone = t_CONTENT_STONE;
+	b->c_water_top = t_CONTENT_WATER;
+	b->c_water = t_CONTENT_WATER;
+	b->c_river_water = t_CONTENT_LAVA;
+	b->c_riverbed = t_CONTENT_BRICK;
+	b->c_dust = CONTENT_IGNORE;
+	b->c_cave_liquid = {c_cave_liquid};
+	b->depth_top = 1;
+	b->depth_filler = 2;
+	b->depth_water_top = 0;
+	b->depth_riverbed = 2;
+}
+
+static u64 hash_vm(const MMVManip *vm)
+{
+	u32 volume = vm->m_area.getVolume();
+	return murmur_hash_64_ua(vm->m_data, volume * sizeof(MapNode), 0) ^
+		murmur_hash_64_ua(vm->m_flags, volume, 1);
+}
+
+void TestCaveGen::testCaves(IGameDef *gamedef)
+{
+	const NodeDefManager *ndef = gamedef->getNodeDefManager();
+	const v3s16 csize(80, 80, 80);
+	const v3s16 nmin(-32, -32, -32), nmax(47, 47, 47);
+
+	MockServer server(getTestTempDirectory());
+	BiomeManager biomemgr(&server);
+	{
+		// Grass and brick near the surface, stone deep down
+		Biome *b = (Biome *)biomemgr.getRaw(0);
+		set_biome_nodes(b, t_CONTENT_GRASS, t_CONTENT_BRICK, CONTENT_IGNORE);
+		b->min_pos.Y = 0;
+
+		Biome *deep = new Biome;
+		deep->name = "deep";
+		set_biome_nodes(deep, t_CONTENT_STONE, t_CONTENT_STONE, t_CONTENT_LAVA);
+		deep->min_pos = v3s16(-1, -1, -1) * MAX_MAP_GENERATION_LIMIT;
+		deep->max_pos = v3s16(MAX_MAP_GENERATION_LIMIT, -1, MAX_MAP_GENERATION_LIMIT);
+		deep->heat_point = 50.0f;
+		deep->humidity_point = 50.0f;
+		deep->vertical_blend = 0;
+		biomemgr.add(deep);
+	}
+	BiomeParamsOriginal bparams;
+	bparams.seed = 42;
+	std::unique_ptr<BiomeGen> biomegen(biomemgr.createBiomeGen(
+		BIOMEGEN_ORIGINAL, &bparams, csize));
+
+	DummyMap map(gamedef, v3s16(-3, -3, -3), v3s16(3, 3, 3));
+	MMVManip vm(&map);
+	vm.initialEmerge(v3s16(-3, -3, -3), v3s16(3, 3, 3), false);
+
+	s16 heightmap[80 * 80];
+	for (s16 z = nmin.Z, i = 0; z <= nmax.Z; z++)
+	for (s16 x = nmin.X; x <= nmax.X; x++, i++)
+		heightmap[i] = (x + z) % 23 == 0 ? -MAX_MAP_GENERATION_LIMIT :
+			terrain_height(x, z);
+	biomegen->calcBiomeNoise(nmin);
+	biome_t *biomemap = biomegen->getBiomes(heightmap, nmin);
+
+	NoiseParams np_cave1(0.0, 12.0, v3f(61, 61, 61), 52534, 3, 0.5, 2.0);
+	NoiseParams np_cave2(0.0, 12.0, v3f(67, 67, 67), 10325, 3, 0.5, 2.0);
+	NoiseParams np_cavern(0.0, 1.0, v3f(96, 32, 96), 723, 5, 0.63, 2.0);
+
+	// Recorded with the previous implementation, the output must never change
+	const u64 expected[] = {
+		18086705757451839093ULL, 17758154216852559259ULL,
+		10350592929708032606ULL,
+	};
+
+	// Wide tunnels to have more of them
+	fill_terrain(&vm);
+	CavesNoiseIntersection caves_noise(ndef, &biomemgr, biomegen.get(), csize,
+		&np_cave1, &np_cave2, 42, 0.05f);
+	caves_noise.generateCaves(&vm, nmin, nmax, biomemap);
+	UASSERTEQ(u64, hash_vm(&vm), expected[0]);
+
+	// Caverns up to the surface
+	fill_terrain(&vm);
+	CavernsNoise caverns_noise(ndef, csize, &np_cavern, 42, 64, 32, 0.5f);
+	bool near_cavern = caverns_noise.generateCaverns(&vm, nmin, nmax);
+	UASSERT(near_cavern);
+	UASSERTEQ(u64, hash_vm(&vm), expected[1]);
+
+	// Small and large caves, some flooded
+	fill_terrain(&vm);
+	PseudoRandom ps(1234);
+	for (int i = 0; i < 16; i++) {
+		CavesRandomWalk cave(ndef, nullptr, 42, water_level,
+			t_CONTENT_WATER, t_CONTENT_LAVA, 0.5f, biomegen.get());
+		cave.makeCave(&vm, nmin, nmax, &ps, i % 4 == 0, 24, heightmap);
+	}
+	UASSERTEQ(u64, hash_vm(&vm), expected[2]);
+}
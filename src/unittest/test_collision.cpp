@@ -20,6 +20,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include "collision.h"
+#include "dummymap.h"
+#include "environment.h"
+#include "pcg_random.h"
+#include "threading/task_pool.h"
 
 class TestCollision : public TestBase {
 public:
@@ -29,6 +33,7 @@ class TestCollision : public TestBase {
 	void runTests(IGameDef *gamedef);
 
 	void testAxisAlignedCollision();
+	void testCollisionMoveBatch(IGameDef *gamedef);
 };
 
 static TestCollision g_test_instance;
@@ -36,6 +41,7 @@ static TestCollision g_test_instance;
 void TestCollision::runTests(IGameDef *gamedef)
 {
 	TEST(testAxisAlignedCollision);
+	TEST(testCollisionMoveBatch, gamedef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -178,3 +184,100 @@ void TestCollision::testAxisAlignedCollision()
 		}
 	}
 }
+
+namespace {
+
+class TestEnvironment : public Environment
+{
+public:
+	TestEnvironment(IGameDef *gamedef) :
+		Environment(gamedef),
+		m_map(gamedef, v3s16(-1, -1, -1), v3s16(0, 0, 0))
+	{}
+
+	void step(f32 dtime) override {}
+	Map &getMap() override { return m_map; }
+	void getSelectedActiveObjects(const core::line3d<f32> &shootline_on_map,
+			std::vector<PointedThing> &objects,
+			const std::optional<Pointabilities> &pointabilities) override {}
+
+private:
+	DummyMap m_map;
+};
+
+}
+
+void TestCollision::testCollisionMoveBatch(IGameDef *gamedef)
+{
+	TestEnvironment env(gamedef);
+	Map &map = env.getMap();
+
+	// Uneven ground with pillars and a few nodes left as CONTENT_IGNORE,
+	// outside of the blocks everything is unloaded
+	v3s16 p;
+	for (p.Z = -16; p.Z < 16; p.Z++)
+	for (p.Y = -16; p.Y < 16; p.Y++)
+	for (p.X = -16; p.X < 16; p.X++) {
+		content_t c = CONTENT_AIR;
+		if (p.Y < (p.X + p.Z) / 8 - 2 || (p.X % 5 == 0 && p.Z % 7 == 0))
+			c = t_CONTENT_STONE;
+		else if ((p.X * 3 + p.Y * 5 + p.Z * 7) % 41 == 0)
+			c = CONTENT_IGNORE;
+		map.setNode(p, MapNode(c));
+	}
+
+	PcgRandom pr(42);
+	auto rand_f = [&pr] (f32 min, f32 max) {
+		return min + (max - min) * pr.next() / (f32)U32_MAX;
+	};
+	std::vector<CollisionMoveJob> jobs;
+	for (int i = 0; i < 400; i++) {
+		CollisionMoveJob job;
+		f32 size = rand_f(0.1f, 0.9f) * BS;
+		job.box = aabb3f(-size, -size, -size, size, size * 2, size);
+		job.stepheight = i % 3 == 0 ? 0.6f * BS : 0.0f;
+		job.dtime = i % 50 == 0 ? 3.0f : rand_f(0.05f, 0.3f);
+		// The first half crowded together, the others spread out
+		f32 spread = i < 200 ? 2.0f : 17.0f;
+		job.pos = v3f(rand_f(-spread, spread), rand_f(-3.0f, 6.0f),
+			rand_f(-spread, spread)) * BS;
+		job.speed = v3f(rand_f(-20, 20), rand_f(-20, 20), rand_f(-20, 20)) * BS;
+		if (i % 7 == 0)
+			job.speed = v3f();
+		job.accel = v3f(0, -10 * BS, 0);
+		job.collide_with_objects = false;
+		jobs.push_back(job);
+	}
+
+	TaskPool pool(2);
+	int collisions = 0;
+	for (TaskPool *p : {(TaskPool *)nullptr, &pool}) {
+		std::vector<CollisionMoveJob> batch = jobs;
+		collisionMoveBatch(&env, gamedef, batch, p);
+
+		for (size_t i = 0; i < jobs.size(); i++) {
+			CollisionMoveJob job = jobs[i];
+			collisionMoveResult result = collisionMoveSimple(&env, gamedef,
+				BS * 0.25f, job.box, job.stepheight, job.dtime,
+				&job.pos, &job.speed, job.accel, nullptr, false);
+
+			const CollisionMoveJob &b = batch[i];
+			UASSERT(b.new_pos == job.pos);
+			UASSERT(b.new_speed == job.speed);
+			UASSERTEQ(bool, b.result.touching_ground, result.touching_ground);
+			UASSERTEQ(bool, b.result.collides, result.collides);
+			collisions += result.collides;
+			UASSERTEQ(bool, b.result.standing_on_object, result.standing_on_object);
+			UASSERTEQ(size_t, b.result.collisions.size(), result.collisions.size());
+			for (size_t j = 0; j < result.collisions.size(); j++) {
+				const CollisionInfo &c0 = result.collisions[j];
+				const CollisionInfo &c1 = b.result.collisions[j];
+				UASSERTEQ(int, c1.axis, c0.axis);
+				UASSERT(c1.node_p == c0.node_p);
+				UASSERT(c1.new_pos == c0.new_pos);
+				UASSERT(c1.new_speed == c0.new_speed);
+			}
+		}
+	}
+	UASSERT(collisions > 100);
+}
@@ -38,7 +38,9 @@ class TestCompression : public TestBase {
 	void testZlibCompression();
 	void testZlibLargeData();
 	void testZstdLargeData();
+	void testZstdDictionary();
 	void testZlibLimit();
+	void testBufferCompression();
 	void _testZlibLimit(u32 size, u32 limit);
 };
 
@@ -50,7 +52,9 @@ void TestCompression::runTests(IGameDef *gamedef)
 	TEST(testZlibCompression);
 	TEST(testZlibLargeData);
 	TEST(testZstdLargeData);
+	TEST(testZstdDictionary);
 	TEST(testZlibLimit);
+	TEST(testBufferCompression);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -212,6 +216,57 @@ void TestCompression::testZstdLargeData()
 	}
 }
 
+void TestCompression::testZstdDictionary()
+{
+	// Samples sharing a lot of content, like mapblocks of a world do
+	std::vector<std::string> samples;
+	PseudoRandom pseudorandom(1337);
+	for (u32 i = 0; i < 1000; i++) {
+		std::string sample = "default:stone default:dirt_with_grass air ";
+		for (u32 j = 0; j < 100; j++)
+			sample += "node" + std::to_string(pseudorandom.range(0, 30)) + " ";
+		samples.push_back(sample);
+	}
+
+	std::string dict_data = trainZstdDictionary(samples, 4096);
+	UASSERT(!dict_data.empty() && dict_data.size() <= 4096);
+	auto dict = std::make_shared<ZstdDictionary>(dict_data);
+	UASSERT(dict->getId() != 0);
+
+	// raw content isn't accepted as dictionary
+	EXCEPTION_CHECK(SerializationError, ZstdDictionary("not a dictionary"));
+
+	const std::string &data_in = samples[0];
+	std::ostringstream os_plain(std::ios::binary), os_dict(std::ios::binary);
+	compressZstd(data_in, os_plain, 0);
+	compressZstd(data_in, os_dict, 0, dict.get());
+	UASSERT(os_dict.str().size() < os_plain.str().size());
+
+	// Decompression needs the dictionary to be registered
+	{
+		std::istringstream is(os_dict.str(), std::ios::binary);
+		std::ostringstream os(std::ios::binary);
+		if (!getZstdDictionary(dict->getId()))
+			EXCEPTION_CHECK(SerializationError, decompressZstd(is, os));
+	}
+	registerZstdDictionary(dict);
+	UASSERT(getZstdDictionary(dict->getId()) == dict);
+	{
+		std::istringstream is(os_dict.str(), std::ios::binary);
+		std::ostringstream os(std::ios::binary);
+		decompressZstd(is, os);
+		UASSERT(os.str() == data_in);
+	}
+
+	// Frames without dictionary still decompress the same way
+	{
+		std::istringstream is(os_plain.str(), std::ios::binary);
+		std::ostringstream os(std::ios::binary);
+		decompressZstd(is, os);
+		UASSERT(os.str() == data_in);
+	}
+}
+
 void TestCompression::testZlibLimit()
 {
 	// edge cases
@@ -264,6 +319,11 @@ void TestCompression::_testZlibLimit(u32 size, u32 limit)
 	std::string str_decompressed = os_decompressed.str();
 	UASSERTEQ(size_t, str_decompressed.size(), expected);
 
+	// the buffer variant must stop at the same place
+	std::string buf_decompressed;
+	decompressZlib(os_compressed.str(), buf_decompressed, limit);
+	UASSERT(buf_decompressed == str_decompressed);
+
 	for (u32 i = 0; i < size && i < str_decompressed.size(); i++) {
 		UTEST(str_decompressed[i] == data_in[i],
 				"index out[%i]=%i differs from in[%i]=%i",
@@ -271,3 +331,68 @@ void TestCompression::_testZlibLimit(u32 size, u32 limit)
 	}
 }
 
+
+void TestCompression::testBufferCompression()
+{
+	std::string data_in;
+	for (u32 i = 0; i < 100000; i++)
+		data_in += std::to_string(i % 1000) + " ";
+
+	const std::string trailing = "trailing data";
+
+	// zlib
+	{
+		std::string compressed = "prefix";
+		compressZlib(data_in, compressed);
+		UASSERT(compressed.compare(0, 6, "prefix") == 0);
+		compressed.erase(0, 6);
+
+		// compatible with the stream variant
+		std::istringstream is(compressed, std::ios::binary);
+		std::ostringstream os(std::ios::binary);
+		decompressZlib(is, os);
+		UASSERT(os.str() == data_in);
+
+		std::string out;
+		size_t used = decompressZlib(compressed + trailing, out);
+		UASSERTEQ(size_t, used, compressed.size());
+		UASSERT(out == data_in);
+
+		out.clear();
+		EXCEPTION_CHECK(SerializationError, decompressZlib(
+			std::string_view(compressed).substr(0, compressed.size() / 2), out));
+	}
+
+	// zstd
+	{
+		std::string compressed;
+		compressZstd(data_in, compressed, 3);
+
+		std::istringstream is(compressed, std::ios::binary);
+		std::ostringstream os(std::ios::binary);
+		decompressZstd(is, os);
+		UASSERT(os.str() == data_in);
+
+		std::ostringstream os_compressed(std::ios::binary);
+		compressZstd(data_in, os_compressed, 3);
+		std::string out = "prefix";
+		size_t used = decompressZstd(os_compressed.str() + trailing, out);
+		UASSERTEQ(size_t, used, os_compressed.str().size());
+		UASSERT(out == "prefix" + data_in);
+
+		out.clear();
+		EXCEPTION_CHECK(SerializationError, decompressZstd(
+			std::string_view(compressed).substr(0, compressed.size() / 2), out));
+		out.clear();
+		EXCEPTION_CHECK(SerializationError, decompressZstd("", out));
+	}
+
+	// selected by version, including the RLE fallback
+	for (u8 version : {(u8)10, (u8)28, (u8)29}) {
+		std::string compressed, out;
+		compress(data_in, compressed, version);
+		size_t used = decompress(compressed + trailing, out, version);
+		UASSERTEQ(size_t, used, compressed.size());
+		UASSERT(out == data_in);
+	}
+}
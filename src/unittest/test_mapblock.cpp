@@ -8,7 +8,7 @@
 #include "nodedef.h"
 #include "mapblock.h"
 #include "serialization.h"
-#include "noise.h"
+#include "pcg_random.h"
 #include "inventory.h"
 
 class TestMapBlock : public TestBase
@@ -137,6 +137,8 @@ void TestMapBlock::testSave29(IGameDef *gamedef)
 		ii[i] = readU16(ss2);
 		nn[i] = deSerializeString16(ss2);
 	}
+	const content_t stone_id =
+		nn[0] == ndef->get(t_CONTENT_STONE).name ? ii[0] : ii[1];
 	// no particular order is guaranteed
 	if (nn[0] > nn[1])
 		std::swap(nn[0], nn[1]);
@@ -159,6 +161,13 @@ void TestMapBlock::testSave29(IGameDef *gamedef)
 	params_width = readU8(ss2);
 	SS2_CHECK();
 	UASSERT(content_width == 2 && params_width == 2);
+
+	// Content ids must have been translated to the ones in the nimap
+	for (size_t i = 0; i < MapBlock::nodecount; i++) {
+		content_t c = readU16(ss2);
+		SS2_CHECK();
+		UASSERTEQ(int, c, i == 0 ? stone_id : (stone_id ^ 1));
+	}
 }
 
 #undef SS2_CHECK
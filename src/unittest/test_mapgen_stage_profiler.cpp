@@ -0,0 +1,79 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "mapgen/mg_stage_profiler.h"
+#include "util/metricsbackend.h"
+
+class TestMapgenStageProfiler : public TestBase
+{
+public:
+	TestMapgenStageProfiler() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMapgenStageProfiler"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testHistogram();
+	void testStageTimer();
+};
+
+static TestMapgenStageProfiler g_test_instance;
+
+void TestMapgenStageProfiler::runTests(IGameDef *gamedef)
+{
+	TEST(testHistogram);
+	TEST(testStageTimer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestMapgenStageProfiler::testHistogram()
+{
+	MetricsBackend mb;
+	MetricHistogramPtr histogram = mb.addHistogram("test", "test",
+		{0.1, 1.0, 10.0});
+	histogram->observe(0.5);
+	histogram->observe(2.0);
+	histogram->observe(100.0);
+	UASSERTEQ(double, histogram->getCount(), 3.0);
+	UASSERTEQ(double, histogram->getSum(), 102.5);
+}
+
+void TestMapgenStageProfiler::testStageTimer()
+{
+	MetricsBackend mb;
+	MapgenStageProfiler profiler(&mb);
+	u64 count;
+	double seconds;
+
+	{
+		MapgenStageTimer timer(&profiler);
+		timer.start(MGSTAGE_TERRAIN);
+		timer.start(MGSTAGE_BIOMES);
+		timer.start(MGSTAGE_CAVES);
+		// Entering a stage again adds to the same chunk
+		timer.start(MGSTAGE_BIOMES);
+		timer.stop();
+	}
+	{
+		MapgenStageTimer timer(&profiler);
+		timer.start(MGSTAGE_TERRAIN);
+	}
+
+	UASSERT(profiler.getStats(MGSTAGE_TERRAIN, &count, &seconds));
+	UASSERTEQ(u64, count, 2);
+	UASSERT(seconds >= 0.0);
+	UASSERT(profiler.getStats(MGSTAGE_BIOMES, &count, &seconds));
+	UASSERTEQ(u64, count, 1);
+	UASSERT(profiler.getStats(MGSTAGE_LIGHTING, &count, &seconds));
+	UASSERTEQ(u64, count, 0);
+
+	// Without a profiler nothing is recorded
+	MapgenStageTimer timer(nullptr);
+	timer.start(MGSTAGE_TERRAIN);
+	timer.stop();
+
+	MapgenStageProfiler no_metrics(nullptr);
+	UASSERT(!no_metrics.getStats(MGSTAGE_TERRAIN, &count, &seconds));
+}
@@ -19,9 +19,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "test.h"
 
+#include <algorithm>
 #include <cmath>
 #include "exceptions.h"
 #include "noise.h"
+#include "mapgen/mg_noise_cache.h"
 
 class TestNoise : public TestBase {
 public:
@@ -41,6 +43,7 @@ class TestNoise : public TestBase {
 	void testNoise3dPoint();
 	void testNoise3dBulk();
 	void testNoiseInvalidParams();
+	void testNoiseMapCache();
 
 	static const float expected_2d_results[10 * 10];
 	static const float expected_3d_results[10 * 10 * 10];
@@ -61,6 +64,7 @@ void TestNoise::runTests(IGameDef *gamedef)
 	TEST(testNoise3dPoint);
 	TEST(testNoise3dBulk);
 	TEST(testNoiseInvalidParams);
+	TEST(testNoiseMapCache);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -175,6 +179,45 @@ void TestNoise::testNoiseInvalidParams()
 	UASSERT(exception_thrown);
 }
 
+void TestNoise::testNoiseMapCache()
+{
+	NoiseParams np_normal(20, 40, v3f(50, 50, 50), 9,  5, 0.6, 2.0);
+	Noise noise(&np_normal, 1337, 10, 10);
+	// Room for two maps
+	NoiseMapCache cache(2 * 10 * 10 * sizeof(float));
+
+	for (int i = 0; i < 2; i++) {
+		std::fill_n(noise.result, 10 * 10, 0.0f);
+		float *noisevals = cache.perlinMap2D(&noise, 0, 0);
+		for (u32 j = 0; j != 10 * 10; j++)
+			UASSERT(std::fabs(noisevals[j] - expected_2d_results[j]) <= 0.00001);
+	}
+	UASSERTEQ(u64, cache.getStats().misses, 1);
+	UASSERTEQ(u64, cache.getStats().hits, 1);
+
+	// Point lookups
+	float value = 0.0f;
+	UASSERT(cache.getValue(np_normal, 1337, v2s32(0, 0), v2u32(10, 10),
+		v2s32(3, 4), &value));
+	UASSERT(std::fabs(value - expected_2d_results[4 * 10 + 3]) <= 0.00001);
+	UASSERT(!cache.getValue(np_normal, 1337, v2s32(0, 0), v2u32(10, 10),
+		v2s32(10, 4), &value));
+	UASSERT(!cache.getValue(np_normal, 1338, v2s32(0, 0), v2u32(10, 10),
+		v2s32(3, 4), &value));
+
+	// A persistence map makes a different entry
+	Noise noise_persist(&np_normal, 1337, 10, 10);
+	cache.perlinMap2D(&noise_persist, 10, 0);
+	cache.perlinMap2D(&noise, 10, 0, &noise_persist);
+	UASSERTEQ(u64, cache.getStats().misses, 4);
+	UASSERTEQ(size_t, cache.getStats().entries, 2);
+
+	// The least recently used map was dropped
+	UASSERT(!cache.getValue(np_normal, 1337, v2s32(0, 0), v2u32(10, 10),
+		v2s32(3, 4), &value));
+	UASSERT(cache.getStats().bytes <= 2 * 10 * 10 * sizeof(float));
+}
+
 const float TestNoise::expected_2d_results[10 * 10] = {
 	19.11726, 18.49626, 16.48476, 15.02135, 14.75713, 16.26008, 17.54822,
 	18.06860, 18.57016, 18.48407, 18.49649, 17.89160, 15.94162, 14.54901,
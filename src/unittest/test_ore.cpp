@@ -0,0 +1,165 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include <memory>
+#include "dummymap.h"
+#include "gamedef.h"
+#include "mapgen/mg_ore.h"
+#include "nodedef.h"
+#include "util/numeric.h"
+
+class TestOre : public TestBase
+{
+public:
+	TestOre() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestOre"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testPlacement(IGameDef *gamedef);
+};
+
+static TestOre g_test_instance;
+
+void TestOre::runTests(IGameDef *gamedef)
+{
+	TEST(testPlacement, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void resolve_ore(const NodeDefManager *ndef, Ore *ore,
+	const std::vector<std::string> &wherein)
+{
+	ore->ore_param2 = 0;
+	ore->m_nodenames.emplace_back("default:brick");
+	for (const std::string &name : wherein)
+		ore->m_nodenames.push_back(name);
+	ore->m_nnlistsizes.push_back(wherein.size());
+	ndef->pendNodeResolve(ore);
+}
+
+void TestOre::testPlacement(IGameDef *gamedef)
+{
+	NodeDefManager *ndef = (NodeDefManager *)gamedef->getNodeDefManager();
+	ndef->setNodeRegistrationStatus(true);
+
+	// Like a mapchunk of 3x3x3 blocks with the border blocks around it
+	DummyMap map(gamedef, v3s16(-1, -1, -1), v3s16(3, 3, 3));
+	MMVManip vm(&map);
+	vm.initialEmerge(v3s16(-1, -1, -1), v3s16(3, 3, 3), false);
+	const v3s16 nmin(0, 0, 0), nmax(47, 47, 47);
+
+	for (s16 z = vm.m_area.MinEdge.Z; z <= vm.m_area.MaxEdge.Z; z++)
+	for (s16 y = vm.m_area.MinEdge.Y; y <= vm.m_area.MaxEdge.Y; y++)
+	for (s16 x = vm.m_area.MinEdge.X; x <= vm.m_area.MaxEdge.X; x++) {
+		content_t c = t_CONTENT_STONE;
+		if ((x * 7 + y * 13 + z * 5) % 11 == 0)
+			c = (y % 2) ? t_CONTENT_GRASS : CONTENT_AIR;
+		vm.m_data[vm.m_area.index(x, y, z)] = MapNode(c);
+	}
+
+	biome_t biomemap[48 * 48];
+	for (u32 i = 0; i < 48 * 48; i++)
+		biomemap[i] = ((i % 48) / 5 + (i / 48) / 7) % 3 + 1;
+
+	const std::vector<std::string> stone{"default:stone"};
+	const std::vector<std::string> stone_dirt{"default:stone",
+		"default:dirt_with_grass"};
+	const NoiseParams np(0, 1, v3f(20, 20, 20), 5, 2, 0.6, 2.0);
+
+	std::vector<std::unique_ptr<Ore>> ores;
+	{
+		auto ore = new OreScatter();
+		ore->clust_scarcity = 8 * 8 * 8;
+		ore->clust_num_ores = 8;
+		ore->clust_size = 3;
+		resolve_ore(ndef, ore, stone);
+		ores.emplace_back(ore);
+	}
+	{
+		auto ore = new OreScatter();
+		ore->clust_scarcity = 6 * 6 * 6;
+		ore->clust_num_ores = 5;
+		ore->clust_size = 4;
+		ore->flags = OREFLAG_USE_NOISE;
+		ore->np = np;
+		ore->nthresh = 0.0f;
+		ore->biomes = {1, 2};
+		resolve_ore(ndef, ore, stone_dirt);
+		ores.emplace_back(ore);
+	}
+	{
+		auto ore = new OreSheet();
+		ore->np = np;
+		ore->nthresh = 0.3f;
+		ore->column_height_min = 1;
+		ore->column_height_max = 4;
+		ore->column_midpoint_factor = 0.5f;
+		resolve_ore(ndef, ore, stone);
+		ores.emplace_back(ore);
+	}
+	{
+		auto ore = new OrePuff();
+		ore->np = np;
+		ore->np_puff_top = NoiseParams(4, 3, v3f(10, 10, 10), 6, 2, 0.6, 2.0);
+		ore->np_puff_bottom = NoiseParams(4, 3, v3f(10, 10, 10), 7, 2, 0.6, 2.0);
+		ore->nthresh = 0.0f;
+		ore->biomes = {2};
+		resolve_ore(ndef, ore, stone_dirt);
+		ores.emplace_back(ore);
+	}
+	{
+		auto ore = new OreBlob();
+		ore->clust_scarcity = 12 * 12 * 12;
+		ore->clust_size = 5;
+		ore->np = NoiseParams(0, 1, v3f(5, 5, 5), 8, 1, 0.6, 2.0);
+		ore->nthresh = 0.0f;
+		resolve_ore(ndef, ore, stone);
+		ores.emplace_back(ore);
+	}
+	{
+		auto ore = new OreVein();
+		ore->np = NoiseParams(0, 1, v3f(16, 16, 16), 9, 2, 0.6, 2.0);
+		ore->nthresh = 0.2f;
+		ore->random_factor = 0.5f;
+		ore->biomes = {1, 3};
+		resolve_ore(ndef, ore, stone_dirt);
+		ores.emplace_back(ore);
+	}
+	{
+		auto ore = new OreStratum();
+		ore->flags = OREFLAG_USE_NOISE | OREFLAG_USE_NOISE2;
+		ore->np = NoiseParams(24, 8, v3f(30, 30, 30), 10, 2, 0.6, 2.0);
+		ore->np_stratum_thickness = NoiseParams(6, 2, v3f(20, 20, 20), 11, 2, 0.6, 2.0);
+		ore->clust_scarcity = 2;
+		resolve_ore(ndef, ore, stone);
+		ores.emplace_back(ore);
+	}
+	{
+		auto ore = new OreStratum();
+		ore->clust_scarcity = 40;
+		ore->biomes = {3};
+		resolve_ore(ndef, ore, stone_dirt);
+		ores.emplace_back(ore);
+	}
+
+	// Recorded with the node by node implementation, the output must
+	// never change
+	const u64 expected[] = {
+		14757458802541430858ULL, 7032947423480872813ULL,
+		9488656707783667999ULL, 2725522433179901304ULL,
+		12780375111312616394ULL, 10572922319554517145ULL,
+		8508477887832401542ULL, 10518520279588327983ULL,
+	};
+
+	UASSERTEQ(size_t, ores.size(), ARRLEN(expected));
+	for (size_t i = 0; i < ores.size(); i++) {
+		ores[i]->generate(&vm, 42, 1000 + i, nmin, nmax, biomemap);
+		u64 hash = murmur_hash_64_ua(vm.m_data,
+			vm.m_area.getVolume() * sizeof(MapNode), 0);
+		UASSERTEQ(u64, hash, expected[i]);
+	}
+}
@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/numeric.h"
 #include "exceptions.h"
 #include "noise.h"
+#include "pcg_random.h"
 
 class TestRandom : public TestBase {
 public:
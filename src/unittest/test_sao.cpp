@@ -41,6 +41,8 @@ class TestSAO : public TestBase
 	void testActivate(ServerEnvironment *env);
 	void testStaticToFalse(ServerEnvironment *env);
 	void testStaticToTrue(ServerEnvironment *env);
+	void testNativeStep(ServerEnvironment *env);
+	void testCollisionMoveDone(ServerEnvironment *env);
 
 private:
 	// enough for both removeRemovedObjects and deactivateFarObjects to be called
@@ -57,6 +59,37 @@ core.register_entity(":test:non_static", {
 		static_save = false,
 	}
 })
+
+local function count_steps(self, dtime)
+	self._calls = (self._calls or 0) + 1
+	self._dtime = (self._dtime or 0) + dtime
+	self.object:set_properties({infotext = self._calls .. " " .. self._dtime})
+end
+core.register_entity(":test:step_interval", {
+	initial_properties = {
+		static_save = false,
+	},
+	native_step = {
+		on_step_interval = 1,
+	},
+	on_step = count_steps,
+})
+core.register_entity(":test:step_timeouts", {
+	initial_properties = {
+		static_save = false,
+	},
+	native_step = {
+		timeout = 2,
+		idle_timeout = 1,
+	},
+	on_step = count_steps,
+})
+core.register_entity(":test:physical", {
+	initial_properties = {
+		static_save = false,
+		physical = true,
+	},
+})
 )";
 
 void TestSAO::runTests(IGameDef *gamedef)
@@ -100,6 +133,8 @@ void TestSAO::runTests(IGameDef *gamedef)
 	TEST(testActivate, &env);
 	TEST(testStaticToFalse, &env);
 	TEST(testStaticToTrue, &env);
+	TEST(testNativeStep, &env);
+	TEST(testCollisionMoveDone, &env);
 
 	env.deactivateBlocksAndObjects();
 }
@@ -313,3 +348,74 @@ void TestSAO::testStaticToTrue(ServerEnvironment *env)
 	UASSERTEQ(size_t, block->m_static_objects.getStoredSize(), 1);
 	UASSERTEQ(size_t, block->m_static_objects.getActiveSize(), 0);
 }
+
+void TestSAO::testNativeStep(ServerEnvironment *env)
+{
+	const v3f testpos(0, 4 * BS, 40 * BS);
+
+	// on_step only every second, with the summed up dtime
+	auto obj = add_entity(env, testpos, "test:step_interval");
+	UASSERT(obj);
+	for (int i = 0; i < 3; i++)
+		obj->step(0.25f, false);
+	UASSERTEQ(auto, obj->accessObjectProperties()->infotext, "");
+	for (int i = 0; i < 7; i++)
+		obj->step(0.25f, false);
+	UASSERTEQ(auto, obj->accessObjectProperties()->infotext, "2 2");
+	obj->markForRemoval();
+
+	// Removed after a second without moving, or after two seconds
+	auto idle = add_entity(env, testpos, "test:step_timeouts");
+	auto moving = add_entity(env, testpos, "test:step_timeouts");
+	UASSERT(idle && moving);
+	moving->setVelocity(v3f(BS, 0, 0));
+	for (int i = 0; i < 4; i++) {
+		idle->step(0.25f, false);
+		moving->step(0.25f, false);
+	}
+	UASSERT(!idle->isGone());
+	idle->step(0.25f, false);
+	UASSERT(idle->isGone());
+	for (int i = 0; i < 5; i++) {
+		UASSERT(!moving->isGone());
+		moving->step(0.25f, false);
+	}
+	UASSERT(moving->isGone());
+	UASSERTEQ(auto, moving->accessObjectProperties()->infotext, "8 2");
+
+	env->step(m_step_interval);
+}
+
+void TestSAO::testCollisionMoveDone(ServerEnvironment *env)
+{
+	const v3f testpos(8 * BS, 8 * BS, 56 * BS);
+	MapBlock *block = env->getServerMap().emergeBlock(v3s16(0, 0, 3), true);
+	UASSERT(block);
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
+		block->setNodeNoCheck(x, y, z, MapNode(CONTENT_AIR));
+
+	auto obj = add_entity(env, testpos, "test:physical");
+	UASSERT(obj);
+	obj->setVelocity(v3f(BS, 0, 0));
+
+	// The step uses the done move
+	CollisionMoveJob move;
+	UASSERT(obj->getCollisionMove(0.5f, move));
+	move.new_pos = testpos + v3f(0, 0, 3 * BS);
+	obj->setCollisionMoveDone(std::move(move));
+	obj->step(0.5f, false);
+	UASSERT(obj->getBasePosition() == testpos + v3f(0, 0, 3 * BS));
+
+	// Unless the entity has changed since, then it moves by itself
+	UASSERT(obj->getCollisionMove(0.5f, move));
+	move.new_pos = testpos + v3f(0, 0, 3 * BS);
+	obj->setCollisionMoveDone(std::move(move));
+	obj->setPos(testpos);
+	obj->step(0.5f, false);
+	UASSERT(obj->getBasePosition() == testpos + v3f(0.5f * BS, 0, 0));
+
+	obj->markForRemoval();
+	env->step(m_step_interval);
+}
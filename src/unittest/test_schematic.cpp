@@ -20,8 +20,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include "mapgen/mg_schematic.h"
+#include "dummymap.h"
+#include "filesys.h"
 #include "gamedef.h"
 #include "nodedef.h"
+#include "porting.h"
 
 class TestSchematic : public TestBase {
 public:
@@ -33,6 +36,9 @@ class TestSchematic : public TestBase {
 	void testMtsSerializeDeserialize(const NodeDefManager *ndef);
 	void testLuaTableSerialize(const NodeDefManager *ndef);
 	void testFileSerializeDeserialize(const NodeDefManager *ndef);
+	void testFileCache(const NodeDefManager *ndef);
+	void testCloneSharesData(const NodeDefManager *ndef);
+	void testBlitRotations(IGameDef *gamedef);
 
 	static const content_t test_schem1_data[7 * 6 * 4];
 	static const content_t test_schem2_data[3 * 3 * 3];
@@ -49,10 +55,18 @@ void TestSchematic::runTests(IGameDef *gamedef)
 
 	ndef->setNodeRegistrationStatus(true);
 
+	// Keep the schematic cache files out of the real cache
+	const std::string path_cache = porting::path_cache;
+	porting::path_cache = getTestTempDirectory();
+
 	TEST(testMtsSerializeDeserialize, ndef);
 	TEST(testLuaTableSerialize, ndef);
 	TEST(testFileSerializeDeserialize, ndef);
+	TEST(testFileCache, ndef);
+	TEST(testCloneSharesData, ndef);
+	TEST(testBlitRotations, gamedef);
 
+	porting::path_cache = path_cache;
 	ndef->resetNodeResolveState();
 }
 
@@ -187,6 +201,173 @@ void TestSchematic::testFileSerializeDeserialize(const NodeDefManager *ndef)
 }
 
 
+void TestSchematic::testFileCache(const NodeDefManager *ndef)
+{
+	static const v3s16 size(3, 3, 3);
+	static const u32 volume = size.X * size.Y * size.Z;
+
+	Schematic schem1;
+	schem1.size = size;
+	schem1.schemdata = new MapNode[volume];
+	schem1.slice_probs = new u8[size.Y];
+	for (s16 y = 0; y != size.Y; y++)
+		schem1.slice_probs[y] = 40 * y;
+	schem1.m_resolve_done = true;
+	for (size_t i = 0; i != volume; i++)
+		schem1.schemdata[i] = MapNode(test_schem2_data[i] ? t_CONTENT_STONE :
+			CONTENT_AIR, test_schem2_prob[i], i);
+
+	std::string temp_file = getTestTempFile();
+	UASSERT(schem1.saveSchematicToFile(temp_file, ndef));
+	// Only this cache file in there
+	porting::path_cache = getTestTempDirectory() + DIR_DELIM "file_cache";
+
+	auto check_loaded = [&] (const Schematic &schem) {
+		UASSERT(schem.size == size);
+		for (s16 y = 0; y != size.Y; y++)
+			UASSERTEQ(int, schem.slice_probs[y], 40 * y);
+		for (size_t i = 0; i != volume; i++)
+			UASSERT(schem.schemdata[i] == schem1.schemdata[i]);
+	};
+
+	// Decoded from the file, the cache file is written
+	std::vector<fs::DirListNode> list;
+	{
+		Schematic schem;
+		UASSERT(schem.loadSchematicFromFile(temp_file, ndef));
+		check_loaded(schem);
+		list = fs::GetDirListing(porting::path_cache + DIR_DELIM "schematics");
+		UASSERTEQ(size_t, list.size(), 1);
+	}
+	const std::string cache_file = porting::path_cache + DIR_DELIM
+		"schematics" DIR_DELIM + list[0].name;
+	std::string cache_data;
+	UASSERT(fs::ReadFile(cache_file, cache_data));
+
+	// Read from the cache file
+	{
+		Schematic schem;
+		UASSERT(schem.loadSchematicFromFile(temp_file, ndef));
+		check_loaded(schem);
+	}
+
+	// A broken cache file is ignored and written again
+	UASSERT(fs::safeWriteToFile(cache_file, cache_data.substr(0, 40)));
+	{
+		Schematic schem;
+		UASSERT(schem.loadSchematicFromFile(temp_file, ndef));
+		check_loaded(schem);
+	}
+	std::string rewritten;
+	UASSERT(fs::ReadFile(cache_file, rewritten));
+	UASSERT(rewritten == cache_data);
+}
+
+
+void TestSchematic::testCloneSharesData(const NodeDefManager *ndef)
+{
+	static const v3s16 size(3, 3, 3);
+	static const u32 volume = size.X * size.Y * size.Z;
+
+	auto schem = std::make_unique<Schematic>();
+	schem->size = size;
+	schem->schemdata = new MapNode[volume];
+	schem->slice_probs = new u8[size.Y];
+	memset(schem->slice_probs, APRSCHEM_PROB_ALWAYS, size.Y);
+	schem->m_resolve_done = true;
+	for (size_t i = 0; i != volume; i++)
+		schem->schemdata[i] = MapNode(t_CONTENT_STONE, APRSCHEM_PROB_ALWAYS, i);
+
+	std::unique_ptr<Schematic> clone1((Schematic *)schem->clone());
+	std::unique_ptr<Schematic> clone2((Schematic *)clone1->clone());
+	UASSERT(clone1->schemdata == schem->schemdata);
+	UASSERT(clone2->schemdata == schem->schemdata);
+	UASSERT(clone2->slice_probs == schem->slice_probs);
+
+	// Changing a clone gives it its own copy
+	std::vector<std::pair<v3s16, u8>> plist{{v3s16(1, 1, 1), APRSCHEM_PROB_NEVER}};
+	std::vector<std::pair<s16, u8>> splist;
+	clone1->applyProbabilities(v3s16(0, 0, 0), &plist, &splist);
+	UASSERT(clone1->schemdata != schem->schemdata);
+	UASSERT(clone1->schemdata[13] == MapNode(CONTENT_AIR, APRSCHEM_PROB_NEVER, 13));
+	UASSERT(schem->schemdata[13] == MapNode(t_CONTENT_STONE, APRSCHEM_PROB_ALWAYS, 13));
+
+	// The data outlives the schematic it was cloned from
+	schem.reset();
+	clone1.reset();
+	for (size_t i = 0; i != volume; i++)
+		UASSERT(clone2->schemdata[i] == MapNode(t_CONTENT_STONE, APRSCHEM_PROB_ALWAYS, i));
+	UASSERTEQ(int, clone2->slice_probs[2], APRSCHEM_PROB_ALWAYS);
+}
+
+
+void TestSchematic::testBlitRotations(IGameDef *gamedef)
+{
+	static const v3s16 size(3, 2, 4);
+	static const u32 volume = size.X * size.Y * size.Z;
+	const v3s16 p(5, 5, 5);
+
+	Schematic schem;
+	schem.size        = size;
+	schem.schemdata   = new MapNode[volume];
+	schem.slice_probs = new u8[size.Y];
+	schem.slice_probs[0] = APRSCHEM_PROB_ALWAYS;
+	schem.slice_probs[1] = APRSCHEM_PROB_ALWAYS;
+	schem.m_ndef = gamedef->getNodeDefManager();
+	schem.m_resolve_done = true;
+
+	for (u32 i = 0; i != volume; i++) {
+		content_t c = (i % 5 == 0) ? CONTENT_IGNORE :
+			(i % 3 == 0) ? t_CONTENT_GRASS : t_CONTENT_STONE;
+		u8 param1 = APRSCHEM_PROB_ALWAYS | ((i % 7 == 0) ? APRSCHEM_FORCE_PLACE : 0);
+		schem.schemdata[i] = MapNode(c, param1, i);
+	}
+
+	DummyMap map(gamedef, v3s16(0, 0, 0), v3s16(0, 0, 0));
+
+	for (int rot = ROTATE_0; rot <= ROTATE_270; rot++) {
+		MMVManip vm(&map);
+		vm.initialEmerge(v3s16(0, 0, 0), v3s16(0, 0, 0), false);
+		// The second layer is only replaced by force placed nodes
+		for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+		for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
+		for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+			vm.m_data[vm.m_area.index(x, y, z)] =
+				MapNode(y == p.Y + 1 ? t_CONTENT_BRICK : CONTENT_AIR);
+		}
+
+		// Blitting the same rotation again uses the cached image
+		schem.blitToVManip(&vm, p, (Rotation)rot, false);
+		if (rot == ROTATE_90)
+			schem.blitToVManip(&vm, p, (Rotation)rot, false);
+
+		v3s16 s = (rot == ROTATE_90 || rot == ROTATE_270) ?
+			v3s16(size.Z, size.Y, size.X) : size;
+		for (s16 z = 0; z != s.Z; z++)
+		for (s16 y = 0; y != s.Y; y++)
+		for (s16 x = 0; x != s.X; x++) {
+			// Position in the schematic data
+			v3s16 sp;
+			switch (rot) {
+			case ROTATE_90:  sp = v3s16(size.X - 1 - z, y, x); break;
+			case ROTATE_180: sp = v3s16(size.X - 1 - x, y, size.Z - 1 - z); break;
+			case ROTATE_270: sp = v3s16(z, y, size.Z - 1 - x); break;
+			default:         sp = v3s16(x, y, z);
+			}
+			MapNode n = schem.schemdata[(sp.Z * size.Y + sp.Y) * size.X + sp.X];
+
+			content_t before = (y == 1) ? t_CONTENT_BRICK : CONTENT_AIR;
+			bool placed = n.getContent() != CONTENT_IGNORE &&
+				(before == CONTENT_AIR || (n.param1 & APRSCHEM_FORCE_PLACE));
+			MapNode expected = placed ?
+				MapNode(n.getContent(), 0, n.param2) : MapNode(before);
+
+			UASSERT(vm.getNodeNoExNoEmerge(p + v3s16(x, y, z)) == expected);
+		}
+	}
+}
+
+
 // Should form a cross-shaped-thing...?
 const content_t TestSchematic::test_schem1_data[7 * 6 * 4] = {
 	3, 3, 1, 1, 1, 3, 3, // Y=0, Z=0
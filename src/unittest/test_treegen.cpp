@@ -0,0 +1,136 @@
+// Minetest
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "test.h"
+
+#include "dummymap.h"
+#include "mapgen/treegen.h"
+#include "util/numeric.h"
+
+class TestTreegen : public TestBase
+{
+public:
+	TestTreegen() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestTreegen"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testLTrees(IGameDef *gamedef);
+};
+
+static TestTreegen g_test_instance;
+
+void TestTreegen::runTests(IGameDef *gamedef)
+{
+	TEST(testLTrees, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static treegen::TreeDef make_tree_def()
+{
+	treegen::TreeDef def;
+	def.trunknode = MapNode(t_CONTENT_STONE);
+	def.leavesnode = MapNode(t_CONTENT_GRASS);
+	def.leaves2node = MapNode(t_CONTENT_WATER);
+	def.fruitnode = MapNode(t_CONTENT_LAVA);
+	def.leaves2_chance = 0;
+	def.angle = 30;
+	def.iterations = 2;
+	def.iterations_random_level = 0;
+	def.trunk_type = "single";
+	def.thin_branches = true;
+	def.fruit_chance = 0;
+	def.seed = 0;
+	def.explicit_seed = false;
+	return def;
+}
+
+void TestTreegen::testLTrees(IGameDef *gamedef)
+{
+	std::vector<treegen::TreeDef> defs;
+	{
+		// Apple tree from the Lua API documentation
+		treegen::TreeDef def = make_tree_def();
+		def.initial_axiom = "FFFFFAFFBF";
+		def.rules_a = "[&&&FFFFF&&FFFF][&&&++++FFFFF&&FFFF][&&&----FFFFF&&FFFF]";
+		def.rules_b = "[&&&++FFFF&&FFFF][&&&--FFFF&&FFFF][&&&------FFFF&&FFFF]";
+		def.fruit_chance = 10;
+		defs.push_back(def);
+	}
+	{
+		// Random rules, random growth level and a double trunk
+		treegen::TreeDef def = make_tree_def();
+		def.initial_axiom = "TTTTTTA";
+		def.rules_a = "FF[&&-Fbf][&&+Fbf][&&---Fbf][&&/Fbf]a";
+		def.rules_b = "[&FFf/Gf]R";
+		def.rules_c = "c";
+		def.iterations = 5;
+		def.iterations_random_level = 2;
+		def.trunk_type = "double";
+		def.thin_branches = false;
+		def.leaves2_chance = 30;
+		defs.push_back(def);
+	}
+	{
+		// Crossed trunk with an explicit seed
+		treegen::TreeDef def = make_tree_def();
+		def.initial_axiom = "FFFA";
+		def.rules_a = "T[^^FFfA][*FF&&fB]d";
+		def.rules_b = "[//FFFf]";
+		def.rules_d = "FF";
+		def.iterations = 4;
+		def.angle = 45;
+		def.trunk_type = "crossed";
+		def.thin_branches = false;
+		def.seed = 1234;
+		def.explicit_seed = true;
+		def.fruit_chance = 30;
+		defs.push_back(def);
+	}
+	{
+		// Unbalanced brackets, stops after the trunk
+		treegen::TreeDef def = make_tree_def();
+		def.initial_axiom = "FFFF]FF";
+		defs.push_back(def);
+	}
+
+	// Near the origin and far away, where float positions are less precise
+	const v3s16 bp_origins[] = {v3s16(-2, -1, -2), v3s16(1800, 1, -1900)};
+
+	// Recorded with the string expanding implementation, the output must
+	// never change
+	const u64 expected[] = {
+		8609095862233043627ULL, 6182827549672766992ULL,
+		5097856880837322115ULL, 1276732980186121752ULL,
+		14041388989516869764ULL, 8815757021943399345ULL,
+		5097856880837322115ULL, 1276732980186121752ULL,
+	};
+	const treegen::error expected_error[] = {
+		treegen::SUCCESS, treegen::SUCCESS, treegen::SUCCESS,
+		treegen::UNBALANCED_BRACKETS,
+	};
+
+	size_t n = 0;
+	for (v3s16 bpmin : bp_origins) {
+		const v3s16 bpmax = bpmin + v3s16(4, 4, 4);
+		DummyMap map(gamedef, bpmin, bpmax);
+		MMVManip vm(&map);
+		vm.initialEmerge(bpmin, bpmax, false);
+		const v3s16 p0 = bpmin * MAP_BLOCKSIZE + v3s16(40, 8, 40);
+
+		for (size_t i = 0; i < defs.size(); i++, n++) {
+			for (s32 vi = 0; vi < vm.m_area.getVolume(); vi++)
+				vm.m_data[vi] = MapNode(CONTENT_AIR);
+			// Twice to see that it's repeatable
+			for (int j = 0; j < 2; j++) {
+				treegen::error e = treegen::make_ltree(vm, p0 +
+					v3s16(j * 20, 0, 0), defs[i]);
+				UASSERTEQ(int, e, expected_error[i]);
+			}
+			u64 hash = murmur_hash_64_ua(vm.m_data,
+				vm.m_area.getVolume() * sizeof(MapNode), 0);
+			UASSERTEQ(u64, hash, expected[n]);
+		}
+	}
+}
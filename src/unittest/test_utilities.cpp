@@ -62,6 +62,7 @@ class TestUtilities : public TestBase {
 	void testIsBlockInSight();
 	void testColorizeURL();
 	void testSanitizeUntrusted();
+	void testHilbertCurve();
 };
 
 static TestUtilities g_test_instance;
@@ -97,6 +98,7 @@ void TestUtilities::runTests(IGameDef *gamedef)
 	TEST(testIsBlockInSight);
 	TEST(testColorizeURL);
 	TEST(testSanitizeUntrusted);
+	TEST(testHilbertCurve);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -770,3 +772,27 @@ void TestUtilities::testSanitizeUntrusted()
 		UASSERTEQ(auto, sanitize_untrusted("\x1b(", keep), "(");
 	}
 }
+
+void TestUtilities::testHilbertCurve()
+{
+	UASSERT(hilbert_curve_pos(1, 0) == v2u32(0, 0));
+
+	for (u32 side : {2, 4, 16}) {
+		std::vector<bool> visited(side * side, false);
+		v2u32 prev = hilbert_curve_pos(side, 0);
+		for (u32 n = 0; n < side * side; n++) {
+			v2u32 pos = hilbert_curve_pos(side, n);
+			UASSERT(pos.X < side && pos.Y < side);
+			// Every cell exactly once
+			UASSERT(!visited[pos.Y * side + pos.X]);
+			visited[pos.Y * side + pos.X] = true;
+			// Always a step to a neighbour
+			if (n > 0) {
+				u32 dist = std::max(pos.X, prev.X) - std::min(pos.X, prev.X) +
+					std::max(pos.Y, prev.Y) - std::min(pos.Y, prev.Y);
+				UASSERTEQ(u32, dist, 1);
+			}
+			prev = pos;
+		}
+	}
+}
@@ -24,6 +24,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/numeric.h"
 #include "dummymap.h"
 #include "nodedef.h"
+#include "mapblock.h"
+#include "threading/task_pool.h"
 
 class TestVoxelAlgorithms : public TestBase {
 public:
@@ -34,6 +36,8 @@ class TestVoxelAlgorithms : public TestBase {
 
 	void testVoxelLineIterator();
 	void testLighting(IGameDef *gamedef);
+	void testParallelLighting(IGameDef *gamedef);
+	void testRepairAreaLight(IGameDef *gamedef);
 };
 
 static TestVoxelAlgorithms g_test_instance;
@@ -42,6 +46,8 @@ void TestVoxelAlgorithms::runTests(IGameDef *gamedef)
 {
 	TEST(testVoxelLineIterator);
 	TEST(testLighting, gamedef);
+	TEST(testParallelLighting, gamedef);
+	TEST(testRepairAreaLight, gamedef);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -168,3 +174,150 @@ void TestVoxelAlgorithms::testLighting(IGameDef *gamedef)
 		UASSERTEQ(int, n.getParam1(), 153);
 	}
 }
+
+void TestVoxelAlgorithms::testParallelLighting(IGameDef *gamedef)
+{
+	v3s16 pmin(-32, -32, -32);
+	v3s16 pmax(31, 31, 31);
+	v3s16 bpmin = getNodeBlockPos(pmin), bpmax = getNodeBlockPos(pmax);
+
+	// Does large edits that process the light banks concurrently if the
+	// pool has workers
+	auto edit = [&] (DummyMap &map) {
+		std::map<v3s16, MapBlock*> modified_blocks;
+		MMVManip vm(&map);
+		vm.initialEmerge(bpmin, bpmax, false);
+		s32 volume = vm.m_area.getVolume();
+		for (s32 i = 0; i < volume; i++)
+			vm.m_data[i] = MapNode(CONTENT_AIR);
+		// Rooms with lights and some openings
+		for (s16 z = -20; z <= 20; z++)
+		for (s16 y = -20; y <= 20; y++)
+		for (s16 x = -20; x <= 20; x++) {
+			if (y % 8 == 0 && (x * 7 + z * 3) % 11 != 0)
+				vm.setNodeNoEmerge(v3s16(x, y, z), MapNode(t_CONTENT_STONE));
+			else if (x % 9 == 0 && y % 8 == 4 && z % 9 == 0)
+				vm.setNodeNoEmerge(v3s16(x, y, z), MapNode(t_CONTENT_TORCH));
+		}
+		voxalgo::blit_back_with_light(&map, &vm, &modified_blocks);
+
+		// Open up the top floor and put torches in the lowest one
+		std::vector<std::pair<v3s16, MapNode>> oldnodes;
+		for (s16 z = -20; z <= 20; z++)
+		for (s16 x = -20; x <= 20; x++) {
+			v3s16 p(x, 16, z);
+			oldnodes.emplace_back(p, map.getNode(p));
+			map.setNode(p, MapNode(CONTENT_AIR));
+			if ((x + z) % 5 == 0) {
+				p.Y = -16;
+				oldnodes.emplace_back(p, map.getNode(p));
+				map.setNode(p, MapNode(t_CONTENT_TORCH));
+			}
+		}
+		voxalgo::update_lighting_nodes(&map, oldnodes, modified_blocks);
+	};
+
+	TaskPool serial(0), parallel(1);
+
+	DummyMap map_serial(gamedef, bpmin, bpmax);
+	voxalgo::set_lighting_task_pool(&serial);
+	edit(map_serial);
+
+	DummyMap map_parallel(gamedef, bpmin, bpmax);
+	voxalgo::set_lighting_task_pool(&parallel);
+	edit(map_parallel);
+
+	voxalgo::set_lighting_task_pool(nullptr);
+
+	// The results must be identical
+	v3s16 bp;
+	for (bp.Z = bpmin.Z; bp.Z <= bpmax.Z; bp.Z++)
+	for (bp.Y = bpmin.Y; bp.Y <= bpmax.Y; bp.Y++)
+	for (bp.X = bpmin.X; bp.X <= bpmax.X; bp.X++) {
+		MapBlock *block1 = map_serial.getBlockNoCreateNoEx(bp);
+		MapBlock *block2 = map_parallel.getBlockNoCreateNoEx(bp);
+		UASSERTEQ(u16, block1->getLightingComplete(), block2->getLightingComplete());
+		for (u32 i = 0; i < MapBlock::nodecount; i++) {
+			const MapNode &na = block1->getData()[i], &nb = block2->getData()[i];
+			UASSERTEQ(u16, na.getContent(), nb.getContent());
+			UASSERTEQ(int, na.getParam1(), nb.getParam1());
+		}
+	}
+
+	// Some light must have been spread at all
+	const NodeDefManager *ndef = gamedef->ndef();
+	MapNode n = map_parallel.getNode(v3s16(1, -15, 0));
+	UASSERT(n.getLight(LIGHTBANK_NIGHT, ndef->getLightingFlags(n)) > 0);
+}
+
+void TestVoxelAlgorithms::testRepairAreaLight(IGameDef *gamedef)
+{
+	v3s16 pmin(-32, -32, -32);
+	v3s16 pmax(31, 31, 31);
+	v3s16 bpmin = getNodeBlockPos(pmin), bpmax = getNodeBlockPos(pmax);
+
+	auto init = [&] (DummyMap &map) {
+		std::map<v3s16, MapBlock*> modified_blocks;
+		MMVManip vm(&map);
+		vm.initialEmerge(bpmin, bpmax, false);
+		s32 volume = vm.m_area.getVolume();
+		for (s32 i = 0; i < volume; i++)
+			vm.m_data[i] = MapNode(CONTENT_AIR);
+		// Floors with openings and lights
+		for (s16 z = -20; z <= 20; z++)
+		for (s16 y = -20; y <= 20; y++)
+		for (s16 x = -20; x <= 20; x++) {
+			if (y % 8 == 0 && (x * 7 + z * 3) % 11 != 0)
+				vm.setNodeNoEmerge(v3s16(x, y, z), MapNode(t_CONTENT_STONE));
+			else if (x % 9 == 0 && y % 8 == 4 && z % 9 == 0)
+				vm.setNodeNoEmerge(v3s16(x, y, z), MapNode(t_CONTENT_TORCH));
+		}
+		voxalgo::blit_back_with_light(&map, &vm, &modified_blocks);
+	};
+
+	// Close the top floor, remove the torches below it and add new ones
+	std::vector<std::pair<v3s16, MapNode>> changes;
+	for (s16 z = -20; z <= 20; z++)
+	for (s16 x = -20; x <= 20; x++) {
+		changes.emplace_back(v3s16(x, 16, z), MapNode(t_CONTENT_STONE));
+		if (x % 9 == 0 && z % 9 == 0)
+			changes.emplace_back(v3s16(x, 12, z), MapNode(CONTENT_AIR));
+		if ((x + z) % 7 == 0)
+			changes.emplace_back(v3s16(x, -15, z), MapNode(t_CONTENT_TORCH));
+	}
+
+	// Light updated node by node
+	DummyMap map_nodes(gamedef, bpmin, bpmax);
+	init(map_nodes);
+	{
+		std::map<v3s16, MapBlock*> modified_blocks;
+		for (const auto &it : changes)
+			map_nodes.addNodeAndUpdate(it.first, it.second, modified_blocks);
+	}
+
+	// Nodes set without light, then the area is relit at once
+	DummyMap map_area(gamedef, bpmin, bpmax);
+	init(map_area);
+	{
+		std::map<v3s16, MapBlock*> modified_blocks;
+		for (const auto &it : changes)
+			map_area.setNode(it.first, it.second);
+		voxalgo::repair_area_light(&map_area, v3s16(-2, -1, -2), v3s16(1, 1, 1),
+			&modified_blocks);
+		UASSERT(modified_blocks.count(v3s16(0, 1, 0)));
+	}
+
+	// The results must be identical
+	v3s16 bp;
+	for (bp.Z = bpmin.Z; bp.Z <= bpmax.Z; bp.Z++)
+	for (bp.Y = bpmin.Y; bp.Y <= bpmax.Y; bp.Y++)
+	for (bp.X = bpmin.X; bp.X <= bpmax.X; bp.X++) {
+		MapBlock *block1 = map_nodes.getBlockNoCreateNoEx(bp);
+		MapBlock *block2 = map_area.getBlockNoCreateNoEx(bp);
+		for (u32 i = 0; i < MapBlock::nodecount; i++) {
+			const MapNode &na = block1->getData()[i], &nb = block2->getData()[i];
+			UASSERTEQ(u16, na.getContent(), nb.getContent());
+			UASSERTEQ(int, na.getParam1(), nb.getParam1());
+		}
+	}
+}
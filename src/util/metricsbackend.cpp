@@ -18,12 +18,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "metricsbackend.h"
+#include <algorithm>
 #include "util/thread.h"
 #if USE_PROMETHEUS
 #include <prometheus/exposer.h>
 #include <prometheus/registry.h>
 #include <prometheus/counter.h>
 #include <prometheus/gauge.h>
+#include <prometheus/histogram.h>
 #include "log.h"
 #include "settings.h"
 #endif
@@ -86,6 +88,45 @@ class SimpleMetricGauge : public MetricGauge
 	double m_gauge;
 };
 
+class SimpleMetricHistogram : public MetricHistogram
+{
+public:
+	SimpleMetricHistogram(const std::vector<double> &buckets) :
+			MetricHistogram(), m_buckets(buckets),
+			m_bucket_counts(buckets.size() + 1, 0)
+	{
+	}
+
+	virtual ~SimpleMetricHistogram() {}
+
+	void observe(double value) override
+	{
+		size_t i = std::lower_bound(m_buckets.begin(), m_buckets.end(), value) -
+				m_buckets.begin();
+		MutexAutoLock lock(m_mutex);
+		m_bucket_counts[i]++;
+		m_count++;
+		m_sum += value;
+	}
+	double getCount() const override
+	{
+		MutexAutoLock lock(m_mutex);
+		return m_count;
+	}
+	double getSum() const override
+	{
+		MutexAutoLock lock(m_mutex);
+		return m_sum;
+	}
+
+private:
+	const std::vector<double> m_buckets;
+	mutable std::mutex m_mutex;
+	std::vector<u64> m_bucket_counts;
+	double m_count = 0.0;
+	double m_sum = 0.0;
+};
+
 MetricCounterPtr MetricsBackend::addCounter(
 		const std::string &name, const std::string &help_str, Labels labels)
 {
@@ -98,6 +139,13 @@ MetricGaugePtr MetricsBackend::addGauge(
 	return std::make_shared<SimpleMetricGauge>();
 }
 
+MetricHistogramPtr MetricsBackend::addHistogram(
+		const std::string &name, const std::string &help_str,
+		const std::vector<double> &buckets, Labels labels)
+{
+	return std::make_shared<SimpleMetricHistogram>(buckets);
+}
+
 /* Prometheus backend */
 
 #if USE_PROMETHEUS
@@ -158,6 +206,41 @@ class PrometheusMetricGauge : public MetricGauge
 	prometheus::Gauge &m_gauge;
 };
 
+class PrometheusMetricHistogram : public MetricHistogram
+{
+public:
+	PrometheusMetricHistogram() = delete;
+
+	PrometheusMetricHistogram(const std::string &name, const std::string &help_str,
+			const std::vector<double> &buckets, MetricsBackend::Labels labels,
+			std::shared_ptr<prometheus::Registry> registry) :
+			MetricHistogram(),
+			m_family(prometheus::BuildHistogram()
+							.Name(name)
+							.Help(help_str)
+							.Register(*registry)),
+			m_histogram(m_family.Add(labels,
+					prometheus::Histogram::BucketBoundaries(buckets)))
+	{
+	}
+
+	virtual ~PrometheusMetricHistogram() {}
+
+	virtual void observe(double value) { m_histogram.Observe(value); }
+	virtual double getCount() const
+	{
+		return m_histogram.Collect().histogram.sample_count;
+	}
+	virtual double getSum() const
+	{
+		return m_histogram.Collect().histogram.sample_sum;
+	}
+
+private:
+	prometheus::Family<prometheus::Histogram> &m_family;
+	prometheus::Histogram &m_histogram;
+};
+
 class PrometheusMetricsBackend : public MetricsBackend
 {
 public:
@@ -176,6 +259,9 @@ class PrometheusMetricsBackend : public MetricsBackend
 	MetricGaugePtr addGauge(
 			const std::string &name, const std::string &help_str,
 			Labels labels = {}) override;
+	MetricHistogramPtr addHistogram(
+			const std::string &name, const std::string &help_str,
+			const std::vector<double> &buckets, Labels labels = {}) override;
 
 private:
 	std::unique_ptr<prometheus::Exposer> m_exposer;
@@ -194,6 +280,14 @@ MetricGaugePtr PrometheusMetricsBackend::addGauge(
 	return std::make_shared<PrometheusMetricGauge>(name, help_str, labels, m_registry);
 }
 
+MetricHistogramPtr PrometheusMetricsBackend::addHistogram(
+		const std::string &name, const std::string &help_str,
+		const std::vector<double> &buckets, Labels labels)
+{
+	return std::make_shared<PrometheusMetricHistogram>(name, help_str, buckets,
+			labels, m_registry);
+}
+
 MetricsBackend *createPrometheusMetricsBackend()
 {
 	std::string addr;
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 #include "config.h"
 
 class MetricCounter
@@ -50,6 +51,20 @@ class MetricGauge
 
 typedef std::shared_ptr<MetricGauge> MetricGaugePtr;
 
+class MetricHistogram
+{
+public:
+	MetricHistogram() = default;
+	virtual ~MetricHistogram() {}
+
+	virtual void observe(double value) = 0;
+	// Number and sum of the observed values
+	virtual double getCount() const = 0;
+	virtual double getSum() const = 0;
+};
+
+typedef std::shared_ptr<MetricHistogram> MetricHistogramPtr;
+
 class MetricsBackend
 {
 public:
@@ -65,6 +80,10 @@ class MetricsBackend
 	virtual MetricGaugePtr addGauge(
 			const std::string &name, const std::string &help_str,
 			Labels labels = {});
+	// buckets: ascending upper bounds, a +Inf bucket is always added
+	virtual MetricHistogramPtr addHistogram(
+			const std::string &name, const std::string &help_str,
+			const std::vector<double> &buckets, Labels labels = {});
 };
 
 #if USE_PROMETHEUS
@@ -108,6 +108,27 @@ u64 murmur_hash_64_ua(const void *key, int len, unsigned int seed)
 	return h;
 }
 
+v2u32 hilbert_curve_pos(u32 side, u32 n)
+{
+	u32 x = 0, y = 0;
+	for (u32 s = 1; s < side; s *= 2) {
+		u32 rx = 1 & (n / 2);
+		u32 ry = 1 & (n ^ rx);
+		// Rotate the quadrant
+		if (ry == 0) {
+			if (rx == 1) {
+				x = s - 1 - x;
+				y = s - 1 - y;
+			}
+			std::swap(x, y);
+		}
+		x += s * rx;
+		y += s * ry;
+		n /= 4;
+	}
+	return v2u32(x, y);
+}
+
 /*
 	blockpos_b: position of block in block coordinates
 	camera_pos: position of camera in nodes
@@ -291,6 +291,13 @@ inline u32 calc_parity(u32 v)
 
 u64 murmur_hash_64_ua(const void *key, int len, unsigned int seed);
 
+/*
+	Returns the position of the n-th cell on a Hilbert curve filling a
+	side x side square (side must be a power of two).
+	Consecutive cells are always neighbours.
+*/
+v2u32 hilbert_curve_pos(u32 side, u32 n);
+
 bool isBlockInSight(v3s16 blockpos_b, v3f camera_pos, v3f camera_dir,
 		f32 camera_fov, f32 range, f32 *distance_ptr=NULL);
 
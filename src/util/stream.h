@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <iostream>
+#include <string>
 #include <string_view>
 #include <functional>
 
@@ -68,3 +69,56 @@ class DummyStreamBuffer : public std::streambuf {
 		return n;
 	}
 };
+
+// Appends everything written to a string, which unlike std::ostringstream
+// can be reused across calls without giving up its allocation.
+class StringAppendStreamBuffer : public std::streambuf {
+public:
+	StringAppendStreamBuffer(std::string &out) : m_out(out) {}
+
+protected:
+	int overflow(int c) {
+		if (c != traits_type::eof())
+			m_out.push_back(c);
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize xsputn(const char *s, std::streamsize n) {
+		m_out.append(s, n);
+		return n;
+	}
+
+private:
+	std::string &m_out;
+};
+
+// Reads from memory that is owned elsewhere, avoiding the copy that
+// std::istringstream makes. The memory must outlive the buffer.
+class StringViewStreamBuffer : public std::streambuf {
+public:
+	StringViewStreamBuffer(std::string_view data) {
+		char *begin = const_cast<char *>(data.data());
+		setg(begin, begin, begin + data.size());
+	}
+
+protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+			std::ios_base::openmode which = std::ios_base::in) {
+		off_type pos;
+		if (dir == std::ios_base::beg)
+			pos = off;
+		else if (dir == std::ios_base::cur)
+			pos = gptr() - eback() + off;
+		else
+			pos = egptr() - eback() + off;
+		if (!(which & std::ios_base::in) || pos < 0 || pos > egptr() - eback())
+			return pos_type(off_type(-1));
+		setg(eback(), eback() + pos, egptr());
+		return pos;
+	}
+
+	pos_type seekpos(pos_type pos,
+			std::ios_base::openmode which = std::ios_base::in) {
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+};
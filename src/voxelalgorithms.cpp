@@ -18,11 +18,17 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "voxelalgorithms.h"
 #include "nodedef.h"
 #include "mapblock.h"
 #include "map.h"
+#include "threading/task_pool.h"
 
 namespace voxalgo
 {
@@ -244,20 +250,212 @@ bool step_rel_block_pos(direction dir, relative_v3 &rel_pos,
 	return false;
 }
 
+/*!
+ * Updates touching at least this many nodes or blocks process the two
+ * light banks concurrently.
+ */
+static constexpr size_t PARALLEL_LIGHTING_MIN_NODES = 256;
+static constexpr size_t PARALLEL_LIGHTING_MIN_BLOCKS = 8;
+
+static_assert(sizeof(std::atomic<u8>) == sizeof(u8) &&
+	std::atomic<u8>::is_always_lock_free,
+	"param1 can't be accessed atomically");
+
+/*!
+ * Access to the map for updating the light of one light bank.
+ *
+ * The banks don't depend on each other, so large updates process them
+ * concurrently. As both live in param1 of the same nodes, a concurrent
+ * context only changes its half of that byte with atomic operations,
+ * and defers or guards everything else that is shared: map lookups,
+ * the lighting complete flags and the modification state of blocks.
+ */
+struct LightBankContext {
+	Map *map;
+	const NodeDefManager *ndef;
+	LightBank bank;
+	//! All modified map blocks are added to this.
+	std::map<v3s16, MapBlock*> &modified_blocks;
+
+	/*!
+	 * \param map_mutex must be shared with the context of the other bank
+	 * if it runs at the same time, null otherwise
+	 */
+	LightBankContext(Map *map, LightBank bank,
+		std::map<v3s16, MapBlock*> &modified_blocks,
+		std::mutex *map_mutex = nullptr) :
+		map(map),
+		ndef(map->getNodeDefManager()),
+		bank(bank),
+		modified_blocks(modified_blocks),
+		m_map_mutex(map_mutex)
+	{}
+
+	MapBlock *getBlock(mapblock_v3 pos)
+	{
+		if (!m_map_mutex)
+			return map->getBlockNoCreateNoEx(pos);
+		auto it = m_blocks.find(pos);
+		if (it != m_blocks.end())
+			return it->second;
+		MapBlock *block;
+		{
+			std::lock_guard<std::mutex> lock(*m_map_mutex);
+			block = map->getBlockNoCreateNoEx(pos);
+		}
+		m_blocks.emplace(pos, block);
+		return block;
+	}
+
+	/*!
+	 * Returns the node at the given position. Only the light of this
+	 * context's bank is reliable.
+	 */
+	MapNode getNode(MapBlock *block, relative_v3 pos)
+	{
+		if (!m_map_mutex)
+			return block->getNodeNoCheck(pos);
+		MapNode &ref = nodeRef(block, pos);
+		return MapNode(ref.param0,
+			param1(ref).load(std::memory_order_relaxed), ref.param2);
+	}
+
+	//! Like Map::getNode, returns CONTENT_IGNORE for unloaded positions.
+	MapNode getNode(v3s16 p, bool *is_valid_position)
+	{
+		mapblock_v3 block_pos;
+		relative_v3 rel_pos;
+		getNodeBlockPosWithOffset(p, block_pos, rel_pos);
+		MapBlock *block = getBlock(block_pos);
+		*is_valid_position = block != nullptr;
+		return block ? getNode(block, rel_pos) : MapNode(CONTENT_IGNORE);
+	}
+
+	void setLight(MapBlock *block, relative_v3 pos, u8 light,
+		ContentLightingFlags f)
+	{
+		if (!m_map_mutex) {
+			MapNode n = block->getNodeNoCheck(pos);
+			n.setLight(bank, light, f);
+			block->setNodeNoCheck(pos, n);
+			return;
+		}
+		if (!f.has_light)
+			return;
+		std::atomic<u8> &p1 = param1(nodeRef(block, pos));
+		// The other half of the byte may change meanwhile, this one can't
+		if (bank == LIGHTBANK_DAY) {
+			p1.fetch_and(0xf0, std::memory_order_relaxed);
+			p1.fetch_or(light & 0x0f, std::memory_order_relaxed);
+		} else {
+			p1.fetch_and(0x0f, std::memory_order_relaxed);
+			p1.fetch_or((light & 0x0f) << 4, std::memory_order_relaxed);
+		}
+		if (block != m_last_written) {
+			m_written.insert(block);
+			m_last_written = block;
+		}
+	}
+
+	void setLightingIncomplete(MapBlock *block, direction dir)
+	{
+		if (!m_map_mutex)
+			block->setLightingComplete(bank, dir, false);
+		else
+			m_incomplete.emplace_back(block, dir);
+	}
+
+	//! Applies the deferred changes, after the other bank is done too.
+	void finish()
+	{
+		for (MapBlock *block : m_written)
+			block->raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
+		for (auto &it : m_incomplete)
+			it.first->setLightingComplete(bank, it.second, false);
+		m_written.clear();
+		m_last_written = nullptr;
+		m_incomplete.clear();
+	}
+
+private:
+	static MapNode &nodeRef(MapBlock *block, relative_v3 pos)
+	{
+		return block->getData()[pos.Z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+			pos.Y * MAP_BLOCKSIZE + pos.X];
+	}
+
+	static std::atomic<u8> &param1(MapNode &n)
+	{
+		return reinterpret_cast<std::atomic<u8> &>(n.param1);
+	}
+
+	std::mutex *m_map_mutex;
+	std::unordered_map<v3s16, MapBlock*> m_blocks;
+	std::unordered_set<MapBlock*> m_written;
+	MapBlock *m_last_written = nullptr;
+	std::vector<std::pair<MapBlock*, direction>> m_incomplete;
+};
+
+static constexpr LightBank banks[] = { LIGHTBANK_DAY, LIGHTBANK_NIGHT };
+
+static TaskPool *g_lighting_task_pool = nullptr;
+
+void set_lighting_task_pool(TaskPool *pool)
+{
+	g_lighting_task_pool = pool;
+}
+
+/*!
+ * Calls fn(ctx, bank index) for both light banks.
+ * If large is set and there are threads for it, the banks are processed
+ * concurrently. The result is the same either way.
+ */
+template <typename F>
+static void for_each_light_bank(Map *map,
+	std::map<v3s16, MapBlock*> &modified_blocks, bool large, const F &fn)
+{
+	TaskPool &pool = g_lighting_task_pool ? *g_lighting_task_pool :
+		TaskPool::getShared();
+	if (!large || pool.getWorkerCount() == 0) {
+		for (size_t b = 0; b < 2; b++) {
+			LightBankContext ctx(map, banks[b], modified_blocks);
+			fn(ctx, b);
+		}
+		return;
+	}
+
+	std::mutex map_mutex;
+	std::map<v3s16, MapBlock*> modified[2];
+	std::unique_ptr<LightBankContext> ctx[2];
+	for (size_t b = 0; b < 2; b++)
+		ctx[b] = std::make_unique<LightBankContext>(map, banks[b],
+			modified[b], &map_mutex);
+
+	pool.run({
+		[&] { fn(*ctx[0], 0); },
+		[&] { fn(*ctx[1], 1); },
+	});
+
+	for (size_t b = 0; b < 2; b++) {
+		ctx[b]->finish();
+		modified_blocks.insert(modified[b].begin(), modified[b].end());
+	}
+}
+
 /*
  * Removes all light that is potentially emitted by the specified
  * light sources. These nodes will have zero light.
  * Returns all nodes whose light became zero but should be re-lighted.
  *
- * \param bank the light bank in which the procedure operates
+ * \param ctx the light bank in which the procedure operates
  * \param from_nodes nodes whose light is removed
  * \param light_sources nodes that should be re-lighted
- * \param modified_blocks output, all modified map blocks are added to this
  */
-void unspread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
-	UnlightQueue &from_nodes, ReLightQueue &light_sources,
-	std::map<v3s16, MapBlock*> &modified_blocks)
+void unspread_light(LightBankContext &ctx,
+	UnlightQueue &from_nodes, ReLightQueue &light_sources)
 {
+	const NodeDefManager *nodemgr = ctx.ndef;
+	const LightBank bank = ctx.bank;
 	// Stores data popped from from_nodes
 	u8 current_light;
 	ChangingLight current;
@@ -272,7 +470,7 @@ void unspread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 		// There is no brightest neighbor
 		source_dir = 6;
 		// The current node
-		const MapNode &node = current.block->getNodeNoCheck(current.rel_position);
+		const MapNode node = ctx.getNode(current.block, current.rel_position);
 		ContentLightingFlags f = nodemgr->getLightingFlags(node);
 		// If the node emits light, it behaves like it had a
 		// brighter neighbor.
@@ -290,16 +488,16 @@ void unspread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 			neighbor_block_pos = current.block_position;
 			MapBlock *neighbor_block;
 			if (step_rel_block_pos(i, neighbor_rel_pos, neighbor_block_pos)) {
-				neighbor_block = map->getBlockNoCreateNoEx(neighbor_block_pos);
+				neighbor_block = ctx.getBlock(neighbor_block_pos);
 				if (neighbor_block == NULL) {
-					current.block->setLightingComplete(bank, i, false);
+					ctx.setLightingIncomplete(current.block, i);
 					continue;
 				}
 			} else {
 				neighbor_block = current.block;
 			}
 			// Get the neighbor itself
-			MapNode neighbor = neighbor_block->getNodeNoCheck(neighbor_rel_pos);
+			MapNode neighbor = ctx.getNode(neighbor_block, neighbor_rel_pos);
 			ContentLightingFlags neighbor_f = nodemgr->getLightingFlags(
 				neighbor.getContent());
 			u8 neighbor_light = neighbor.getLightRaw(bank, neighbor_f);
@@ -309,14 +507,13 @@ void unspread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 			if (neighbor_f.light_propagates && neighbor_light < current_light) {
 				// Unlight, but only if the node has light.
 				if (neighbor_light > 0) {
-					neighbor.setLight(bank, 0, neighbor_f);
-					neighbor_block->setNodeNoCheck(neighbor_rel_pos, neighbor);
+					ctx.setLight(neighbor_block, neighbor_rel_pos, 0, neighbor_f);
 					from_nodes.push(neighbor_light, neighbor_rel_pos,
 						neighbor_block_pos, neighbor_block, i);
 					// The current node was modified earlier, so its block
 					// is in modified_blocks.
 					if (current.block != neighbor_block) {
-						modified_blocks[neighbor_block_pos] = neighbor_block;
+						ctx.modified_blocks[neighbor_block_pos] = neighbor_block;
 					}
 				}
 			} else {
@@ -350,14 +547,13 @@ void unspread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
  * light_sources (if the queue contains a node multiple times, the brightest
  * occurrence counts).
  *
- * \param bank the light bank in which the procedure operates
+ * \param ctx the light bank in which the procedure operates
  * \param light_sources starting nodes
- * \param modified_blocks output, all modified map blocks are added to this
  */
-void spread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
-	LightQueue &light_sources,
-	std::map<v3s16, MapBlock*> &modified_blocks)
+void spread_light(LightBankContext &ctx, LightQueue &light_sources)
 {
+	const NodeDefManager *nodemgr = ctx.ndef;
+	const LightBank bank = ctx.bank;
 	// The light the current node can provide to its neighbors.
 	u8 spreading_light;
 	// The ChangingLight for the current node.
@@ -377,29 +573,29 @@ void spread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 			neighbor_block_pos = current.block_position;
 			MapBlock *neighbor_block;
 			if (step_rel_block_pos(i, neighbor_rel_pos, neighbor_block_pos)) {
-				neighbor_block = map->getBlockNoCreateNoEx(neighbor_block_pos);
+				neighbor_block = ctx.getBlock(neighbor_block_pos);
 				if (neighbor_block == NULL) {
-					current.block->setLightingComplete(bank, i, false);
+					ctx.setLightingIncomplete(current.block, i);
 					continue;
 				}
 			} else {
 				neighbor_block = current.block;
 			}
 			// Get the neighbor itself
-			MapNode neighbor = neighbor_block->getNodeNoCheck(neighbor_rel_pos);
+			MapNode neighbor = ctx.getNode(neighbor_block, neighbor_rel_pos);
 			ContentLightingFlags f = nodemgr->getLightingFlags(neighbor);
 			if (f.light_propagates) {
 				// Light up the neighbor, if it has less light than it should.
 				u8 neighbor_light = neighbor.getLightRaw(bank, f);
 				if (neighbor_light < spreading_light) {
-					neighbor.setLight(bank, spreading_light, f);
-					neighbor_block->setNodeNoCheck(neighbor_rel_pos, neighbor);
+					ctx.setLight(neighbor_block, neighbor_rel_pos,
+						spreading_light, f);
 					light_sources.push(spreading_light, neighbor_rel_pos,
 						neighbor_block_pos, neighbor_block, i);
 					// The current node was modified earlier, so its block
 					// is in modified_blocks.
 					if (current.block != neighbor_block) {
-						modified_blocks[neighbor_block_pos] = neighbor_block;
+						ctx.modified_blocks[neighbor_block_pos] = neighbor_block;
 					}
 				}
 			}
@@ -407,6 +603,25 @@ void spread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 	}
 }
 
+/*!
+ * Sets the light of the nodes in the queue to the level they are queued
+ * with, as spread_light() expects it.
+ *
+ * \param max_light levels above this are already set
+ */
+static void init_light_sources(LightBankContext &ctx, LightQueue &light_sources,
+	u8 max_light = LIGHT_SUN)
+{
+	for (u8 i = 0; i <= max_light; i++) {
+		const auto &lights = light_sources.lights[i];
+		for (auto it = lights.begin(); it < lights.end(); ++it) {
+			MapNode n = ctx.getNode(it->block, it->rel_position);
+			ctx.setLight(it->block, it->rel_position, i,
+				ctx.ndef->getLightingFlags(n));
+		}
+	}
+}
+
 struct SunlightPropagationUnit{
 	v2s16 relative_pos;
 	bool is_sunlit;
@@ -428,25 +643,26 @@ struct SunlightPropagationData{
  *
  * \param pos position of the node.
  */
-bool is_sunlight_above(Map *map, v3s16 pos, const NodeDefManager *ndef)
+bool is_sunlight_above(LightBankContext &ctx, v3s16 pos)
 {
+	const NodeDefManager *ndef = ctx.ndef;
 	bool sunlight = true;
 	mapblock_v3 source_block_pos;
 	relative_v3 source_rel_pos;
 	getNodeBlockPosWithOffset(pos + v3s16(0, 1, 0), source_block_pos,
 		source_rel_pos);
 	// If the node above has sunlight, this node also can get it.
-	MapBlock *source_block = map->getBlockNoCreateNoEx(source_block_pos);
+	MapBlock *source_block = ctx.getBlock(source_block_pos);
 	if (source_block == NULL) {
 		// But if there is no node above, then use heuristics
-		MapBlock *node_block = map->getBlockNoCreateNoEx(getNodeBlockPos(pos));
+		MapBlock *node_block = ctx.getBlock(getNodeBlockPos(pos));
 		if (node_block == NULL) {
 			sunlight = false;
 		} else {
 			sunlight = !node_block->getIsUnderground();
 		}
 	} else {
-		MapNode above = source_block->getNodeNoCheck(source_rel_pos);
+		MapNode above = ctx.getNode(source_block, source_rel_pos);
 		if (above.getContent() == CONTENT_IGNORE) {
 			// Trust heuristics
 			if (source_block->getIsUnderground()) {
@@ -464,13 +680,11 @@ bool is_sunlight_above(Map *map, v3s16 pos, const NodeDefManager *ndef)
 	return sunlight;
 }
 
-static constexpr LightBank banks[] = { LIGHTBANK_DAY, LIGHTBANK_NIGHT };
-
-void update_lighting_nodes(Map *map,
-	const std::vector<std::pair<v3s16, MapNode>> &oldnodes,
-	std::map<v3s16, MapBlock*> &modified_blocks)
+static void update_lighting_nodes_bank(LightBankContext &ctx,
+	const std::vector<std::pair<v3s16, MapNode>> &oldnodes)
 {
-	const NodeDefManager *ndef = map->getNodeDefManager();
+	const NodeDefManager *ndef = ctx.ndef;
+	const LightBank bank = ctx.bank;
 	// For node getter functions
 	bool is_valid_position;
 
@@ -478,8 +692,7 @@ void update_lighting_nodes(Map *map,
 	thread_local UnlightQueue disappearing_lights(1);
 	thread_local ReLightQueue light_sources(4);
 
-	// Process each light bank separately
-	for (LightBank bank : banks) {
+	{
 		disappearing_lights.clear();
 		light_sources.clear();
 		// Nodes that are brighter than the brightest modified node was
@@ -504,31 +717,31 @@ void update_lighting_nodes(Map *map,
 			relative_v3 rel_pos;
 			mapblock_v3 block_pos;
 			getNodeBlockPosWithOffset(p, block_pos, rel_pos);
-			MapBlock *block = map->getBlockNoCreateNoEx(block_pos);
+			MapBlock *block = ctx.getBlock(block_pos);
 			if (block == NULL) {
 				continue;
 			}
 			// Get the new node
-			MapNode n = block->getNodeNoCheck(rel_pos);
+			MapNode n = ctx.getNode(block, rel_pos);
 
 			// Light of the old node
 			u8 old_light = it->second.getLight(bank, ndef->getLightingFlags(it->second));
 
 			// Add the block of the added node to modified_blocks
-			modified_blocks[block_pos] = block;
+			ctx.modified_blocks[block_pos] = block;
 
 			// Get new light level of the node
 			u8 new_light = 0;
 			ContentLightingFlags f = ndef->getLightingFlags(n);
 			if (f.light_propagates) {
 				if (bank == LIGHTBANK_DAY && f.sunlight_propagates
-					&& is_sunlight_above(map, p, ndef)) {
+					&& is_sunlight_above(ctx, p)) {
 					new_light = LIGHT_SUN;
 				} else {
 					new_light = f.light_source;
 					for (const v3s16 &neighbor_dir : neighbor_dirs) {
 						v3s16 p2 = p + neighbor_dir;
-						MapNode n2 = map->getNode(p2, &is_valid_position);
+						MapNode n2 = ctx.getNode(p2, &is_valid_position);
 						if (is_valid_position) {
 							u8 spread = n2.getLight(bank, ndef->getLightingFlags(n2));
 							// If it is sure that the neighbor won't be
@@ -553,8 +766,7 @@ void update_lighting_nodes(Map *map,
 				// light as the previous one, so it must be unlighted.
 
 				// Add to unlight queue
-				n.setLight(bank, 0, f);
-				block->setNodeNoCheck(rel_pos, n);
+				ctx.setLight(block, rel_pos, 0, f);
 				disappearing_lights.push(old_light, rel_pos, block_pos, block,
 					6);
 
@@ -565,7 +777,7 @@ void update_lighting_nodes(Map *map,
 
 						MapNode n2;
 
-						n2 = map->getNode(n2pos, &is_valid_position);
+						n2 = ctx.getNode(n2pos, &is_valid_position);
 						if (!is_valid_position)
 							break;
 
@@ -576,13 +788,11 @@ void update_lighting_nodes(Map *map,
 							break;
 						}
 						// Remove sunlight and add to unlight queue.
-						n2.setLight(LIGHTBANK_DAY, 0, f2);
-						map->setNode(n2pos, n2);
 						relative_v3 rel_pos2;
 						mapblock_v3 block_pos2;
 						getNodeBlockPosWithOffset(n2pos, block_pos2, rel_pos2);
-						MapBlock *block2 = map->getBlockNoCreateNoEx(
-							block_pos2);
+						MapBlock *block2 = ctx.getBlock(block_pos2);
+						ctx.setLight(block2, rel_pos2, 0, f2);
 						disappearing_lights.push(LIGHT_SUN, rel_pos2,
 							block_pos2, block2,
 							4 /* The node above caused the change */);
@@ -598,7 +808,7 @@ void update_lighting_nodes(Map *map,
 
 						MapNode n2;
 
-						n2 = map->getNode(n2pos, &is_valid_position);
+						n2 = ctx.getNode(n2pos, &is_valid_position);
 						if (!is_valid_position)
 							break;
 
@@ -615,8 +825,7 @@ void update_lighting_nodes(Map *map,
 						relative_v3 rel_pos2;
 						mapblock_v3 block_pos2;
 						getNodeBlockPosWithOffset(n2pos, block_pos2, rel_pos2);
-						MapBlock *block2 = map->getBlockNoCreateNoEx(
-							block_pos2);
+						MapBlock *block2 = ctx.getBlock(block_pos2);
 						// Mark node for lighting.
 						light_sources.push(LIGHT_SUN, rel_pos2, block_pos2,
 							block2, 4);
@@ -626,22 +835,26 @@ void update_lighting_nodes(Map *map,
 
 		}
 		// Remove lights
-		unspread_light(map, ndef, bank, disappearing_lights, light_sources,
-			modified_blocks);
+		unspread_light(ctx, disappearing_lights, light_sources);
 		// Initialize light values for light spreading.
-		for (u8 i = 0; i <= LIGHT_SUN; i++) {
-			const auto &lights = light_sources.lights[i];
-			for (auto it = lights.begin(); it < lights.end(); ++it) {
-				MapNode n = it->block->getNodeNoCheck(it->rel_position);
-				n.setLight(bank, i, ndef->getLightingFlags(n));
-				it->block->setNodeNoCheck(it->rel_position, n);
-			}
-		}
+		init_light_sources(ctx, light_sources);
 		// Spread lights.
-		spread_light(map, ndef, bank, light_sources, modified_blocks);
+		spread_light(ctx, light_sources);
 	}
 }
 
+void update_lighting_nodes(Map *map,
+	const std::vector<std::pair<v3s16, MapNode>> &oldnodes,
+	std::map<v3s16, MapBlock*> &modified_blocks)
+{
+	// Process each light bank separately
+	for_each_light_bank(map, modified_blocks,
+		oldnodes.size() >= PARALLEL_LIGHTING_MIN_NODES,
+		[&] (LightBankContext &ctx, size_t) {
+			update_lighting_nodes_bank(ctx, oldnodes);
+		});
+}
+
 /*!
  * Borders of a map block in relative node coordinates.
  * Compatible with type 'direction'.
@@ -699,6 +912,7 @@ void update_block_border_lighting(Map *map, MapBlock *block,
 	ReLightQueue light_sources(0);
 
 	for (LightBank bank : banks) {
+		LightBankContext ctx(map, bank, modified_blocks);
 		disappearing_lights.clear();
 		light_sources.clear();
 		// Get incorrect lights
@@ -749,19 +963,11 @@ void update_block_border_lighting(Map *map, MapBlock *block,
 			}
 		}
 		// Remove lights
-		unspread_light(map, ndef, bank, disappearing_lights, light_sources,
-			modified_blocks);
+		unspread_light(ctx, disappearing_lights, light_sources);
 		// Initialize light values for light spreading.
-		for (u8 i = 0; i <= LIGHT_SUN; i++) {
-			const auto &lights = light_sources.lights[i];
-			for (auto it = lights.begin(); it < lights.end(); ++it) {
-				MapNode n = it->block->getNodeNoCheck(it->rel_position);
-				n.setLight(bank, i, ndef->getLightingFlags(n));
-				it->block->setNodeNoCheck(it->rel_position, n);
-			}
-		}
+		init_light_sources(ctx, light_sources);
 		// Spread lights.
-		spread_light(map, ndef, bank, light_sources, modified_blocks);
+		spread_light(ctx, light_sources);
 	}
 }
 
@@ -976,66 +1182,54 @@ void finish_bulk_light_update(Map *map, mapblock_v3 minblock,
 	mapblock_v3 maxblock, UnlightQueue unlight[2], ReLightQueue relight[2],
 	std::map<v3s16, MapBlock*> *modified_blocks)
 {
-	const NodeDefManager *ndef = map->getNodeDefManager();
-
-	// --- STEP 1: Do unlighting
-
-	for (size_t bank = 0; bank < 2; bank++) {
-		LightBank b = banks[bank];
-		unspread_light(map, ndef, b, unlight[bank], relight[bank],
-			*modified_blocks);
-	}
-
-	// --- STEP 2: Get all newly inserted light sources
-
-	// For each block:
-	v3s16 blockpos;
-	v3s16 relpos;
-	for (blockpos.X = minblock.X; blockpos.X <= maxblock.X; blockpos.X++)
-	for (blockpos.Y = minblock.Y; blockpos.Y <= maxblock.Y; blockpos.Y++)
-	for (blockpos.Z = minblock.Z; blockpos.Z <= maxblock.Z; blockpos.Z++) {
-		MapBlock *block = map->getBlockNoCreateNoEx(blockpos);
-		if (!block)
-			// Skip not existing blocks
-			continue;
-		// For each node in the block:
-		for (relpos.Z = 0; relpos.Z < MAP_BLOCKSIZE; relpos.Z++)
-		for (relpos.X = 0; relpos.X < MAP_BLOCKSIZE; relpos.X++)
-		for (relpos.Y = 0; relpos.Y < MAP_BLOCKSIZE; relpos.Y++) {
-			MapNode node = block->getNodeNoCheck(relpos.X, relpos.Y, relpos.Z);
-			ContentLightingFlags f = ndef->getLightingFlags(node);
-
-			// For each light bank
-			for (size_t b = 0; b < 2; b++) {
-				LightBank bank = banks[b];
-				u8 light = f.has_light ?
-					node.getLight(bank, f):
-					f.light_source;
-				if (light > 1)
-					relight[b].push(light, relpos, blockpos, block, 6);
-			} // end of banks
-		} // end of nodes
-	} // end of blocks
-
-	// --- STEP 3: do light spreading
-
-	// For each light bank:
-	for (size_t b = 0; b < 2; b++) {
-		LightBank bank = banks[b];
-		// Sunlight is already initialized.
-		u8 maxlight = (b == 0) ? LIGHT_MAX : LIGHT_SUN;
-		// Initialize light values for light spreading.
-		for (u8 i = 0; i <= maxlight; i++) {
-			const auto &lights = relight[b].lights[i];
-			for (auto it = lights.begin(); it < lights.end(); ++it) {
-				MapNode n = it->block->getNodeNoCheck(it->rel_position);
-				n.setLight(bank, i, ndef->getLightingFlags(n));
-				it->block->setNodeNoCheck(it->rel_position, n);
-			}
-		}
-		// Spread lights.
-		spread_light(map, ndef, bank, relight[b], *modified_blocks);
-	}
+	// Large areas are processed in parallel
+	size_t volume = VoxelArea(minblock, maxblock).getVolume();
+
+	for_each_light_bank(map, *modified_blocks,
+		volume >= PARALLEL_LIGHTING_MIN_BLOCKS,
+		[&] (LightBankContext &ctx, size_t b) {
+			const NodeDefManager *ndef = ctx.ndef;
+			const LightBank bank = ctx.bank;
+
+			// --- STEP 1: Do unlighting
+
+			unspread_light(ctx, unlight[b], relight[b]);
+
+			// --- STEP 2: Get all newly inserted light sources
+
+			// For each block:
+			v3s16 blockpos;
+			v3s16 relpos;
+			for (blockpos.X = minblock.X; blockpos.X <= maxblock.X; blockpos.X++)
+			for (blockpos.Y = minblock.Y; blockpos.Y <= maxblock.Y; blockpos.Y++)
+			for (blockpos.Z = minblock.Z; blockpos.Z <= maxblock.Z; blockpos.Z++) {
+				MapBlock *block = ctx.getBlock(blockpos);
+				if (!block)
+					// Skip not existing blocks
+					continue;
+				// For each node in the block:
+				for (relpos.Z = 0; relpos.Z < MAP_BLOCKSIZE; relpos.Z++)
+				for (relpos.X = 0; relpos.X < MAP_BLOCKSIZE; relpos.X++)
+				for (relpos.Y = 0; relpos.Y < MAP_BLOCKSIZE; relpos.Y++) {
+					MapNode node = ctx.getNode(block, relpos);
+					ContentLightingFlags f = ndef->getLightingFlags(node);
+					u8 light = f.has_light ?
+						node.getLight(bank, f):
+						f.light_source;
+					if (light > 1)
+						relight[b].push(light, relpos, blockpos, block, 6);
+				} // end of nodes
+			} // end of blocks
+
+			// --- STEP 3: do light spreading
+
+			// Sunlight is already initialized.
+			u8 maxlight = (b == 0) ? LIGHT_MAX : LIGHT_SUN;
+			// Initialize light values for light spreading.
+			init_light_sources(ctx, relight[b], maxlight);
+			// Spread lights.
+			spread_light(ctx, relight[b]);
+		});
 }
 
 void blit_back_with_light(Map *map, MMVManip *vm,
@@ -1251,6 +1445,122 @@ void repair_block_light(Map *map, MapBlock *block,
 		modified_blocks);
 }
 
+//! Directions of the neighbors of a map block.
+static const v3s16 block_face_dirs[] = {
+	v3s16(1, 0, 0), v3s16(0, 1, 0), v3s16(0, 0, 1),
+	v3s16(0, 0, -1), v3s16(0, -1, 0), v3s16(-1, 0, 0)
+};
+
+void repair_area_light(Map *map, mapblock_v3 minblock, mapblock_v3 maxblock,
+	std::map<v3s16, MapBlock*> *modified_blocks)
+{
+	const NodeDefManager *ndef = map->getNodeDefManager();
+	// First queue is for day light, second is for night light.
+	UnlightQueue unlight[] = { UnlightQueue(256), UnlightQueue(256) };
+	ReLightQueue relight[] = { ReLightQueue(256), ReLightQueue(256) };
+	// Will hold sunlight data.
+	bool lights[MAP_BLOCKSIZE][MAP_BLOCKSIZE];
+	SunlightPropagationData data;
+
+	// --- STEP 1: reset everything to sunlight
+
+	// For each column of map blocks:
+	for (s16 x = minblock.X; x <= maxblock.X; x++)
+	for (s16 z = minblock.Z; z <= maxblock.Z; z++) {
+		// True if lights[][] holds the sunlight leaving the block above
+		bool lights_valid = false;
+		MapBlock *block = nullptr;
+		// For each map block, downwards:
+		for (s16 y = maxblock.Y; y >= minblock.Y; y--) {
+			mapblock_v3 blockpos(x, y, z);
+			block = map->getBlockNoCreateNoEx(blockpos);
+			if (!block) {
+				// Skip not existing blocks
+				lights_valid = false;
+				continue;
+			}
+			(*modified_blocks)[blockpos] = block;
+			// Extract sunlight above.
+			if (!lights_valid)
+				is_sunlight_above_block(map, blockpos, ndef, lights);
+			fill_with_sunlight(block, ndef, lights);
+			lights_valid = true;
+		}
+		if (!block)
+			continue;
+		// Copy sunlight data
+		data.target_block = v3s16(x, minblock.Y - 1, z);
+		for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+		for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
+			data.data.emplace_back(v2s16(x, z), lights[z][x]);
+		// Propagate sunlight and shadow below the area.
+		while (!data.data.empty()) {
+			if (propagate_block_sunlight(map, ndef, &data, &unlight[0],
+					&relight[0]))
+				(*modified_blocks)[data.target_block] =
+					map->getBlockNoCreateNoEx(data.target_block);
+			// Step downwards.
+			data.target_block.Y--;
+		}
+	}
+
+	// --- STEP 2: Get nodes from borders to unlight
+
+	const VoxelArea area(minblock, maxblock);
+	v3s16 blockpos;
+	v3s16 relpos;
+	// For each block:
+	for (blockpos.X = minblock.X; blockpos.X <= maxblock.X; blockpos.X++)
+	for (blockpos.Y = minblock.Y; blockpos.Y <= maxblock.Y; blockpos.Y++)
+	for (blockpos.Z = minblock.Z; blockpos.Z <= maxblock.Z; blockpos.Z++) {
+		MapBlock *block = map->getBlockNoCreateNoEx(blockpos);
+		if (!block)
+			// Skip not existing blocks.
+			continue;
+		// For each border of the block:
+		for (const v3s16 &dir : block_face_dirs) {
+			// Light can only leak through the borders of the area
+			// or into holes
+			mapblock_v3 neighbor = blockpos + dir;
+			if (area.contains(neighbor) && map->getBlockNoCreateNoEx(neighbor))
+				continue;
+			// The whole face, edges included
+			VoxelArea a(v3s16(0, 0, 0), v3s16(MAP_BLOCKSIZE - 1,
+				MAP_BLOCKSIZE - 1, MAP_BLOCKSIZE - 1));
+			if (dir.X + dir.Y + dir.Z > 0)
+				a.MinEdge += dir * (MAP_BLOCKSIZE - 1);
+			else
+				a.MaxEdge += dir * (MAP_BLOCKSIZE - 1);
+			// For each node of the border:
+			for (relpos.Z = a.MinEdge.Z; relpos.Z <= a.MaxEdge.Z; relpos.Z++)
+			for (relpos.X = a.MinEdge.X; relpos.X <= a.MaxEdge.X; relpos.X++)
+			for (relpos.Y = a.MinEdge.Y; relpos.Y <= a.MaxEdge.Y; relpos.Y++) {
+
+				// Get node
+				MapNode node = block->getNodeNoCheck(relpos);
+				ContentLightingFlags f = ndef->getLightingFlags(node);
+				// For each light bank
+				for (size_t b = 0; b < 2; b++) {
+					LightBank bank = banks[b];
+					u8 light = f.has_light ?
+						node.getLight(bank, f):
+						f.light_source;
+					// If the new node is dimmer than sunlight, unlight.
+					if (LIGHT_SUN > light) {
+						unlight[b].push(
+							LIGHT_SUN, relpos, blockpos, block, 6);
+					}
+				} // end of banks
+			} // end of nodes
+		} // end of borders
+	} // end of blocks
+
+	// STEP 3: Remove and spread light
+
+	finish_bulk_light_update(map, minblock, maxblock, unlight, relight,
+		modified_blocks);
+}
+
 VoxelLineIterator::VoxelLineIterator(const v3f &start_position, const v3f &line_vector) :
 	m_start_position(start_position),
 	m_line_vector(line_vector)
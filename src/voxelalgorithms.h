@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 class Map;
 class MapBlock;
 class MMVManip;
+class TaskPool;
 
 namespace voxalgo
 {
@@ -79,6 +80,24 @@ void blit_back_with_light(Map *map, MMVManip *vm,
 void repair_block_light(Map *map, MapBlock *block,
 	std::map<v3s16, MapBlock*> *modified_blocks);
 
+/*!
+ * Recomputes the light of an area of map blocks from scratch,
+ * regardless of the light values currently stored in it.
+ * Light leaving the area is corrected as well.
+ * Missing blocks are skipped.
+ * For server use only.
+ *
+ * \param minblock, maxblock the area in block coordinates
+ */
+void repair_area_light(Map *map, v3s16 minblock, v3s16 maxblock,
+	std::map<v3s16, MapBlock*> *modified_blocks);
+
+/*!
+ * Sets the pool used to process the light banks of large updates
+ * concurrently, null means the shared one. Meant for tests.
+ */
+void set_lighting_task_pool(TaskPool *pool);
+
 /*!
  * This class iterates trough voxels that intersect with
  * a line. The collision detection does not see nodeboxes,